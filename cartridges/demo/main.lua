@@ -52,8 +52,9 @@ function _draw()
     -- Draw the player
     rectfill(player.x, player.y, 8, 8, player.color)    
 
-    -- Test the print function by showing player coordinates
-    print("X:"..player.x.." Y:"..player.y, 4, 4, 7)
+    -- Show the player coordinates. printf formats the numbers natively,
+    -- so no temporary Lua strings are created every frame.
+    printf("X:%d Y:%d", 4, 4, 7, player.x, player.y)
 
     -- Test the time function with a pulsing circle
     local pulse = (time() * 2) % 2
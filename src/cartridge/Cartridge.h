@@ -2,12 +2,17 @@
 #define CARTRIDGE_H
 
 #include <string>
+#include <memory>
 #include "nlohmann/json.hpp"
+#include "rendering/SpriteSheet.h"
+#include "cartridge/Tilemap.h"
 
 // Represents the loaded data of a single game cartridge.
 struct Cartridge {
     nlohmann::json config;
     std::string luaScript;
+    std::shared_ptr<SpriteSheet> spriteSheet; // Optional; null if the cartridge has no sprites.
+    std::shared_ptr<Tilemap> tilemap;         // Always present; empty unless the cartridge ships map data.
 };
 
 #endif // CARTRIDGE_H
@@ -42,6 +42,30 @@ std::unique_ptr<Cartridge> CartridgeLoader::loadCartridge(const std::string& car
         return nullptr;
     }
 
+    // 3. Load the optional sprite sheet.
+    std::filesystem::path spritePath = basePath / cartridge->config.value("spritesheet", "sprites.bmp");
+    if (std::filesystem::exists(spritePath)) {
+        cartridge->spriteSheet = SpriteSheet::loadFromBMP(spritePath.string());
+        if (!cartridge->spriteSheet) {
+            std::cerr << "CartridgeLoader Error: Could not load sprite sheet at " << spritePath << std::endl;
+            return nullptr;
+        }
+    }
+
+    // 4. Load the tilemap: its size comes from the config, the cells from a raw byte file.
+    int mapWidth = cartridge->config.value("/map/width"_json_pointer, 128);
+    int mapHeight = cartridge->config.value("/map/height"_json_pointer, 64);
+    std::string mapFile = cartridge->config.value("/map/file"_json_pointer, std::string("map.bin"));
+    try {
+        cartridge->tilemap = Tilemap::loadFromFile((basePath / mapFile).string(), mapWidth, mapHeight);
+    } catch (const std::invalid_argument& e) {
+        std::cerr << "CartridgeLoader Error: Invalid map size in " << configPath << ". " << e.what() << std::endl;
+        return nullptr;
+    }
+    if (!cartridge->tilemap) {
+        return nullptr;
+    }
+
     return cartridge;
 }
 
@@ -25,6 +25,9 @@ public:
      * 
      * This function reads the 'config.json' and 'main.lua' files from the
      * given directory, parsing the configuration and loading the script content.
+     * If present, the sprite sheet (an 8-bit BMP named by "spritesheet" in the
+     * config, 'sprites.bmp' by default) is decoded as well, and the tilemap is
+     * sized from "map" in the config and filled from its raw cell file if present.
      * @param cartridgeDirectoryPath The path to the cartridge's root folder.
      * @return A unique_ptr to a Cartridge struct on success, or nullptr on failure.
      */
@@ -9,8 +9,9 @@
 GameLoader::GameLoader(Engine* engine) : engineInstance(engine) {
 }
 
-std::unique_ptr<LuaGame> GameLoader::loadAndInitializeGame(Engine* engine, const std::string& cartId, std::shared_ptr<std::atomic<float>> progress) {
-    // This code can run on a background thread.
+std::unique_ptr<LuaGame> GameLoader::loadGame(Engine* engine, const std::string& cartId, std::shared_ptr<std::atomic<float>> progress) {
+    // This code can run on a background thread, so it must not touch the AestheticLayer. The
+    // script's _init runs later, when the engine starts the game on the main thread.
 
     // 1. Construct the full path to the cartridge.
     if (progress) progress->store(0.1f); // 10%
@@ -43,7 +44,6 @@ std::unique_ptr<LuaGame> GameLoader::loadAndInitializeGame(Engine* engine, const
             return nullptr;
         }
 
-        // The LuaGame constructor calls the script's _init function.
         // We pass ownership of the cartridge and the scripting manager to the new game object.
         auto luaGame = std::make_unique<LuaGame>(std::move(cartridge), std::move(scriptingManager));
         
@@ -64,7 +64,7 @@ AsyncLoadResult GameLoader::loadGameAsync(const std::string& cartId) {
     auto progress = std::make_shared<std::atomic<float>>(0.0f);
 
     // Launch the static helper function asynchronously.
-    auto future = std::async(std::launch::async, &GameLoader::loadAndInitializeGame, engineInstance, cartId, progress);
+    auto future = std::async(std::launch::async, &GameLoader::loadGame, engineInstance, cartId, progress);
 
     return { std::move(future), progress };
 }
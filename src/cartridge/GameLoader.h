@@ -23,8 +23,9 @@ public:
     // This is the core function. It starts the background loading process.
     AsyncLoadResult loadGameAsync(const std::string& cartId);
 
-    // Synchronous loader, can be called from anywhere.
-    static std::unique_ptr<LuaGame> loadAndInitializeGame(Engine* engine, const std::string& cartId, std::shared_ptr<std::atomic<float>> progress);
+    // Synchronous loader, can be called from anywhere. Loads the cartridge and runs its script's
+    // main chunk; the game's _init has not run yet (see Engine::LoadCartridge).
+    static std::unique_ptr<LuaGame> loadGame(Engine* engine, const std::string& cartId, std::shared_ptr<std::atomic<float>> progress);
 
 private:
     Engine* engineInstance; // Non-owning pointer to the engine
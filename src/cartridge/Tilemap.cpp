@@ -0,0 +1,138 @@
+#include "cartridge/Tilemap.h"
+#include "rendering/SpriteSheet.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+Tilemap::Tilemap(int width, int height)
+    : width(width), height(height),
+      chunkColumns((width + CHUNK_TILES - 1) / CHUNK_TILES),
+      chunkRows((height + CHUNK_TILES - 1) / CHUNK_TILES) {
+    if (width <= 0 || height <= 0) {
+        throw std::invalid_argument("Tilemap dimensions must be positive.");
+    }
+    tiles.assign(static_cast<size_t>(width) * height, 0);
+    chunks.resize(static_cast<size_t>(chunkColumns) * chunkRows);
+}
+
+std::unique_ptr<Tilemap> Tilemap::loadFromFile(const std::string& path, int width, int height) {
+    auto tilemap = std::make_unique<Tilemap>(width, height);
+    if (!std::filesystem::exists(path)) {
+        return tilemap; // No map data: start with an empty map of the configured size.
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    file.read(reinterpret_cast<char*>(tilemap->tiles.data()), static_cast<std::streamsize>(tilemap->tiles.size()));
+    if (file.gcount() != static_cast<std::streamsize>(tilemap->tiles.size())) {
+        std::cerr << "Tilemap Error: " << path << " holds fewer than " << width << "x" << height << " tiles." << std::endl;
+        return nullptr;
+    }
+    return tilemap;
+}
+
+uint8_t Tilemap::Get(int x, int y) const {
+    if (x < 0 || x >= width || y < 0 || y >= height) {
+        return 0;
+    }
+    return tiles[static_cast<size_t>(y) * width + x];
+}
+
+void Tilemap::Set(int x, int y, uint8_t tile) {
+    if (x < 0 || x >= width || y < 0 || y >= height) {
+        return;
+    }
+    uint8_t& cell = tiles[static_cast<size_t>(y) * width + x];
+    if (cell == tile) {
+        return;
+    }
+    cell = tile;
+    chunks[(y / CHUNK_TILES) * chunkColumns + (x / CHUNK_TILES)].valid = false;
+}
+
+const Tilemap::ChunkRaster& Tilemap::GetChunk(int chunkX, int chunkY, const SpriteSheet& sheet,
+                                              const TransparencyMask& transparency) {
+    // A different sheet, edited sheet pixels or new transparent colors invalidate every raster.
+    if (cacheSheet != &sheet || cacheSheetVersion != sheet.GetVersion() || cacheTransparency != transparency) {
+        for (int index : cachedChunks) {
+            chunks[index].valid = false;
+        }
+        cacheSheet = &sheet;
+        cacheSheetVersion = sheet.GetVersion();
+        cacheTransparency = transparency;
+    }
+
+    const int index = chunkY * chunkColumns + chunkX;
+    Chunk& chunk = chunks[index];
+    chunk.lastUsed = ++useCounter;
+    if (!chunk.valid) {
+        if (chunk.raster.pixels.empty()) {
+            if (cachedChunks.size() >= MAX_CACHED_CHUNKS) {
+                EvictLeastRecentlyUsed();
+            }
+            cachedChunks.push_back(index);
+        }
+        Rasterize(chunkX, chunkY, chunk, sheet, transparency);
+        chunk.valid = true;
+    }
+    return chunk.raster;
+}
+
+void Tilemap::EvictLeastRecentlyUsed() {
+    auto oldest = std::min_element(cachedChunks.begin(), cachedChunks.end(), [this](int a, int b) {
+        return chunks[a].lastUsed < chunks[b].lastUsed;
+    });
+    Chunk& chunk = chunks[*oldest];
+    chunk.valid = false;
+    chunk.raster = ChunkRaster{}; // Release the pixel memory.
+    cachedChunks.erase(oldest);
+}
+
+void Tilemap::Rasterize(int chunkX, int chunkY, Chunk& chunk, const SpriteSheet& sheet,
+                        const TransparencyMask& transparency) {
+    ChunkRaster& raster = chunk.raster;
+    raster.pixels.assign(CHUNK_PIXELS * CHUNK_PIXELS, 0);
+    std::vector<uint8_t> opaque(CHUNK_PIXELS * CHUNK_PIXELS, 0);
+
+    // 1. Copy the sprite of every non-empty tile into the chunk and note which pixels are opaque.
+    const int columns = sheet.GetColumns();
+    for (int ty = 0; ty < CHUNK_TILES; ++ty) {
+        for (int tx = 0; tx < CHUNK_TILES; ++tx) {
+            const uint8_t tile = Get(chunkX * CHUNK_TILES + tx, chunkY * CHUNK_TILES + ty);
+            if (tile == 0) continue; // Tile 0 is empty.
+
+            const int srcX = (tile % columns) * TILE_SIZE;
+            const int srcY = (tile / columns) * TILE_SIZE;
+            for (int py = 0; py < TILE_SIZE; ++py) {
+                const int row = (ty * TILE_SIZE + py) * CHUNK_PIXELS + tx * TILE_SIZE;
+                for (int px = 0; px < TILE_SIZE; ++px) {
+                    const uint8_t color = sheet.GetPixel(srcX + px, srcY + py);
+                    raster.pixels[row + px] = color;
+                    opaque[row + px] = !transparency.Test(color);
+                }
+            }
+        }
+    }
+
+    // 2. Encode each pixel row as runs of opaque pixels.
+    raster.runs.clear();
+    raster.rowRunIndex.resize(CHUNK_PIXELS + 1);
+    for (int y = 0; y < CHUNK_PIXELS; ++y) {
+        raster.rowRunIndex[y] = static_cast<uint16_t>(raster.runs.size());
+        const uint8_t* row = &opaque[y * CHUNK_PIXELS];
+        int x = 0;
+        while (x < CHUNK_PIXELS) {
+            if (!row[x]) {
+                ++x;
+                continue;
+            }
+            int start = x;
+            while (x < CHUNK_PIXELS && row[x]) {
+                ++x;
+            }
+            raster.runs.push_back(Run{static_cast<uint8_t>(start), static_cast<uint8_t>(x - start)});
+        }
+    }
+    raster.rowRunIndex[CHUNK_PIXELS] = static_cast<uint16_t>(raster.runs.size());
+}
@@ -0,0 +1,91 @@
+#ifndef TILEMAP_H
+#define TILEMAP_H
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <string>
+#include "rendering/TransparencyMask.h"
+
+class SpriteSheet;
+
+/// @class Tilemap
+/// @brief The cartridge's map: a grid of sprite numbers, stored and rendered in chunks.
+///
+/// The map is split into CHUNK_TILES x CHUNK_TILES chunks. Each chunk caches its rasterized
+/// indexed pixels together with the opaque runs of every pixel row, so drawing the map is a
+/// handful of row copies per chunk. A chunk is re-rasterized only after mset() touches it, or
+/// when the sprite sheet or the transparent colors it was built with change. Only a bounded
+/// number of chunks keep their pixels, so very large maps stay cheap in memory.
+class Tilemap {
+public:
+    static constexpr int CHUNK_TILES = 16;
+    static constexpr int TILE_SIZE = 8;
+    static constexpr int CHUNK_PIXELS = CHUNK_TILES * TILE_SIZE;
+    static constexpr size_t MAX_CACHED_CHUNKS = 64;
+
+    /// @brief A horizontal run of opaque pixels on one chunk row.
+    struct Run {
+        uint8_t x;      ///< First pixel of the run, relative to the chunk.
+        uint8_t length; ///< Number of pixels.
+    };
+
+    /// @brief Rasterized pixels of one chunk and their opaque runs.
+    struct ChunkRaster {
+        std::vector<uint8_t> pixels;     ///< CHUNK_PIXELS x CHUNK_PIXELS color indices.
+        std::vector<Run> runs;
+        std::vector<uint16_t> rowRunIndex; ///< CHUNK_PIXELS + 1 entries: first run of each row.
+    };
+
+    Tilemap(int width, int height);
+
+    /**
+     * @brief Creates a map of the given size, filled from a raw file of width*height bytes.
+     * @return The map, or nullptr if the file exists but has the wrong size.
+     */
+    static std::unique_ptr<Tilemap> loadFromFile(const std::string& path, int width, int height);
+
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+
+    /// @brief Returns the sprite number at cell (x, y), or 0 outside the map.
+    uint8_t Get(int x, int y) const;
+
+    /// @brief Sets the sprite number at cell (x, y) and invalidates the chunk that holds it.
+    void Set(int x, int y, uint8_t tile);
+
+    /**
+     * @brief Returns the cached raster of chunk (chunkX, chunkY), rebuilding it if needed.
+     * Tile 0 is treated as empty, as are sheet pixels whose color is in the transparency mask.
+     */
+    const ChunkRaster& GetChunk(int chunkX, int chunkY, const SpriteSheet& sheet, const TransparencyMask& transparency);
+
+    int GetChunkColumns() const { return chunkColumns; }
+    int GetChunkRows() const { return chunkRows; }
+
+private:
+    struct Chunk {
+        ChunkRaster raster;
+        bool valid = false;
+        uint64_t lastUsed = 0;
+    };
+
+    void Rasterize(int chunkX, int chunkY, Chunk& chunk, const SpriteSheet& sheet, const TransparencyMask& transparency);
+    void EvictLeastRecentlyUsed();
+
+    int width;
+    int height;
+    int chunkColumns;
+    int chunkRows;
+    std::vector<uint8_t> tiles;
+    std::vector<Chunk> chunks;
+    std::vector<int> cachedChunks; // Indices of chunks currently holding pixels.
+    uint64_t useCounter = 0;
+
+    // What the cached rasters were built from; a change drops every cached chunk.
+    const SpriteSheet* cacheSheet = nullptr;
+    uint64_t cacheSheetVersion = 0;
+    TransparencyMask cacheTransparency;
+};
+
+#endif // TILEMAP_H
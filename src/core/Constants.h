@@ -17,6 +17,24 @@ constexpr int VERSION_MAJOR = 0;
 constexpr int VERSION_MINOR = 1;
 constexpr int VERSION_REVISION = 0;
 
+// --- Rendering ---
+// Run the row diff, palette conversion and post-processing on a dedicated thread so they
+// overlap the next frame's update/draw. Texture upload and present stay on the main thread,
+// which owns the SDL renderer. Set to false for single-threaded presentation.
+constexpr bool PIPELINED_PRESENT = true;
+
+// Skip conversion, upload and present for frames identical to the last one shown, and
+// sleep until the next tick or input event instead, so static screens leave the CPU idle.
+constexpr bool SKIP_UNCHANGED_FRAMES = true;
+
+// Upper bound on the threads that rasterize recorded display lists (carts with
+// "display_list" enabled). The engine uses min(hardware threads, this value).
+constexpr int MAX_RASTER_THREADS = 8;
+
+// Upper bound on the threads that filter the output image of carts that enable
+// "post_process". Filtering is memory-bound, so a few threads are enough.
+constexpr int MAX_POST_PROCESS_THREADS = 4;
+
 } // namespace Constants
 } // namespace Ulics
 
@@ -1,5 +1,6 @@
 #include "core/Engine.h"
 #include "rendering/AestheticLayer.h"
+#include "rendering/SoftwareRenderBackend.h"
 #include "scripting/LuaGame.h"
 #include "input/InputManager.h"
 #include "cartridge/GameLoader.h"
@@ -10,7 +11,10 @@
 #include <chrono>
 #include <thread>
 #include <filesystem>
+#include <algorithm>
 #include <fstream>
+#include <ctime>
+#include <cmath>
 
 // No forward declaration needed, GameLoader.h provides it.
 
@@ -49,6 +53,10 @@ bool Engine::Initialize(const char* title, int width, int height) {
 
     // Initialize core subsystems
     aestheticLayer = std::make_unique<AestheticLayer>(renderer);
+    aestheticLayer->SetPipelinedPresent(Ulics::Constants::PIPELINED_PRESENT);
+    aestheticLayer->SetSkipUnchangedFrames(Ulics::Constants::SKIP_UNCHANGED_FRAMES);
+    aestheticLayer->SetRasterThreads(std::min(static_cast<int>(std::thread::hardware_concurrency()),
+                                              Ulics::Constants::MAX_RASTER_THREADS));
     inputManager = std::make_unique<InputManager>();
     gameLoader = std::make_unique<GameLoader>(this);
 
@@ -62,19 +70,10 @@ bool Engine::Initialize(const char* title, int width, int height) {
     deployDefaultCartridgeIfNeeded();
 
     // Synchronously load the boot cartridge on startup. This is the only time we block.
-    activeGame = GameLoader::loadAndInitializeGame(this, ".ulics_boot", nullptr);
-
-    if (!activeGame) {
+    if (!LoadCartridge(".ulics_boot")) {
         enterErrorState("Failed to load embedded boot cartridge.");
         return true;
     }
-    
-    // Apply boot cartridge config
-    auto* luaGame = static_cast<LuaGame*>(activeGame.get());
-    const auto& config = luaGame->getConfig();
-    size_t paletteSize = config.value("/config/palette_size"_json_pointer, 16);
-    aestheticLayer->ResizePalette(paletteSize);
-    std::cout << "Engine: Boot cartridge palette size set to " << paletteSize << std::endl;
 
     isRunning = true;
     currentState = EngineState::BootCartridgeRunning;
@@ -90,7 +89,9 @@ bool Engine::InitializeHeadless(const std::string& testUserDataPath) {
     }
 
     // For headless tests, we don't initialize SDL video, window, or renderer.
-    // We only need the subsystems required for loading and logic.
+    // Drawing goes to an in-memory software backend so cartridges can still run _draw.
+    aestheticLayer = std::make_unique<AestheticLayer>(
+        std::make_unique<SoftwareRenderBackend>(AestheticLayer::FRAMEBUFFER_WIDTH, AestheticLayer::FRAMEBUFFER_HEIGHT));
     inputManager = std::make_unique<InputManager>();
     gameLoader = std::make_unique<GameLoader>(this);
     userDataPath = testUserDataPath;
@@ -134,6 +135,21 @@ void Engine::Run() {
                 case SDL_CONTROLLERDEVICEREMOVED:
                     inputManager->removeController(event.cdevice.which);
                     break;
+                case SDL_WINDOWEVENT:
+                    // The window contents may be gone, so the next frame is shown even if unchanged.
+                    if (event.window.event == SDL_WINDOWEVENT_EXPOSED ||
+                        event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+                        aestheticLayer->InvalidateOutput();
+                    }
+                    break;
+                case SDL_KEYDOWN:
+                    // F9 records an animated GIF, F10 a raw indexed stream; pressing it again stops.
+                    if (!event.key.repeat && event.key.keysym.sym == SDLK_F9) {
+                        toggleCapture(FrameCapture::Format::Gif);
+                    } else if (!event.key.repeat && event.key.keysym.sym == SDLK_F10) {
+                        toggleCapture(FrameCapture::Format::Raw);
+                    }
+                    break;
             }
         }
 
@@ -161,22 +177,14 @@ void Engine::Run() {
                 if (nextGameFuture.valid() && nextGameFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
                     std::unique_ptr<LuaGame> newGame = nextGameFuture.get();
                     
-                    if (newGame) {
-                        // Success! Swap the new game in. This is fast.
-                        activeGame = std::move(newGame);
-
-                        // Apply new cartridge config
-                        auto* luaGame = static_cast<LuaGame*>(activeGame.get());
-                        const auto& config = luaGame->getConfig();
-                        size_t paletteSize = config.value("/config/palette_size"_json_pointer, 16);
-                        aestheticLayer->ResizePalette(paletteSize);
-                        std::cout << "Engine: New cartridge palette size set to " << paletteSize << std::endl;
-
-                        currentState = EngineState::GameRunning;
-                        std::cout << "Engine: Async load finished. Switched to running state." << std::endl;
-                    } else {
+                    if (!newGame) {
                         // The background loading failed.
                         enterErrorState("Failed to load the requested cartridge.");
+                    } else if (!startGame(std::move(newGame))) {
+                        enterErrorState("A runtime error occurred in the cartridge's _init.");
+                    } else {
+                        currentState = EngineState::GameRunning;
+                        std::cout << "Engine: Async load finished. Switched to running state." << std::endl;
                     }
                 }
                 lag = 0.0; // Prevent lag accumulation while loading.
@@ -194,7 +202,80 @@ void Engine::Run() {
             }
         }
         
-        aestheticLayer->Present();
+        if (!aestheticLayer->Present()) {
+            // Nothing changed, so no vsync-blocking present paces the loop. Sleep until the
+            // next update is due, or until input arrives and may change the screen.
+            const int waitMs = static_cast<int>(std::ceil(MS_PER_UPDATE - lag));
+            SDL_WaitEventTimeout(nullptr, std::max(waitMs, 1));
+        }
+    }
+}
+
+void Engine::toggleCapture(FrameCapture::Format format) {
+    if (aestheticLayer->IsCapturing()) {
+        aestheticLayer->StopCapture();
+        return;
+    }
+    if (userDataPath.empty()) {
+        return;
+    }
+
+    // Captures are named after the local time they started, e.g. captures/20250314_093000.gif.
+    std::filesystem::path directory = std::filesystem::path(userDataPath) / "captures";
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    const std::time_t now = std::time(nullptr);
+    char name[32];
+    std::strftime(name, sizeof(name), "%Y%m%d_%H%M%S", std::localtime(&now));
+    const char* extension = format == FrameCapture::Format::Gif ? ".gif" : ".raw";
+    aestheticLayer->StartCapture((directory / (std::string(name) + extension)).string(), format);
+}
+
+bool Engine::LoadCartridge(const std::string& cartId) {
+    std::unique_ptr<LuaGame> game = GameLoader::loadGame(this, cartId, nullptr);
+    return game && startGame(std::move(game));
+}
+
+bool Engine::startGame(std::unique_ptr<LuaGame> game) {
+    // Tear the previous cartridge down first. Surfaces belong to the cartridge that created
+    // them, so the new one starts with none and keeps those its _init creates.
+    activeGame.reset();
+    aestheticLayer->FreeSurfaces();
+    resetDrawState();
+
+    applyCartridgeSettings(*game);
+    // _init may read the map (spawn points, collision) or draw sprites, so both are attached first.
+    aestheticLayer->SetSpriteSheet(game->getSpriteSheet());
+    aestheticLayer->SetTilemap(game->getTilemap());
+    LuaGame& started = *game;
+    activeGame = std::move(game);
+    return started._init();
+}
+
+void Engine::applyCartridgeSettings(const LuaGame& game) {
+    const auto& config = game.getConfig();
+    size_t paletteSize = config.value("/config/palette_size"_json_pointer, 16);
+    aestheticLayer->ResizePalette(paletteSize);
+    std::cout << "Engine: Cartridge palette size set to " << paletteSize << std::endl;
+
+    int screenWidth = config.value("/config/resolution/width"_json_pointer, AestheticLayer::FRAMEBUFFER_WIDTH);
+    int screenHeight = config.value("/config/resolution/height"_json_pointer, AestheticLayer::FRAMEBUFFER_HEIGHT);
+    if (!aestheticLayer->SetResolution(screenWidth, screenHeight)) {
+        aestheticLayer->SetResolution(AestheticLayer::FRAMEBUFFER_WIDTH, AestheticLayer::FRAMEBUFFER_HEIGHT);
+    }
+    // Carts that fit in 16 colors get the half-size 4bpp framebuffer.
+    aestheticLayer->SetFramebufferPacked(paletteSize <= 16);
+
+    // Optional CRT-style output: upscale, scanlines, shadow mask and bloom, all off by default.
+    PostProcessor::Settings postProcess;
+    postProcess.scale = config.value("/config/post_process/scale"_json_pointer, 1);
+    postProcess.scanlines = static_cast<uint8_t>(std::clamp(config.value("/config/post_process/scanlines"_json_pointer, 0), 0, 255));
+    postProcess.shadowMask = static_cast<uint8_t>(std::clamp(config.value("/config/post_process/shadow_mask"_json_pointer, 0), 0, 255));
+    postProcess.bloom = static_cast<uint8_t>(std::clamp(config.value("/config/post_process/bloom"_json_pointer, 0), 0, 255));
+    postProcess.threads = std::max(std::min(static_cast<int>(std::thread::hardware_concurrency()),
+                                            Ulics::Constants::MAX_POST_PROCESS_THREADS), 1);
+    if (!aestheticLayer->SetPostProcess(postProcess)) {
+        aestheticLayer->SetPostProcess(PostProcessor::Settings{});
     }
 }
 
@@ -242,8 +323,20 @@ void Engine::deployDefaultCartridgeIfNeeded() {
     }
 }
 
-void Engine::drawLoadingScreen() {
+void Engine::resetDrawState() {
+    // A cartridge leaves its drawing state behind: after a fade through pal(c, 0, 1) the whole
+    // screen would show black, and a leftover clip() or fillp() could hide the error text. The
+    // next cartridge and the engine's own screens start clean.
     aestheticLayer->SetCamera(0, 0);
+    aestheticLayer->ResetDrawPalette();
+    aestheticLayer->SetTransparentColor(std::nullopt);
+    aestheticLayer->ResetDisplayPalettes();
+    aestheticLayer->ResetClip();
+    aestheticLayer->SetFillPattern(0, std::nullopt);
+}
+
+void Engine::drawLoadingScreen() {
+    resetDrawState();
     aestheticLayer->Clear(1); // Dark Blue background
 
     // Draw the progress bar
@@ -256,13 +349,18 @@ void Engine::drawLoadingScreen() {
 }
 
 void Engine::drawErrorScreen() {
-    aestheticLayer->SetCamera(0, 0);
+    resetDrawState();
     aestheticLayer->Clear(2); // Dark Purple background for errors
     aestheticLayer->Print("ENGINE ERROR:", 4, 4, 8); // Red title
     aestheticLayer->Print(errorMessage, 4, 20, 7); // White error message
 }
 
 void Engine::Shutdown() {
+    if (aestheticLayer && aestheticLayer->GetSkippedFrameCount() != 0) {
+        std::cout << "Engine: Skipped " << aestheticLayer->GetSkippedFrameCount()
+                  << " unchanged frames." << std::endl;
+    }
+
     // Resetting unique_ptrs will handle deletion.
     activeGame.reset();
     gameLoader.reset();
@@ -6,6 +6,7 @@
 #include <memory>
 #include <chrono>
 #include <future>
+#include "rendering/FrameCapture.h"
 
 // Forward declarations
 class AestheticLayer;
@@ -32,11 +33,15 @@ public:
     bool InitializeHeadless(const std::string& testUserDataPath);
     void Run();
     void RequestCartridgeLoad(const std::string& cartId);
+    // Loads a cartridge on the calling thread and starts it in place of the active game.
+    // Returns false if it could not be loaded or its _init failed.
+    bool LoadCartridge(const std::string& cartId);
     
     // Public getters for subsystems
     AestheticLayer* getAestheticLayer() const { return aestheticLayer.get(); }
     InputManager* getInputManager() const { return inputManager.get(); }
     GameLoader* getGameLoader() const { return gameLoader.get(); }
+    Game* getActiveGame() const { return activeGame.get(); }
     double getElapsedTime() const;
     const std::string& getUserDataPath() const { return userDataPath; }
 
@@ -46,9 +51,13 @@ private:
     static constexpr double MS_PER_UPDATE = 1000.0 / UPDATES_PER_SECOND;
     
     void enterErrorState(const std::string& message);
+    bool startGame(std::unique_ptr<LuaGame> game);
+    void applyCartridgeSettings(const LuaGame& game);
     void deployDefaultCartridgeIfNeeded();
+    void resetDrawState();
     void drawLoadingScreen();
     void drawErrorScreen();
+    void toggleCapture(FrameCapture::Format format);
     void Shutdown();
 
     bool isRunning;
@@ -1,26 +1,31 @@
 #include "AestheticLayer.h"
-#include "rendering/EmbeddedFont.h"
+#include "rendering/DisplayList.h"
+#include "rendering/SDLRenderBackend.h"
 #include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
 
-AestheticLayer::AestheticLayer(SDL_Renderer* renderer) : renderer(renderer) {
-    if (!renderer) {
-        throw std::runtime_error("The renderer provided to AestheticLayer is null.");
-    }
+AestheticLayer::AestheticLayer(SDL_Renderer* renderer)
+    : AestheticLayer(std::make_unique<SDLRenderBackend>(renderer, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT)) {
+}
 
-    // Create the texture that we will use as our final canvas.
-    // SDL_TEXTUREACCESS_STREAMING allows us to update it efficiently every frame.
-    texture = SDL_CreateTexture(renderer,
-                                SDL_PIXELFORMAT_ARGB8888,
-                                SDL_TEXTUREACCESS_STREAMING,
-                                FRAMEBUFFER_WIDTH,
-                                FRAMEBUFFER_HEIGHT);
-    if (!texture) {
-        throw std::runtime_error("Could not create the aesthetic layer texture.");
+AestheticLayer::AestheticLayer(std::unique_ptr<RenderBackend> renderBackend)
+    : backend(std::move(renderBackend)),
+      framebuffer(FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT, 0),
+      raster(framebuffer.data(), FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT) {
+    if (!backend) {
+        throw std::runtime_error("The render backend provided to AestheticLayer is null.");
     }
 
     // Initialize the buffers.
-    framebuffer.resize(FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT, 0);
-    pixelBuffer.resize(FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT, 0);
+    presentedFrame.resize(FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT, 0);
+    auto screen = std::make_unique<Surface>();
+    screen->width = FRAMEBUFFER_WIDTH;
+    screen->height = FRAMEBUFFER_HEIGHT;
+    screen->pixels = framebuffer.data();
+    surfaces.push_back(std::move(screen));
+    raster.SetSurfaces(&surfaces);
 
     // Define the 16-color palette (PICO-8).
     palette = {
@@ -41,21 +46,116 @@ AestheticLayer::AestheticLayer(SDL_Renderer* renderer) : renderer(renderer) {
         {255, 119, 168, 255}, // 14: Pink
         {255, 204, 170, 255}  // 15: Light Peach
     };
+    raster.SetPaletteSize(palette.size());
+    displayPalettes.fill(Rasterizer::IdentityPalette());
+    RebuildPaletteLUT();
+
+    const char* kernelName = nullptr;
+    expandKernel = PixelConversion::SelectExpandKernel(&kernelName);
+    expandPackedKernel = PixelConversion::SelectExpandPackedKernel();
+    std::cout << "AestheticLayer: Using " << backend->GetName() << " backend with " << kernelName
+              << " palette expansion." << std::endl;
 }
 
 AestheticLayer::~AestheticLayer() {
-    if (texture) {
-        SDL_DestroyTexture(texture);
-    }
+    SetPipelinedPresent(false);
 }
 
 void AestheticLayer::SetCamera(int x, int y) {
-    cameraX = x;
-    cameraY = y;
+    raster.SetCamera(x, y);
 }
 
 void AestheticLayer::SetTransparentColor(std::optional<uint8_t> colorIndex) {
-    transparentColor = colorIndex;
+    raster.SetTransparentColor(colorIndex);
+}
+
+void AestheticLayer::SetTransparent(uint8_t colorIndex, bool transparent) {
+    raster.SetTransparent(colorIndex, transparent);
+}
+
+void AestheticLayer::SetDrawPaletteEntry(uint8_t from, uint8_t to) {
+    raster.SetDrawPaletteEntry(from, to);
+}
+
+void AestheticLayer::ResetDrawPalette() {
+    raster.ResetDrawPalette();
+}
+
+void AestheticLayer::SetFillPattern(uint16_t pattern, std::optional<uint8_t> altColor) {
+    raster.SetFillPattern(pattern, altColor);
+}
+
+void AestheticLayer::SetClip(int x, int y, int w, int h) {
+    raster.SetClipRect(x, y, w, h);
+}
+
+void AestheticLayer::ResetClip() {
+    raster.ResetClip();
+}
+
+void AestheticLayer::SetDrawState(const Rasterizer::DrawState& state) {
+    raster.SetDrawState(state);
+}
+
+void AestheticLayer::SetDisplayPaletteEntry(int bank, uint8_t from, uint8_t to) {
+    if (bank < 0 || bank >= DISPLAY_PALETTE_BANKS || displayPalettes[bank][from] == to) {
+        return;
+    }
+    displayPalettes[bank][from] = to;
+    // Only rows shown through this bank change color.
+    int y0 = screenHeight;
+    int y1 = -1;
+    for (int y = 0; y < screenHeight; ++y) {
+        if (scanlineBanks[y] == bank) {
+            y0 = std::min(y0, y);
+            y1 = y;
+        }
+    }
+    RebuildDisplayLUTs(y0, y1);
+}
+
+void AestheticLayer::SetScanlinePalette(int y0, int y1, int bank) {
+    if (bank < 0 || bank >= DISPLAY_PALETTE_BANKS) {
+        return;
+    }
+    y0 = std::max(y0, 0);
+    y1 = std::min(y1, screenHeight - 1);
+    if (y0 > y1) {
+        return;
+    }
+    const auto first = scanlineBanks.begin() + y0;
+    const auto last = scanlineBanks.begin() + y1 + 1;
+    if (std::all_of(first, last, [bank](uint8_t b) { return b == bank; })) {
+        return; // Carts that set the same banks every frame cause no upload.
+    }
+    std::fill(first, last, static_cast<uint8_t>(bank));
+    // Only the rows that switched bank need converting again; the LUTs themselves are unchanged.
+    ForceRowUpload(y0, y1);
+}
+
+void AestheticLayer::ResetDisplayPalettes() {
+    // pal() calls this, often at the top of every _draw; when there is nothing to reset it must
+    // not cause an upload. Otherwise only rows that leave a bank other than an identity bank 0
+    // change color.
+    std::array<bool, DISPLAY_PALETTE_BANKS> identity;
+    for (int bank = 0; bank < DISPLAY_PALETTE_BANKS; ++bank) {
+        identity[bank] = displayPalettes[bank] == Rasterizer::IdentityPalette();
+    }
+    int y0 = screenHeight;
+    int y1 = -1;
+    for (int y = 0; y < screenHeight; ++y) {
+        if (scanlineBanks[y] != 0 || !identity[0]) {
+            y0 = std::min(y0, y);
+            y1 = y;
+        }
+    }
+    const bool allIdentity = std::all_of(identity.begin(), identity.end(), [](bool b) { return b; });
+    if (allIdentity && y0 > y1) {
+        return;
+    }
+    displayPalettes.fill(Rasterizer::IdentityPalette());
+    scanlineBanks.fill(0);
+    RebuildDisplayLUTs(y0, y1);
 }
 
 void AestheticLayer::ResizePalette(size_t new_size) {
@@ -66,177 +166,745 @@ void AestheticLayer::ResizePalette(size_t new_size) {
     // Keep a copy of the original 16 colors.
     std::vector<SDL_Color> base_palette = palette;
 
+    // A nibble cannot hold the extra colors.
+    if (new_size > 16) {
+        SetFramebufferPacked(false);
+    }
+
     palette.resize(new_size);
 
     // Restore the base colors, making sure not to write past the new size.
     for (size_t i = 0; i < base_palette.size() && i < new_size; ++i) {
         palette[i] = base_palette[i];
     }
+    raster.SetPaletteSize(palette.size());
+    RebuildPaletteLUT();
+}
+
+bool AestheticLayer::SetResolution(int width, int height) {
+    if (width <= 0 || height <= 0 || width % 2 != 0 || width > MAX_FRAMEBUFFER_WIDTH || height > MAX_FRAMEBUFFER_HEIGHT) {
+        std::cerr << "AestheticLayer: Unsupported resolution " << width << "x" << height << "." << std::endl;
+        return false;
+    }
+    if (width == screenWidth && height == screenHeight) {
+        return true;
+    }
+
+    // The presenter stages rows sized for the current output image, so it is stopped (and its
+    // pending frame shown) while the image is resized.
+    const bool pipelined = IsPipelinedPresent();
+    SetPipelinedPresent(false);
+    const int scale = GetOutputScale();
+    if (!backend->Resize(width * scale, height * scale)) {
+        std::cerr << "AestheticLayer: The " << backend->GetName() << " backend could not resize to " << width * scale
+                  << "x" << height * scale << "." << std::endl;
+        SetPipelinedPresent(pipelined);
+        return false;
+    }
+
+    const int target = drawTarget;
+    SetDrawTarget(0);
+    screenWidth = width;
+    screenHeight = height;
+    const size_t bytes = static_cast<size_t>(GetRowBytes()) * height;
+    framebuffer.assign(bytes, 0);
+    presentedFrame.assign(bytes, 0);
+    if (postProcessor) {
+        expandedFrame.assign(static_cast<size_t>(width) * height, 0);
+    }
+    Surface& screen = *surfaces[0];
+    screen.width = width;
+    screen.height = height;
+    screen.pixels = framebuffer.data();
+    raster.SetTarget(screen.pixels, width, height, framebufferPacked);
+    SetDrawTarget(target);
+    SetPipelinedPresent(pipelined);
+
+    ForceRowUpload(0, screenHeight - 1);
+    std::cout << "AestheticLayer: Resolution set to " << width << "x" << height << "." << std::endl;
+    return true;
+}
+
+bool AestheticLayer::SetPostProcess(const PostProcessor::Settings& settings) {
+    if (settings.scale < 1 || settings.scale > PostProcessor::MAX_SCALE) {
+        std::cerr << "AestheticLayer: Unsupported post-processing scale " << settings.scale << "." << std::endl;
+        return false;
+    }
+
+    // Like SetResolution(), the output image is only resized while the presenter is stopped.
+    const bool pipelined = IsPipelinedPresent();
+    SetPipelinedPresent(false);
+    const int outputWidth = screenWidth * settings.scale;
+    const int outputHeight = screenHeight * settings.scale;
+    if (settings.scale != GetOutputScale() && !backend->Resize(outputWidth, outputHeight)) {
+        std::cerr << "AestheticLayer: The " << backend->GetName() << " backend could not resize to " << outputWidth
+                  << "x" << outputHeight << "." << std::endl;
+        SetPipelinedPresent(pipelined);
+        return false;
+    }
+
+    if (settings.IsIdentity()) {
+        postProcessor.reset();
+        expandedFrame = {};
+    } else {
+        postProcessor = std::make_unique<PostProcessor>(settings, *backend);
+        expandedFrame.assign(static_cast<size_t>(screenWidth) * screenHeight, 0);
+    }
+    SetPipelinedPresent(pipelined);
+
+    // The whole output image has to be produced again.
+    ForceRowUpload(0, screenHeight - 1);
+    if (postProcessor) {
+        std::cout << "AestheticLayer: Post-processing to " << outputWidth << "x" << outputHeight << " on "
+                  << settings.threads << " threads (scanlines " << int(settings.scanlines) << ", shadow mask "
+                  << int(settings.shadowMask) << ", bloom " << int(settings.bloom) << ")." << std::endl;
+    } else {
+        std::cout << "AestheticLayer: Post-processing disabled." << std::endl;
+    }
+    return true;
+}
+
+bool AestheticLayer::SetFramebufferPacked(bool packed) {
+    Surface& screen = *surfaces[0];
+    if (packed == framebufferPacked) {
+        return true;
+    }
+    if (packed && palette.size() > 16) {
+        std::cerr << "AestheticLayer: Cannot pack the framebuffer, the palette has " << palette.size()
+                  << " colors." << std::endl;
+        return false;
+    }
+
+    // Convert the screen in place of the old buffer. Drawing state carries over; the presenter
+    // must be idle, as it reads presentedFrame with the layout of the frame it was handed.
+    const int target = drawTarget;
+    SetDrawTarget(0);
+    std::vector<uint8_t> converted(packed ? framebuffer.size() / 2 : framebuffer.size() * 2);
+    for (size_t i = 0; i < framebuffer.size(); ++i) {
+        if (packed) {
+            converted[i / 2] |= static_cast<uint8_t>((framebuffer[i] & 0x0F) << ((i & 1) * 4));
+        } else {
+            converted[2 * i] = framebuffer[i] & 0x0F;
+            converted[2 * i + 1] = framebuffer[i] >> 4;
+        }
+    }
+    {
+        std::unique_lock<std::mutex> lock(presenterMutex);
+        presenterCondition.wait(lock, [this] { return !frameSubmitted; });
+        framebuffer.swap(converted);
+        presentedFrame.assign(framebuffer.size(), 0);
+        if (presenterThread.joinable()) {
+            submittedFrame.assign(framebuffer.size(), 0);
+        }
+        framebufferPacked = packed;
+        screen.packed = packed;
+        screen.pixels = framebuffer.data();
+    }
+    raster.SetTarget(screen.pixels, screen.width, screen.height, packed);
+    SetDrawTarget(target);
+
+    // presentedFrame no longer describes the backend's contents.
+    ForceRowUpload(0, screenHeight - 1);
+    std::cout << "AestheticLayer: Framebuffer stored at " << (packed ? 4 : 8) << " bits per pixel." << std::endl;
+    return true;
+}
+
+void AestheticLayer::RebuildPaletteLUT() {
+    // Colors are packed in the backend's own format, so no further conversion happens on upload.
+    // Indices outside the palette (e.g. left over after a shrink) map to opaque black.
+    paletteLUT.fill(backend->MapColor(SDL_Color{0, 0, 0, 255}));
+    for (size_t i = 0; i < palette.size() && i < paletteLUT.size(); ++i) {
+        paletteLUT[i] = backend->MapColor(palette[i]);
+    }
+    RebuildDisplayLUTs(0, screenHeight - 1);
+}
+
+void AestheticLayer::RebuildDisplayLUTs(int y0, int y1) {
+    // Composing the display palette into the LUT keeps conversion at one lookup per pixel.
+    for (int bank = 0; bank < DISPLAY_PALETTE_BANKS; ++bank) {
+        for (size_t i = 0; i < paletteLUT.size(); ++i) {
+            displayLUTs[bank][i] = paletteLUT[displayPalettes[bank][i]];
+        }
+    }
+
+    // Every uploaded pixel in these rows may now have a different color.
+    ForceRowUpload(y0, y1);
+}
+
+void AestheticLayer::MarkScreenRowsDirty(int y0, int y1) {
+    if (drawTarget == 0) {
+        raster.MarkDirtyRows(y0, y1);
+    } else {
+        screenDirtyMinY = std::min(screenDirtyMinY, y0);
+        screenDirtyMaxY = std::max(screenDirtyMaxY, y1);
+    }
+}
+
+void AestheticLayer::ForceRowUpload(int y0, int y1) {
+    if (y0 > y1) {
+        return;
+    }
+    forcedMinY = std::min(forcedMinY, y0);
+    forcedMaxY = std::max(forcedMaxY, y1);
+    MarkScreenRowsDirty(y0, y1);
+}
+
+void AestheticLayer::InvalidateOutput() {
+    ForceRowUpload(0, screenHeight - 1);
 }
 
 void AestheticLayer::Clear(uint8_t colorIndex) {
-    // Ensure the fill value is of the correct type (uint8_t) to avoid conversion warnings.
-    uint8_t finalColorIndex = colorIndex % static_cast<uint8_t>(palette.size());
-    std::fill(framebuffer.begin(), framebuffer.end(), finalColorIndex);
+    raster.Clear(colorIndex);
 }
 
 void AestheticLayer::SetPixel(int x, int y, uint8_t colorIndex) {
-    // Check for transparent color before drawing.
-    if (transparentColor.has_value() && colorIndex == transparentColor.value()) {
+    raster.SetPixel(x, y, colorIndex);
+}
+
+void AestheticLayer::Line(int x1, int y1, int x2, int y2, uint8_t colorIndex) {
+    raster.Line(x1, y1, x2, y2, colorIndex);
+}
+
+void AestheticLayer::Rect(int x, int y, int w, int h, uint8_t colorIndex) {
+    raster.Rect(x, y, w, h, colorIndex);
+}
+
+void AestheticLayer::RectFill(int x, int y, int w, int h, uint8_t colorIndex) {
+    raster.RectFill(x, y, w, h, colorIndex);
+}
+
+void AestheticLayer::Circ(int centerX, int centerY, int radius, uint8_t colorIndex) {
+    raster.Circ(centerX, centerY, radius, colorIndex);
+}
+
+void AestheticLayer::CircFill(int centerX, int centerY, int radius, uint8_t colorIndex) {
+    raster.CircFill(centerX, centerY, radius, colorIndex);
+}
+
+void AestheticLayer::TriFill(int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint8_t colorIndex) {
+    raster.TriFill(x0, y0, x1, y1, x2, y2, colorIndex);
+}
+
+void AestheticLayer::PolyFill(const int32_t* coords, int vertexCount, uint8_t colorIndex) {
+    raster.PolyFill(coords, vertexCount, colorIndex);
+}
+
+void AestheticLayer::FloodFill(int x, int y, uint8_t colorIndex) {
+    raster.FloodFill(x, y, colorIndex);
+}
+
+uint8_t AestheticLayer::Pget(int x, int y) {
+    return raster.Pget(x, y);
+}
+
+void AestheticLayer::Print(std::string_view text, int x, int y, uint8_t colorIndex) {
+    raster.Print(text, x, y, colorIndex);
+}
+
+void AestheticLayer::SetSpriteSheet(std::shared_ptr<SpriteSheet> sheet) {
+    spriteSheet = std::move(sheet);
+    raster.SetSpriteSheet(spriteSheet.get());
+}
+
+void AestheticLayer::Spr(int n, int x, int y, int w, int h, bool flipX, bool flipY) {
+    raster.Spr(n, x, y, w, h, flipX, flipY);
+}
+
+void AestheticLayer::Sspr(int sx, int sy, int sw, int sh, int dx, int dy, int dw, int dh, bool flipX, bool flipY) {
+    raster.Sspr(sx, sy, sw, sh, dx, dy, dw, dh, flipX, flipY);
+}
+
+void AestheticLayer::SetTilemap(std::shared_ptr<Tilemap> map) {
+    tilemap = std::move(map);
+    raster.SetTilemap(tilemap.get());
+}
+
+void AestheticLayer::Map(int celX, int celY, int x, int y, int celW, int celH) {
+    raster.Map(celX, celY, x, y, celW, celH);
+}
+
+int AestheticLayer::CreateSurface(int w, int h) {
+    if (w <= 0 || h <= 0 || w > MAX_SURFACE_SIZE || h > MAX_SURFACE_SIZE) {
+        return -1;
+    }
+    // Reuse the lowest free id; id 0 is always the screen.
+    size_t id = 1;
+    while (id < surfaces.size() && surfaces[id]) {
+        ++id;
+    }
+    if (id > static_cast<size_t>(MAX_SURFACES)) {
+        std::cerr << "AestheticLayer: Cannot create surface, " << MAX_SURFACES << " are already allocated." << std::endl;
+        return -1;
+    }
+    auto surface = std::make_unique<Surface>();
+    surface->width = w;
+    surface->height = h;
+    surface->storage.assign(static_cast<size_t>(w) * h, 0);
+    surface->pixels = surface->storage.data();
+    if (id == surfaces.size()) {
+        surfaces.push_back(std::move(surface));
+    } else {
+        surfaces[id] = std::move(surface);
+    }
+    return static_cast<int>(id);
+}
+
+void AestheticLayer::FreeSurface(int id) {
+    if (id <= 0 || id >= static_cast<int>(surfaces.size()) || !surfaces[id]) {
         return;
     }
+    if (drawTarget == id) {
+        SetDrawTarget(0);
+    }
+    surfaces[id].reset();
+}
+
+void AestheticLayer::FreeSurfaces() {
+    SetDrawTarget(0);
+    surfaces.resize(1);
+}
 
-    int screenX = x - cameraX;
-    int screenY = y - cameraY;
+bool AestheticLayer::SetDrawTarget(int id) {
+    if (id < 0 || id >= static_cast<int>(surfaces.size()) || !surfaces[id]) {
+        return false;
+    }
+    if (id == drawTarget) {
+        return true;
+    }
 
-    if (screenX >= 0 && screenX < FRAMEBUFFER_WIDTH && screenY >= 0 && screenY < FRAMEBUFFER_HEIGHT) {
-        framebuffer[screenY * FRAMEBUFFER_WIDTH + screenX] = colorIndex % palette.size();
+    // The rasterizer's damage range belongs to the current target; keep the screen's aside.
+    if (drawTarget == 0) {
+        screenDirtyMinY = raster.GetDirtyMinY();
+        screenDirtyMaxY = raster.GetDirtyMaxY();
     }
+    Surface& target = *surfaces[id];
+    raster.SetTarget(target.pixels, target.width, target.height, target.packed);
+    drawTarget = id;
+    if (id == 0 && screenDirtyMinY <= screenDirtyMaxY) {
+        raster.MarkDirtyRows(screenDirtyMinY, screenDirtyMaxY);
+    }
+    return true;
 }
 
-void AestheticLayer::Line(int x1, int y1, int x2, int y2, uint8_t colorIndex) {
-    int dx = std::abs(x2 - x1);
-    int dy = -std::abs(y2 - y1);
-    int sx = (x1 < x2) ? 1 : -1;
-    int sy = (y1 < y2) ? 1 : -1;
-    int err = dx + dy;
+void AestheticLayer::Blit(int sourceId, int sx, int sy, int w, int h, int dx, int dy, bool masked) {
+    raster.Blit(sourceId, sx, sy, w, h, dx, dy, masked);
+}
 
-    while (true) {
-        SetPixel(x1, y1, colorIndex);
-        if (x1 == x2 && y1 == y2) break;
-        int e2 = 2 * err;
-        if (e2 >= dy) {
-            err += dy;
-            x1 += sx;
-        }
-        if (e2 <= dx) {
-            err += dx;
-            y1 += sy;
+void AestheticLayer::Rspr(int sourceId, int sx, int sy, int sw, int sh, int x, int y, int32_t angle, int32_t scaleX, int32_t scaleY) {
+    raster.Rspr(sourceId, sx, sy, sw, sh, x, y, angle, scaleX, scaleY);
+}
+
+void AestheticLayer::Remap(const uint8_t* lut) {
+    raster.Remap(lut);
+}
+
+std::array<uint8_t, 256> AestheticLayer::FadeLUT(double amount, uint8_t colorIndex) const {
+    std::array<uint8_t, 256> lut = Rasterizer::IdentityPalette();
+    if (colorIndex >= palette.size()) {
+        return lut;
+    }
+    amount = std::clamp(amount, 0.0, 1.0);
+    const SDL_Color& target = palette[colorIndex];
+    for (size_t i = 0; i < palette.size(); ++i) {
+        const double r = palette[i].r + (target.r - palette[i].r) * amount;
+        const double g = palette[i].g + (target.g - palette[i].g) * amount;
+        const double b = palette[i].b + (target.b - palette[i].b) * amount;
+        // Nearest palette color; ties keep the color itself, so a zero amount changes nothing.
+        size_t best = i;
+        double bestDistance = (r - palette[i].r) * (r - palette[i].r) + (g - palette[i].g) * (g - palette[i].g) +
+                              (b - palette[i].b) * (b - palette[i].b);
+        for (size_t j = 0; j < palette.size(); ++j) {
+            const double distance = (r - palette[j].r) * (r - palette[j].r) + (g - palette[j].g) * (g - palette[j].g) +
+                                    (b - palette[j].b) * (b - palette[j].b);
+            if (distance < bestDistance) {
+                best = j;
+                bestDistance = distance;
+            }
         }
+        lut[i] = static_cast<uint8_t>(best);
     }
+    return lut;
 }
 
-void AestheticLayer::Rect(int x, int y, int w, int h, uint8_t colorIndex) {
-    if (w <= 0 || h <= 0) return;
-    int x2 = x + w - 1;
-    int y2 = y + h - 1;
+std::array<uint8_t, 256> AestheticLayer::CycleLUT(int first, int last, int step) const {
+    std::array<uint8_t, 256> lut = Rasterizer::IdentityPalette();
+    const int lastColor = static_cast<int>(palette.size()) - 1;
+    first = std::clamp(first, 0, lastColor);
+    last = std::clamp(last, 0, lastColor);
+    if (first >= last) {
+        return lut;
+    }
+    const int length = last - first + 1;
+    const int shift = (step % length + length) % length;
+    for (int i = first; i <= last; ++i) {
+        lut[i] = static_cast<uint8_t>(first + (i - first + shift) % length);
+    }
+    return lut;
+}
+
+void AestheticLayer::Mosaic(int size) {
+    raster.Mosaic(size);
+}
+
+void AestheticLayer::Wobble(int32_t amplitude, int32_t period, int32_t phase) {
+    raster.Wobble(amplitude, period, phase);
+}
 
-    // Draw the 4 lines of the rectangle.
-    for (int i = x; i <= x2; ++i) {
-        SetPixel(i, y, colorIndex);
-        SetPixel(i, y2, colorIndex);
+void AestheticLayer::Dissolve(int level, uint8_t colorIndex) {
+    raster.Dissolve(level, colorIndex);
+}
+
+void AestheticLayer::ExecuteDisplayList(const DisplayList& list, size_t first, size_t last) {
+    // Large lists are binned into screen tiles and rasterized by the worker threads. Lists that
+    // touch shared caches in a way workers could race on (tilemaps, sprites drawn under several
+    // transparency masks) are executed serially.
+    if (tileRasterizer && drawTarget == 0 && last - first >= TileRasterizer::MIN_PARALLEL_COMMANDS &&
+        list.IsParallelSafe()) {
+        if (spriteSheet && list.UsesSprites()) {
+            spriteSheet->PrepareRuns(list.GetSpriteTransparency());
+        }
+        tileRasterizer->Execute(list, first, last, raster);
+        return;
     }
-    for (int i = y + 1; i < y2; ++i) {
-        SetPixel(x, i, colorIndex);
-        SetPixel(x2, i, colorIndex);
+    for (size_t i = first; i < last; ++i) {
+        list.ExecuteCommand(raster, i);
     }
 }
 
-void AestheticLayer::RectFill(int x, int y, int w, int h, uint8_t colorIndex) {
-    int x2 = x + w;
-    int y2 = y + h;
+void AestheticLayer::SetRasterThreads(int threadCount) {
+    if (threadCount <= 1) {
+        tileRasterizer.reset();
+        return;
+    }
+    if (!tileRasterizer || tileRasterizer->GetThreadCount() != threadCount) {
+        tileRasterizer.reset(); // Joins the old workers before new ones start.
+        tileRasterizer = std::make_unique<TileRasterizer>(threadCount);
+        std::cout << "AestheticLayer: Display lists are rasterized on " << threadCount << " threads." << std::endl;
+    }
+}
+
+void AestheticLayer::UploadRows(int y0, int y1, const DisplayLUTs& luts, const ScanlineBanks& banks) {
+    // Expand the indices straight into the backend's memory, or into the staging image.
+    uint32_t* pixels = nullptr;
+    int pitch = 0;
+    if (!LockOutputRows(y0, y1, pixels, pitch)) {
+        return;
+    }
+    ExpandRows(y0, y1, luts, banks, pixels, pitch);
+    UnlockOutputRows();
+}
 
-    for (int j = y; j < y2; ++j) {
-        for (int i = x; i < x2; ++i) {
-            SetPixel(i, j, colorIndex);
+bool AestheticLayer::LockOutputRows(int y0, int y1, uint32_t*& pixels, int& pitch) {
+    if (!stageOutput) {
+        if (backend->LockRows(y0, y1, pixels, pitch)) {
+            return true;
         }
+        // presentedFrame already claims these rows are shown, so the next frame uploads everything.
+        InvalidateOutput();
+        return false;
     }
+
+    // Pipelined: the presenter thread never calls the backend. Rows go to outputStaging and
+    // CommitStagedFrame() uploads them from the thread calling Present().
+    const int scale = GetOutputScale();
+    const int outputWidth = screenWidth * scale;
+    const size_t outputSize = static_cast<size_t>(outputWidth) * screenHeight * scale;
+    if (outputStaging.size() != outputSize) {
+        outputStaging.assign(outputSize, 0);
+    }
+    pixels = &outputStaging[static_cast<size_t>(y0) * outputWidth];
+    pitch = outputWidth * static_cast<int>(sizeof(uint32_t));
+    stagedBands.emplace_back(y0, y1);
+    return true;
 }
 
-void AestheticLayer::Circ(int centerX, int centerY, int radius, uint8_t colorIndex) {
-    if (radius < 0) return;
-    int x = radius;
-    int y = 0;
-    int err = 0;
+void AestheticLayer::UnlockOutputRows() {
+    if (!stageOutput) {
+        backend->UnlockRows();
+    }
+}
+
+void AestheticLayer::CommitStagedFrame() {
+    const size_t rowBytes = static_cast<size_t>(screenWidth) * GetOutputScale() * sizeof(uint32_t);
+    for (const auto& [y0, y1] : stagedBands) {
+        uint32_t* pixels = nullptr;
+        int pitch = 0;
+        if (!backend->LockRows(y0, y1, pixels, pitch)) {
+            InvalidateOutput(); // As in LockOutputRows(); the next submission uploads everything.
+            continue;
+        }
+        for (int y = y0; y < y1; ++y) {
+            std::memcpy(reinterpret_cast<uint8_t*>(pixels) + static_cast<size_t>(y - y0) * pitch,
+                        reinterpret_cast<const uint8_t*>(outputStaging.data()) + static_cast<size_t>(y) * rowBytes,
+                        rowBytes);
+        }
+        backend->UnlockRows();
+    }
+    stagedBands.clear();
+    frameStaged = false;
+    backend->Show();
+}
 
-    while (x >= y) {
-        SetPixel(centerX + x, centerY + y, colorIndex);
-        SetPixel(centerX + y, centerY + x, colorIndex);
-        SetPixel(centerX - y, centerY + x, colorIndex);
-        SetPixel(centerX - x, centerY + y, colorIndex);
-        SetPixel(centerX - x, centerY - y, colorIndex);
-        SetPixel(centerX - y, centerY - x, colorIndex);
-        SetPixel(centerX + y, centerY - x, colorIndex);
-        SetPixel(centerX + x, centerY - y, colorIndex);
+void AestheticLayer::ExpandRows(int y0, int y1, const DisplayLUTs& luts, const ScanlineBanks& banks, uint32_t* pixels,
+                                int pitch) {
+    // One row at a time to honor the pitch.
+    const PixelConversion::ExpandFunc expand = framebufferPacked ? expandPackedKernel : expandKernel;
+    const int rowBytes = GetRowBytes();
+    for (int y = y0; y < y1; ++y) {
+        auto* dst = reinterpret_cast<uint32_t*>(reinterpret_cast<uint8_t*>(pixels) + static_cast<size_t>(y - y0) * pitch);
+        expand(&presentedFrame[static_cast<size_t>(y) * rowBytes], dst, screenWidth, luts[banks[y]].data());
+    }
+}
 
-        if (err <= 0) {
-            y += 1;
-            err += 2 * y + 1;
+void AestheticLayer::UploadPostProcessedBands() {
+    // Bloom makes a row's output depend on its neighbors, so every band grows by the row reach;
+    // bands that then touch are filtered together.
+    const int reach = postProcessor->GetRowReach();
+    const int scale = postProcessor->GetSettings().scale;
+    size_t i = 0;
+    while (i < postProcessBands.size()) {
+        const int y0 = std::max(postProcessBands[i].first - reach, 0);
+        int y1 = std::min(postProcessBands[i].second + reach, screenHeight);
+        for (++i; i < postProcessBands.size() && postProcessBands[i].first - reach <= y1; ++i) {
+            y1 = std::min(postProcessBands[i].second + reach, screenHeight);
         }
-        if (err > 0) {
-            x -= 1;
-            err -= 2 * x + 1;
+
+        uint32_t* pixels = nullptr;
+        int pitch = 0;
+        if (LockOutputRows(y0 * scale, y1 * scale, pixels, pitch)) {
+            postProcessor->Process(expandedFrame.data(), screenWidth, screenHeight, y0, y1, pixels, pitch);
+            UnlockOutputRows();
         }
     }
+    postProcessBands.clear();
 }
 
-void AestheticLayer::CircFill(int centerX, int centerY, int radius, uint8_t colorIndex) {
-    if (radius < 0) return;
-    // Using a simpler, albeit less optimal, scanline method for clarity.
-    for (int dy = -radius; dy <= radius; ++dy) {
-        for (int dx = -radius; dx <= radius; ++dx) {
-            if (dx * dx + dy * dy <= radius * radius) {
-                SetPixel(centerX + dx, centerY + dy, colorIndex);
+namespace {
+
+// Finds the rows in [minY, maxY] of `frame` that differ from `presented`, or lie in the forced
+// range [forcedMinY, forcedMaxY], copies them over and reports each contiguous band [y0, y1) of
+// them to `uploadBand`. Returns the number of rows reported. With a non-zero FixedRowBytes the
+// row size is a compile-time constant, so the memcmp and memcpy of every row are inlined as
+// fixed-length vector code. This is the only part of presenting that depends on the row size.
+template <int FixedRowBytes, typename UploadBand>
+int DiffRows(const uint8_t* frame, uint8_t* presented, int runtimeRowBytes, int minY, int maxY, int forcedMinY,
+             int forcedMaxY, UploadBand&& uploadBand) {
+    const size_t rowBytes = FixedRowBytes != 0 ? FixedRowBytes : static_cast<size_t>(runtimeRowBytes);
+    int uploaded = 0;
+    int bandStart = -1;
+    for (int y = minY; y <= maxY + 1; ++y) {
+        bool changed = false;
+        if (y <= maxY) {
+            const uint8_t* current = &frame[y * rowBytes];
+            uint8_t* presentedRow = &presented[y * rowBytes];
+            changed = (y >= forcedMinY && y <= forcedMaxY) || std::memcmp(current, presentedRow, rowBytes) != 0;
+            if (changed) {
+                std::memcpy(presentedRow, current, rowBytes);
             }
         }
+
+        if (changed && bandStart < 0) {
+            bandStart = y;
+        } else if (!changed && bandStart >= 0) {
+            uploadBand(bandStart, y);
+            uploaded += y - bandStart;
+            bandStart = -1;
+        }
     }
+    return uploaded;
 }
 
-uint8_t AestheticLayer::Pget(int x, int y) {
-    int screenX = x - cameraX;
-    int screenY = y - cameraY;
-
-    if (screenX >= 0 && screenX < FRAMEBUFFER_WIDTH && screenY >= 0 && screenY < FRAMEBUFFER_HEIGHT) {
-        return framebuffer[screenY * FRAMEBUFFER_WIDTH + screenX];
-    }
-    return 0; // Return color 0 (black) for out-of-bounds pixels.
-}
-
-void AestheticLayer::Print(const std::string& text, int x, int y, uint8_t colorIndex) {
-    int cursorX = x;
-    for (const char& c : text) {
-        // Only render printable ASCII characters.
-        if (c >= 32 && c <= 126) {
-            // Calculate the starting index for the character's glyph data.
-            int charIndex = (c - 32) * EmbeddedFont::FONT_HEIGHT;
-
-            // Iterate through the 8 rows of the character's glyph.
-            for (int row = 0; row < EmbeddedFont::FONT_HEIGHT; ++row) {
-                uint8_t rowData = EmbeddedFont::FONT_DATA[charIndex + row];
-
-                // Iterate through the 8 bits of the row data (representing columns).
-                for (int col = 0; col < EmbeddedFont::FONT_WIDTH; ++col) {
-                    // If the bit is set, draw a pixel.
-                    // We check the most significant bit for column 0, so we shift by (7 - col).
-                    if ((rowData >> (7 - col)) & 1) {
-                        SetPixel(cursorX + col, y + row, colorIndex);
-                    }
-                }
-            }
+} // namespace
+
+void AestheticLayer::UploadChangedRows(const uint8_t* frame, const DisplayLUTs& luts, const ScanlineBanks& banks,
+                                       int minY, int maxY, int forcedMinY, int forcedMaxY) {
+    // Within the damaged row range, find the rows whose indices actually differ from what the
+    // backend holds, and convert/upload them as contiguous bands. Carts that redraw an identical
+    // screen every frame end up uploading nothing.
+    // With post-processing, bands are expanded into expandedFrame and filtered afterwards.
+    auto upload = [&](int y0, int y1) {
+        if (postProcessor) {
+            ExpandRows(y0, y1, luts, banks, &expandedFrame[static_cast<size_t>(y0) * screenWidth],
+                       screenWidth * static_cast<int>(sizeof(uint32_t)));
+            postProcessBands.emplace_back(y0, y1);
+        } else {
+            UploadRows(y0, y1, luts, banks);
         }
-        // Advance the cursor for the next character.
-        cursorX += EmbeddedFont::FONT_WIDTH; // Character spacing is now built into the font glyphs.
+    };
+    const int rowBytes = GetRowBytes();
+    uint8_t* presented = presentedFrame.data();
+    int uploaded;
+    // Row sizes of the supported resolutions (128, 256, 320 and 480 wide), 8bpp and packed.
+    switch (rowBytes) {
+        case 64:  uploaded = DiffRows<64>(frame, presented, rowBytes, minY, maxY, forcedMinY, forcedMaxY, upload); break;
+        case 128: uploaded = DiffRows<128>(frame, presented, rowBytes, minY, maxY, forcedMinY, forcedMaxY, upload); break;
+        case 160: uploaded = DiffRows<160>(frame, presented, rowBytes, minY, maxY, forcedMinY, forcedMaxY, upload); break;
+        case 240: uploaded = DiffRows<240>(frame, presented, rowBytes, minY, maxY, forcedMinY, forcedMaxY, upload); break;
+        case 256: uploaded = DiffRows<256>(frame, presented, rowBytes, minY, maxY, forcedMinY, forcedMaxY, upload); break;
+        case 320: uploaded = DiffRows<320>(frame, presented, rowBytes, minY, maxY, forcedMinY, forcedMaxY, upload); break;
+        case 480: uploaded = DiffRows<480>(frame, presented, rowBytes, minY, maxY, forcedMinY, forcedMaxY, upload); break;
+        default:  uploaded = DiffRows<0>(frame, presented, rowBytes, minY, maxY, forcedMinY, forcedMaxY, upload); break;
+    }
+    if (postProcessor) {
+        UploadPostProcessedBands();
     }
+    lastUploadRowCount = uploaded;
 }
 
-void AestheticLayer::Present() {
-    // 1. Translate our color-indexed framebuffer to a 32-bit pixel buffer.
-    for (size_t i = 0; i < framebuffer.size(); ++i) {
-        const auto& color = palette[framebuffer[i]];
-        // ARGB8888 format
-        pixelBuffer[i] = (color.a << 24) | (color.r << 16) | (color.g << 8) | color.b;
+void AestheticLayer::ResetDamage() {
+    if (drawTarget == 0) {
+        raster.ResetDamage();
+    }
+    screenDirtyMinY = screenHeight;
+    screenDirtyMaxY = -1;
+    forcedMinY = screenHeight;
+    forcedMaxY = -1;
+}
+
+bool AestheticLayer::StartCapture(const std::string& path, FrameCapture::Format format) {
+    StopCapture();
+    try {
+        capture = std::make_unique<FrameCapture>(path, format);
+    } catch (const std::exception& e) {
+        std::cerr << "AestheticLayer: " << e.what() << std::endl;
+        return false;
+    }
+    std::cout << "AestheticLayer: Capturing frames to " << path << "." << std::endl;
+    return true;
+}
+
+void AestheticLayer::StopCapture() {
+    capture.reset();
+}
+
+bool AestheticLayer::ScreenMatches(const std::vector<uint8_t>& shown) const {
+    if (forcedMinY <= forcedMaxY) {
+        return false;
     }
+    const int minY = GetScreenDirtyMinY();
+    const int maxY = GetScreenDirtyMaxY();
+    if (minY > maxY) {
+        return true;
+    }
+    const size_t rowBytes = static_cast<size_t>(GetRowBytes());
+    return std::memcmp(&framebuffer[minY * rowBytes], &shown[minY * rowBytes], (maxY - minY + 1) * rowBytes) == 0;
+}
 
-    // 2. Update the SDL texture with our pixel buffer.
-    SDL_UpdateTexture(texture, nullptr, pixelBuffer.data(), FRAMEBUFFER_WIDTH * sizeof(uint32_t));
+bool AestheticLayer::Present() {
+    if (capture) {
+        FrameCapture::FrameView frame;
+        frame.pixels = framebuffer.data();
+        frame.width = screenWidth;
+        frame.height = screenHeight;
+        frame.packed = framebufferPacked;
+        frame.rowBanks = scanlineBanks.data();
+        frame.displayPalettes = displayPalettes.data();
+        frame.bankCount = displayPalettes.size();
+        frame.palette = palette.data();
+        frame.paletteSize = palette.size();
+        capture->Submit(frame);
+    }
 
-    // 3. Clear the renderer.
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255); // Black background for the letterbox bars
-    SDL_RenderClear(renderer);
+    if (!presenterThread.joinable()) {
+        // Single-threaded: convert, upload and present on the calling thread.
+        if (skipUnchangedFrames && ScreenMatches(presentedFrame)) {
+            ResetDamage();
+            lastUploadRowCount = 0;
+            ++skippedFrameCount;
+            return false;
+        }
+        // Damage is reset first, so an upload that fails can force the next one again.
+        const int minY = GetScreenDirtyMinY();
+        const int maxY = GetScreenDirtyMaxY();
+        const int forcedY0 = forcedMinY;
+        const int forcedY1 = forcedMaxY;
+        ResetDamage();
+        UploadChangedRows(framebuffer.data(), displayLUTs, scanlineBanks, minY, maxY, forcedY0, forcedY1);
+        backend->Show();
+        return true;
+    }
 
-    // 4. Copy the texture to the renderer, scaling it to fit the window while maintaining aspect ratio.
-    SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+    // Pipelined: wait until the presenter has staged the previous frame and show it from here,
+    // then hand over a snapshot of this one. At most one frame is ever waiting, so frames are
+    // shown strictly in submission order and the caller never runs more than one frame ahead.
+    {
+        std::unique_lock<std::mutex> lock(presenterMutex);
+        presenterCondition.wait(lock, [this] { return !frameSubmitted; });
+    }
+    // The presenter is idle until the next submission, so the slot and the staged frame are ours.
+    if (frameStaged) {
+        CommitStagedFrame();
+    }
+    // The slot still holds the previous submission, i.e. the frame last shown.
+    if (skipUnchangedFrames && ScreenMatches(submittedFrame)) {
+        ResetDamage();
+        lastUploadRowCount = 0;
+        ++skippedFrameCount;
+        return false;
+    }
+    std::memcpy(submittedFrame.data(), framebuffer.data(), framebuffer.size());
+    submittedLUTs = displayLUTs;
+    submittedBanks = scanlineBanks;
+    submittedMinY = GetScreenDirtyMinY();
+    submittedMaxY = GetScreenDirtyMaxY();
+    submittedForcedMinY = forcedMinY;
+    submittedForcedMaxY = forcedMaxY;
+    {
+        std::lock_guard<std::mutex> lock(presenterMutex);
+        frameSubmitted = true;
+    }
+    presenterCondition.notify_all();
+    ResetDamage();
+    return true;
+}
 
-    // 5. Show the result on the screen.
-    SDL_RenderPresent(renderer);
-}
\ No newline at end of file
+void AestheticLayer::SetPipelinedPresent(bool enabled) {
+    if (enabled == presenterThread.joinable()) {
+        return;
+    }
+
+    if (enabled) {
+        submittedFrame = presentedFrame; // What the backend shows, so unchanged frames can be told apart.
+        stopPresenter = false;
+        stageOutput = true;
+        presenterThread = std::thread(&AestheticLayer::PresenterLoop, this);
+        std::cout << "AestheticLayer: Pipelined present enabled." << std::endl;
+    } else {
+        // The presenter drains any submitted frame before it exits.
+        {
+            std::lock_guard<std::mutex> lock(presenterMutex);
+            stopPresenter = true;
+        }
+        presenterCondition.notify_all();
+        presenterThread.join();
+        if (frameStaged) {
+            CommitStagedFrame();
+        }
+        stageOutput = false;
+        std::cout << "AestheticLayer: Pipelined present disabled." << std::endl;
+    }
+}
+
+void AestheticLayer::PresenterLoop() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(presenterMutex);
+            presenterCondition.wait(lock, [this] { return frameSubmitted || stopPresenter; });
+            if (!frameSubmitted) {
+                return; // Stop requested and nothing left to present.
+            }
+        }
+
+        // The submission slot stays owned by this thread until its rows have been consumed.
+        // Diffing, palette expansion and post-processing overlap the main thread's next frame;
+        // the rows land in outputStaging, which the main thread uploads and shows.
+        UploadChangedRows(submittedFrame.data(), submittedLUTs, submittedBanks, submittedMinY, submittedMaxY,
+                          submittedForcedMinY, submittedForcedMaxY);
+        {
+            std::lock_guard<std::mutex> lock(presenterMutex);
+            frameSubmitted = false;
+            frameStaged = true;
+        }
+        presenterCondition.notify_all();
+    }
+}
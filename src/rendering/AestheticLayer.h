@@ -4,27 +4,116 @@
 #include <SDL.h>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <cstdint>
 #include <optional>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <utility>
+#include "rendering/FrameCapture.h"
+#include "rendering/PixelConversion.h"
+#include "rendering/PostProcessor.h"
+#include "rendering/Rasterizer.h"
+#include "rendering/RenderBackend.h"
+#include "rendering/SpriteSheet.h"
+#include "rendering/Surface.h"
+#include "rendering/TileRasterizer.h"
+#include "cartridge/Tilemap.h"
+
+class DisplayList; // Forward declaration
 
 class AestheticLayer {
 public:
-    // Defines the fantasy console's framebuffer dimensions.
+    // Defines the fantasy console's default framebuffer dimensions.
     static constexpr int FRAMEBUFFER_WIDTH = 256;
     static constexpr int FRAMEBUFFER_HEIGHT = 256;
 
-    AestheticLayer(SDL_Renderer* renderer);
+    // Largest resolution a cartridge may request with SetResolution().
+    static constexpr int MAX_FRAMEBUFFER_WIDTH = 1024;
+    static constexpr int MAX_FRAMEBUFFER_HEIGHT = 1024;
+
+    // Limits on offscreen surfaces: how many a cart may hold at once, and their largest side.
+    static constexpr int MAX_SURFACES = 64;
+    static constexpr int MAX_SURFACE_SIZE = 1024;
+
+    // Number of display palettes that scanlines can select between.
+    static constexpr int DISPLAY_PALETTE_BANKS = 16;
+
+    // Presents through a streaming texture on the given SDL renderer.
+    explicit AestheticLayer(SDL_Renderer* renderer);
+    // Presents through an arbitrary backend, e.g. a SoftwareRenderBackend for headless use.
+    explicit AestheticLayer(std::unique_ptr<RenderBackend> backend);
     ~AestheticLayer();
 
     // Sets the camera offset for all subsequent drawing operations.
     void SetCamera(int x, int y);
+    int GetCameraX() const { return raster.GetCameraX(); }
+    int GetCameraY() const { return raster.GetCameraY(); }
 
     // Sets the color that will be treated as transparent during drawing operations.
     void SetTransparentColor(std::optional<uint8_t> colorIndex);
 
-    // Resizes the color palette.
+    // Adds or removes one color from the set of transparent colors.
+    void SetTransparent(uint8_t colorIndex, bool transparent);
+    const TransparencyMask& GetTransparency() const { return raster.GetTransparency(); }
+
+    // Draw palette: every later draw of color `from` writes color `to` into the framebuffer.
+    void SetDrawPaletteEntry(uint8_t from, uint8_t to);
+    void ResetDrawPalette();
+
+    // Fill pattern: a 4x4 bitmask, bit 15 at the top left and read row by row, laid over the
+    // screen. Fills, outlines, lines and points draw `altColor` where a bit is set, or leave the
+    // pixel alone if it is empty. Pattern 0 draws solid.
+    void SetFillPattern(uint16_t pattern, std::optional<uint8_t> altColor);
+
+    // Restricts drawing to the screen rectangle (x, y, w, h). The camera does not move it.
+    void SetClip(int x, int y, int w, int h);
+    // Allows drawing on the whole screen again.
+    void ResetClip();
+
+    // The complete drawing state (camera, transparency, draw palette, clip, fill pattern).
+    const Rasterizer::DrawState& GetDrawState() const { return raster.GetDrawState(); }
+    void SetDrawState(const Rasterizer::DrawState& state);
+
+    // Display palettes: applied by Present() when the framebuffer is converted, so they change
+    // what is shown without rewriting any pixel. Framebuffer index `from` is shown as palette
+    // color `to` on every row that selects `bank`. All rows select bank 0 by default.
+    void SetDisplayPaletteEntry(int bank, uint8_t from, uint8_t to);
+    // Makes rows [y0, y1] use display palette `bank`.
+    void SetScanlinePalette(int y0, int y1, int bank);
+    // Restores identity display palettes and bank 0 on every row.
+    void ResetDisplayPalettes();
+
+    // Resizes the color palette. Palettes of more than 16 colors turn off the packed framebuffer.
     void ResizePalette(size_t new_size);
 
+    // Stores the screen at 4 bits per pixel, two pixels per byte, halving framebuffer memory and
+    // the bytes drawing and presenting touch. Only possible with at most 16 palette colors;
+    // returns false otherwise. The screen contents are kept across the switch.
+    bool SetFramebufferPacked(bool packed);
+    bool IsFramebufferPacked() const { return framebufferPacked; }
+
+    // Changes the screen to width x height pixels, resizing the backend's output image. The
+    // width must be even and neither side may exceed the MAX_FRAMEBUFFER_ limits; returns false
+    // otherwise. The new screen is cleared to color 0. For 128x128, 256x256, 320x180 and 480x270
+    // the diff and copy of changed rows (DiffRows) use the row size as a compile-time constant;
+    // everything else, including expansion and upload, is the same for every size.
+    bool SetResolution(int width, int height);
+    int GetScreenWidth() const { return screenWidth; }
+    int GetScreenHeight() const { return screenHeight; }
+
+    // Runs the expanded screen through a PostProcessor before it reaches the backend, whose
+    // output image becomes scale times the screen size on each axis. Identity settings turn the
+    // stage off again. Returns false for a scale outside 1 to PostProcessor::MAX_SCALE or if the
+    // backend cannot be resized.
+    bool SetPostProcess(const PostProcessor::Settings& settings);
+    // Output pixels per screen pixel on each axis.
+    int GetOutputScale() const { return postProcessor ? postProcessor->GetSettings().scale : 1; }
+
     // Clears the framebuffer with a palette color index.
     void Clear(uint8_t colorIndex);
 
@@ -46,24 +135,251 @@ public:
     // Draws a filled circle.
     void CircFill(int centerX, int centerY, int radius, uint8_t colorIndex);
 
+    // Fills a triangle or a polygon (x, y pairs, filled even-odd). Vertices are fixed point with
+    // Rasterizer::FIXED_SHIFT fractional bits; pixels are filled when their center is inside.
+    void TriFill(int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint8_t colorIndex);
+    void PolyFill(const int32_t* coords, int vertexCount, uint8_t colorIndex);
+
+    // Fills the 4-connected area of pixels sharing the color at (x, y) with a color, like a
+    // paint bucket. The fill stays inside the clip rectangle and follows the fill pattern.
+    void FloodFill(int x, int y, uint8_t colorIndex);
+
     // Gets the color index of a pixel at the given coordinates.
     uint8_t Pget(int x, int y);
 
     // Draws text on the framebuffer using the embedded font.
-    void Print(const std::string& text, int x, int y, uint8_t colorIndex);
+    void Print(std::string_view text, int x, int y, uint8_t colorIndex);
+
+    // Sets the sprite sheet used by Spr and Sspr. Pass nullptr to disable sprite drawing.
+    void SetSpriteSheet(std::shared_ptr<SpriteSheet> sheet);
+    SpriteSheet* GetSpriteSheet() const { return spriteSheet.get(); }
+
+    // Draws sprite n, optionally spanning w x h sprites, at (x, y). Transparent colors are skipped.
+    void Spr(int n, int x, int y, int w = 1, int h = 1, bool flipX = false, bool flipY = false);
+
+    // Draws the sheet rectangle (sx, sy, sw, sh) stretched to (dx, dy, dw, dh).
+    void Sspr(int sx, int sy, int sw, int sh, int dx, int dy, int dw, int dh, bool flipX = false, bool flipY = false);
+
+    // Sets the tilemap used by Map. Pass nullptr to disable map drawing.
+    void SetTilemap(std::shared_ptr<Tilemap> map);
+    Tilemap* GetTilemap() const { return tilemap.get(); }
+
+    // Draws the celW x celH map cells starting at (celX, celY) with their top-left corner at (x, y).
+    // Empty cells (sprite 0) and transparent pixels are skipped.
+    void Map(int celX, int celY, int x, int y, int celW, int celH);
+
+    // --- Offscreen surfaces ---
+    // Surface 0 is the screen. CreateSurface returns the id of a new w x h surface cleared to
+    // color 0, or -1 if the size is out of range or MAX_SURFACES are already allocated.
+    int CreateSurface(int w, int h);
+    // Frees an offscreen surface; drawing returns to the screen if it was the target.
+    void FreeSurface(int id);
+    // Frees every offscreen surface, e.g. when a new cartridge starts.
+    void FreeSurfaces();
+    // Makes every drawing call (and Pget) operate on surface `id`. Returns false for unknown ids.
+    bool SetDrawTarget(int id);
+    int GetDrawTarget() const { return drawTarget; }
+    // Copies the w x h rectangle at (sx, sy) of surface `sourceId` to (dx, dy) on the draw target,
+    // honoring the camera, clip rectangle and draw palette. With `masked`, transparent colors
+    // are skipped; otherwise rows are copied whole.
+    void Blit(int sourceId, int sx, int sy, int w, int h, int dx, int dy, bool masked = false);
+    // Draws the sw x sh rectangle at (sx, sy) of surface `sourceId`, or of the sprite sheet for
+    // Rasterizer::SPRITE_SHEET_SOURCE, scaled and then rotated counterclockwise by `angle` turns
+    // about its center, which lands on (x, y). Angle and scales are Rasterizer::AFFINE_ONE fixed
+    // point. Transparent colors are skipped.
+    void Rspr(int sourceId, int sx, int sy, int sw, int sh, int x, int y, int32_t angle, int32_t scaleX, int32_t scaleY);
+
+    // Effects rewrite the pixels of the draw target inside the clip rectangle, whatever drew
+    // them; the camera, draw palette, transparency and fill pattern do not apply.
+    // Replaces every pixel's color c with lut[c] (256 entries), e.g. from FadeLUT or CycleLUT.
+    // Entries beyond the palette wrap around it, as draw colors do.
+    void Remap(const uint8_t* lut);
+    // Table taking each palette color `amount` (0 to 1) of the way to color `colorIndex`, snapped
+    // to the nearest palette color, so a fade steps along ramps of the palette's own colors.
+    std::array<uint8_t, 256> FadeLUT(double amount, uint8_t colorIndex) const;
+    // Table rotating colors [first, last] by `step` places within that range. The range is
+    // limited to the palette, so every color maps to a palette color.
+    std::array<uint8_t, 256> CycleLUT(int first, int last, int step) const;
+    // Pixelates the target into size x size blocks.
+    void Mosaic(int size);
+    // Shifts every row sideways along a sine wave, wrapping around; see Rasterizer::Wobble.
+    void Wobble(int32_t amplitude, int32_t period, int32_t phase);
+    // Ordered-dither dissolve into a color, `level` from 0 to Rasterizer::DISSOLVE_LEVELS.
+    void Dissolve(int level, uint8_t colorIndex);
+
+    // Executes commands [first, last) of a recorded display list. With raster threads enabled,
+    // large lists are rasterized in parallel, producing the same pixels as serial execution.
+    void ExecuteDisplayList(const DisplayList& list, size_t first, size_t last);
+
+    // Sets the number of threads used to rasterize display lists. 0 or 1 keeps it serial.
+    void SetRasterThreads(int threadCount);
+    int GetRasterThreads() const { return tileRasterizer ? tileRasterizer->GetThreadCount() : 1; }
 
     // Renders the framebuffer to the main window.
-    void Present();
+    // Only rows that changed since the previous Present() are converted and uploaded.
+    // In pipelined mode this shows the frame staged by the presenter thread and hands it a
+    // snapshot of this one.
+    // Returns false if the frame was skipped because it matched the one last shown.
+    bool Present();
+
+    // When enabled, Present() skips conversion, upload and the backend's present for frames
+    // identical to the one last shown, and counts them. The caller then has no vsync-blocking
+    // present to pace it and should wait for its next tick itself.
+    void SetSkipUnchangedFrames(bool enabled) { skipUnchangedFrames = enabled; }
+    bool IsSkippingUnchangedFrames() const { return skipUnchangedFrames; }
+    uint64_t GetSkippedFrameCount() const { return skippedFrameCount; }
+
+    // Forces the next Present() to upload and show the whole screen, e.g. after the window
+    // contents were lost.
+    void InvalidateOutput();
+
+    // Enables or disables the presenter thread. When enabled, the row diff, palette conversion
+    // and post-processing of a frame run on a dedicated thread into a staging image while the
+    // caller starts its next frame; the next Present() uploads the staged rows and shows them.
+    // The backend (and any SDL renderer behind it) is only ever called from the thread calling
+    // Present(), so frames are shown one Present() late. Disabling shows the pending frame and
+    // returns to single-threaded mode.
+    void SetPipelinedPresent(bool enabled);
+    bool IsPipelinedPresent() const { return presenterThread.joinable(); }
+
+    // Records every presented frame to `path` until StopCapture(), encoding on a background
+    // thread (see FrameCapture). Present() only copies the indexed screen into a ring; frames
+    // are dropped, and counted, when the encoder falls behind. A running capture is stopped
+    // first. Returns false if the file cannot be created.
+    bool StartCapture(const std::string& path, FrameCapture::Format format);
+    // Waits for the queued frames to be encoded and finishes the file.
+    void StopCapture();
+    bool IsCapturing() const { return capture != nullptr; }
+    // Frames the current capture has queued and dropped so far.
+    uint64_t GetCapturedFrameCount() const { return capture ? capture->GetQueuedFrames() : 0; }
+    uint64_t GetDroppedCaptureFrameCount() const { return capture ? capture->GetDroppedFrames() : 0; }
+
+    // Number of framebuffer rows converted and uploaded by the last Present() call.
+    int GetLastUploadRowCount() const { return lastUploadRowCount; }
+
+    // The color-indexed framebuffer, row-major, GetScreenWidth() bytes per row; half that when
+    // packed, with the left pixel of each pair in the low nibble.
+    const std::vector<uint8_t>& GetFramebuffer() const { return framebuffer; }
+
+    // The backend receiving the palette-expanded output image.
+    RenderBackend* GetBackend() const { return backend.get(); }
 
 private:
-    SDL_Renderer* renderer;
-    SDL_Texture* texture;
-    std::vector<uint32_t> pixelBuffer; // Pixel buffer in ARGB8888 format for the texture.
-    std::vector<uint8_t> framebuffer;  // Color index buffer (256x256).
+    using PaletteLUT = std::array<uint32_t, PixelConversion::LUT_SIZE>;
+    using DisplayLUTs = std::array<PaletteLUT, DISPLAY_PALETTE_BANKS>;
+    using ScanlineBanks = std::array<uint8_t, MAX_FRAMEBUFFER_HEIGHT>;
+
+    // Rebuilds the 32-bit lookup table from the palette. Must run after every palette change.
+    void RebuildPaletteLUT();
+
+    // Rebuilds the per-bank LUTs from paletteLUT and the display palettes, and forces the
+    // rows [y0, y1] to be converted again on the next Present().
+    void RebuildDisplayLUTs(int y0, int y1);
+
+    // Converts rows [y0, y1) of presentedFrame into the backend, each row through the LUT of its bank.
+    void UploadRows(int y0, int y1, const DisplayLUTs& luts, const ScanlineBanks& banks);
+
+    // Converts rows [y0, y1) of presentedFrame to `pixels`, whose rows are `pitch` bytes apart.
+    void ExpandRows(int y0, int y1, const DisplayLUTs& luts, const ScanlineBanks& banks, uint32_t* pixels, int pitch);
+
+    // Filters the rows listed in postProcessBands, and the rows they reach, into the backend.
+    void UploadPostProcessedBands();
+
+    // Write access to output rows [y0, y1): the backend's memory, or outputStaging while the
+    // presenter thread is running.
+    bool LockOutputRows(int y0, int y1, uint32_t*& pixels, int& pitch);
+    void UnlockOutputRows();
+
+    // Uploads the rows staged by the presenter thread to the backend and shows them. Must run
+    // on the thread calling Present(), while the presenter is idle.
+    void CommitStagedFrame();
+
+    // Bytes per framebuffer row.
+    int GetRowBytes() const { return framebufferPacked ? screenWidth / 2 : screenWidth; }
+
+    // Diffs rows [minY, maxY] of `frame` against presentedFrame and uploads the rows that changed,
+    // and the rows in [forcedMinY, forcedMaxY] in any case.
+    void UploadChangedRows(const uint8_t* frame, const DisplayLUTs& luts, const ScanlineBanks& banks,
+                           int minY, int maxY, int forcedMinY, int forcedMaxY);
+
+    // Marks the framebuffer as fully presented.
+    void ResetDamage();
+
+    // Makes the next Present() upload rows [y0, y1] even if their indices did not change.
+    void ForceRowUpload(int y0, int y1);
+
+    // True if the screen matches `shown`, the frame last handed to the backend, in every
+    // damaged row, and nothing else forces an upload.
+    bool ScreenMatches(const std::vector<uint8_t>& shown) const;
+
+    // Screen damage. While an offscreen surface is the draw target, the rasterizer tracks that
+    // surface instead, and the screen's dirty rows are kept in screenDirtyMinY/MaxY.
+    void MarkScreenRowsDirty(int y0, int y1);
+    int GetScreenDirtyMinY() const { return drawTarget == 0 ? raster.GetDirtyMinY() : screenDirtyMinY; }
+    int GetScreenDirtyMaxY() const { return drawTarget == 0 ? raster.GetDirtyMaxY() : screenDirtyMaxY; }
+
+    // Body of the presenter thread used by pipelined mode.
+    void PresenterLoop();
+
+    std::unique_ptr<RenderBackend> backend; // Receives the expanded image; the palette LUT is packed in its format.
+    std::vector<uint8_t> framebuffer;  // Color index buffer (screenWidth x screenHeight).
+    // Screen size, and whether framebuffer (and presentedFrame) hold two pixels per byte. These
+    // only change while the presenter thread is idle, so it reads them without a lock.
+    int screenWidth = FRAMEBUFFER_WIDTH;
+    int screenHeight = FRAMEBUFFER_HEIGHT;
+    bool framebufferPacked = false;
+    Rasterizer raster; // Draws into framebuffer; holds camera, transparency and the damaged row range.
+    std::unique_ptr<TileRasterizer> tileRasterizer; // Worker threads for display lists, if enabled.
+    std::vector<std::unique_ptr<Surface>> surfaces; // By id; [0] views framebuffer, null entries are free.
+    int drawTarget = 0;
+    int screenDirtyMinY = FRAMEBUFFER_HEIGHT;
+    int screenDirtyMaxY = -1;
+    std::vector<uint8_t> presentedFrame; // Indices last uploaded to the backend; owned by the presenting thread.
     std::vector<SDL_Color> palette;    // 16-color palette.
-    int cameraX = 0;
-    int cameraY = 0;
-    std::optional<uint8_t> transparentColor;
+    PaletteLUT paletteLUT{}; // Palette pre-packed in the backend's format.
+    std::array<std::array<uint8_t, 256>, DISPLAY_PALETTE_BANKS> displayPalettes; // Index remaps applied at present.
+    ScanlineBanks scanlineBanks{}; // Display palette bank of every framebuffer row.
+    DisplayLUTs displayLUTs{};     // paletteLUT composed with each display palette.
+    PixelConversion::ExpandFunc expandKernel = nullptr; // Index-to-ARGB kernel chosen at startup.
+    PixelConversion::ExpandFunc expandPackedKernel = nullptr; // The same for the packed framebuffer.
+    // Optional post-processing stage. When set, changed rows are expanded into expandedFrame
+    // (screenWidth x screenHeight) and their bands collected, then filtered into the backend.
+    // Owned by the presenting thread like presentedFrame.
+    std::unique_ptr<PostProcessor> postProcessor;
+    std::vector<uint32_t> expandedFrame;
+    std::vector<std::pair<int, int>> postProcessBands;
+    std::unique_ptr<FrameCapture> capture; // Receives every presented frame while recording.
+    std::shared_ptr<SpriteSheet> spriteSheet;
+    std::shared_ptr<Tilemap> tilemap;
+
+    // Damage tracking: the rasterizer's dirty rows may differ from presentedFrame.
+    // Rows [forcedMinY, forcedMaxY] are uploaded without diffing, as the texture no longer matches
+    // presentedFrame there (e.g. after a palette or bank change). Starts as the whole screen.
+    int forcedMinY = 0;
+    int forcedMaxY = MAX_FRAMEBUFFER_HEIGHT - 1;
+    std::atomic<int> lastUploadRowCount{0};
+    bool skipUnchangedFrames = false;
+    uint64_t skippedFrameCount = 0;
+
+    // Pipelined present: a single submission slot handed from the drawing thread to the presenter.
+    std::thread presenterThread;
+    std::mutex presenterMutex;
+    std::condition_variable presenterCondition;
+    bool frameSubmitted = false; // Guarded by presenterMutex.
+    bool stopPresenter = false;  // Guarded by presenterMutex.
+    std::vector<uint8_t> submittedFrame;
+    DisplayLUTs submittedLUTs{};
+    ScanlineBanks submittedBanks{};
+    int submittedMinY = 0;
+    int submittedMaxY = -1;
+    int submittedForcedMinY = 0;
+    int submittedForcedMaxY = -1;
+    // Output rows produced by the presenter, waiting for CommitStagedFrame(). frameStaged is set
+    // together with clearing frameSubmitted; both belong to the main thread while it is false.
+    bool stageOutput = false; // Set while the presenter thread runs.
+    std::vector<uint32_t> outputStaging; // Output width x height, like the backend's image.
+    std::vector<std::pair<int, int>> stagedBands;
+    bool frameStaged = false; // Guarded by presenterMutex.
 };
 
 #endif // AESTHETIC_LAYER_H
\ No newline at end of file
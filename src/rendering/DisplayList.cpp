@@ -0,0 +1,328 @@
+#include "rendering/DisplayList.h"
+#include "rendering/AestheticLayer.h"
+#include "rendering/EmbeddedFont.h"
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+void DisplayList::Begin(const Rasterizer::DrawState& startState, int screenWidth, int screenHeight) {
+    arena.clear(); // Both buffers keep their capacity, so a steady stream of frames does not allocate.
+    commands.clear();
+    flushedCommands = 0;
+    culledCount = 0;
+    this->startState = startState;
+    this->screenWidth = screenWidth;
+    this->screenHeight = screenHeight;
+    Resume(startState);
+    usesMap = false;
+    readsScreen = false;
+    usesSprites = false;
+    mixedSpriteTransparency = false;
+    spriteTransparency = TransparencyMask{};
+}
+
+void DisplayList::Resume(const Rasterizer::DrawState& state) {
+    cameraX = state.cameraX;
+    cameraY = state.cameraY;
+    transparency = state.transparency;
+    SetVisibleArea(state.clipX0, state.clipY0, state.clipX1, state.clipY1);
+}
+
+void DisplayList::Push(Op op, uint8_t color, uint8_t flags, std::initializer_list<int32_t> args) {
+    const Header header{op, color, flags, static_cast<uint8_t>(args.size())};
+    const size_t offset = arena.size();
+    arena.resize(offset + sizeof(Header) + args.size() * sizeof(int32_t));
+    std::memcpy(&arena[offset], &header, sizeof(Header));
+    if (args.size() != 0) {
+        std::memcpy(&arena[offset + sizeof(Header)], args.begin(), args.size() * sizeof(int32_t));
+    }
+    commands.push_back(Command{static_cast<uint32_t>(offset), 0, screenHeight - 1});
+}
+
+void DisplayList::SetVisibleArea(long long x0, long long y0, long long x1, long long y1) {
+    visibleX0 = std::max(x0, 0LL);
+    visibleY0 = std::max(y0, 0LL);
+    visibleX1 = std::min<long long>(x1, screenWidth) - 1;
+    visibleY1 = std::min<long long>(y1, screenHeight) - 1;
+}
+
+void DisplayList::PushBounded(long long x0, long long y0, long long x1, long long y1,
+                              Op op, uint8_t color, uint8_t flags, std::initializer_list<int32_t> args) {
+    const long long top = y0 - cameraY;
+    const long long bottom = y1 - cameraY;
+    if (x1 - cameraX < visibleX0 || bottom < visibleY0 || x0 - cameraX > visibleX1 || top > visibleY1 ||
+        visibleX0 > visibleX1 || visibleY0 > visibleY1) {
+        ++culledCount;
+        return;
+    }
+    Push(op, color, flags, args);
+    commands.back().top = static_cast<int32_t>(std::max(top, visibleY0));
+    commands.back().bottom = static_cast<int32_t>(std::min(bottom, visibleY1));
+}
+
+void DisplayList::NoteSpriteDraw() {
+    if (!usesSprites) {
+        usesSprites = true;
+        spriteTransparency = transparency;
+    } else if (!(spriteTransparency == transparency)) {
+        mixedSpriteTransparency = true;
+    }
+}
+
+// Calls that draw nothing (empty rectangles, negative radii, empty text) are not recorded.
+
+void DisplayList::Clear(uint8_t colorIndex) {
+    Push(Op::Clear, colorIndex, 0, {});
+}
+
+void DisplayList::SetPixel(int x, int y, uint8_t colorIndex) {
+    PushBounded(x, y, x, y, Op::SetPixel, colorIndex, 0, {x, y});
+}
+
+void DisplayList::Line(int x1, int y1, int x2, int y2, uint8_t colorIndex) {
+    PushBounded(std::min(x1, x2), std::min(y1, y2), std::max(x1, x2), std::max(y1, y2),
+                Op::Line, colorIndex, 0, {x1, y1, x2, y2});
+}
+
+void DisplayList::Rect(int x, int y, int w, int h, uint8_t colorIndex) {
+    if (w <= 0 || h <= 0) return;
+    PushBounded(x, y, static_cast<long long>(x) + w - 1, static_cast<long long>(y) + h - 1,
+                Op::Rect, colorIndex, 0, {x, y, w, h});
+}
+
+void DisplayList::RectFill(int x, int y, int w, int h, uint8_t colorIndex) {
+    if (w <= 0 || h <= 0) return;
+    PushBounded(x, y, static_cast<long long>(x) + w - 1, static_cast<long long>(y) + h - 1,
+                Op::RectFill, colorIndex, 0, {x, y, w, h});
+}
+
+void DisplayList::Circ(int centerX, int centerY, int radius, uint8_t colorIndex) {
+    if (radius < 0) return;
+    PushBounded(static_cast<long long>(centerX) - radius, static_cast<long long>(centerY) - radius,
+                static_cast<long long>(centerX) + radius, static_cast<long long>(centerY) + radius,
+                Op::Circ, colorIndex, 0, {centerX, centerY, radius});
+}
+
+void DisplayList::CircFill(int centerX, int centerY, int radius, uint8_t colorIndex) {
+    if (radius < 0) return;
+    PushBounded(static_cast<long long>(centerX) - radius, static_cast<long long>(centerY) - radius,
+                static_cast<long long>(centerX) + radius, static_cast<long long>(centerY) + radius,
+                Op::CircFill, colorIndex, 0, {centerX, centerY, radius});
+}
+
+// The pixel containing a fixed-point coordinate (the shift rounds towards negative infinity).
+static long long FixedToPixel(int32_t v) {
+    return v >> Rasterizer::FIXED_SHIFT;
+}
+
+void DisplayList::TriFill(int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint8_t colorIndex) {
+    PushBounded(FixedToPixel(std::min({x0, x1, x2})), FixedToPixel(std::min({y0, y1, y2})),
+                FixedToPixel(std::max({x0, x1, x2})), FixedToPixel(std::max({y0, y1, y2})),
+                Op::TriFill, colorIndex, 0, {x0, y0, x1, y1, x2, y2});
+}
+
+void DisplayList::PolyFill(const int32_t* coords, int vertexCount, uint8_t colorIndex) {
+    if (vertexCount < 3) return;
+    int32_t minX = coords[0], maxX = coords[0], minY = coords[1], maxY = coords[1];
+    for (int i = 1; i < vertexCount; ++i) {
+        minX = std::min(minX, coords[2 * i]);
+        maxX = std::max(maxX, coords[2 * i]);
+        minY = std::min(minY, coords[2 * i + 1]);
+        maxY = std::max(maxY, coords[2 * i + 1]);
+    }
+    const size_t before = commands.size();
+    PushBounded(FixedToPixel(minX), FixedToPixel(minY), FixedToPixel(maxX), FixedToPixel(maxY),
+                Op::PolyFill, colorIndex, 0, {vertexCount});
+    if (commands.size() != before) {
+        const auto* bytes = reinterpret_cast<const uint8_t*>(coords);
+        arena.insert(arena.end(), bytes, bytes + static_cast<size_t>(vertexCount) * 2 * sizeof(int32_t));
+    }
+}
+
+void DisplayList::FloodFill(int x, int y, uint8_t colorIndex) {
+    // The filled area depends on what is already drawn, so it may cover any row.
+    readsScreen = true;
+    Push(Op::FloodFill, colorIndex, 0, {x, y});
+}
+
+void DisplayList::Print(std::string_view text, int x, int y, uint8_t colorIndex) {
+    if (text.empty()) return;
+    // Text runs left to right on a single row of glyphs.
+    const long long width = static_cast<long long>(text.size()) * EmbeddedFont::FONT_WIDTH;
+    const size_t before = commands.size();
+    PushBounded(x, y, x + width - 1, static_cast<long long>(y) + EmbeddedFont::FONT_HEIGHT - 1,
+                Op::Print, colorIndex, 0, {x, y, static_cast<int32_t>(text.size())});
+    if (commands.size() != before) {
+        arena.insert(arena.end(), text.begin(), text.end());
+    }
+}
+
+void DisplayList::Spr(int n, int x, int y, int w, int h, bool flipX, bool flipY) {
+    if (w <= 0 || h <= 0) return;
+    const long long size = SpriteSheet::SPRITE_SIZE;
+    NoteSpriteDraw();
+    PushBounded(x, y, x + w * size - 1, y + h * size - 1,
+                Op::Spr, 0, (flipX ? FLAG_FLIP_X : 0) | (flipY ? FLAG_FLIP_Y : 0), {n, x, y, w, h});
+}
+
+void DisplayList::Sspr(int sx, int sy, int sw, int sh, int dx, int dy, int dw, int dh, bool flipX, bool flipY) {
+    if (dw <= 0 || dh <= 0) return;
+    NoteSpriteDraw();
+    PushBounded(dx, dy, static_cast<long long>(dx) + dw - 1, static_cast<long long>(dy) + dh - 1,
+                Op::Sspr, 0, (flipX ? FLAG_FLIP_X : 0) | (flipY ? FLAG_FLIP_Y : 0), {sx, sy, sw, sh, dx, dy, dw, dh});
+}
+
+void DisplayList::Map(int celX, int celY, int x, int y, int celW, int celH) {
+    if (celW <= 0 || celH <= 0) return;
+    const long long tile = Tilemap::TILE_SIZE;
+    usesMap = true;
+    PushBounded(x, y, x + celW * tile - 1, y + celH * tile - 1, Op::Map, 0, 0, {celX, celY, x, y, celW, celH});
+}
+
+void DisplayList::Blit(int sourceId, int sx, int sy, int w, int h, int dx, int dy, bool masked) {
+    if (w <= 0 || h <= 0) return;
+    if (sourceId == 0) readsScreen = true;
+    PushBounded(dx, dy, static_cast<long long>(dx) + w - 1, static_cast<long long>(dy) + h - 1,
+                Op::Blit, 0, masked ? FLAG_MASKED : 0, {sourceId, sx, sy, w, h, dx, dy});
+}
+
+void DisplayList::Rspr(int sourceId, int sx, int sy, int sw, int sh, int x, int y, int32_t angle, int32_t scaleX, int32_t scaleY) {
+    if (sw <= 0 || sh <= 0) return;
+    if (sourceId == 0) readsScreen = true;
+    // Whatever the angle, the rotated rectangle stays within half its scaled diagonal of (x, y).
+    const double one = Rasterizer::AFFINE_ONE;
+    const double reach = std::min(std::hypot(sw * (scaleX / one), sh * (scaleY / one)) / 2 + 2, 1e12);
+    const long long extent = static_cast<long long>(reach);
+    PushBounded(x - extent, y - extent, x + extent, y + extent,
+                Op::Rspr, 0, 0, {sourceId, sx, sy, sw, sh, x, y, angle, scaleX, scaleY});
+}
+
+void DisplayList::SetCamera(int x, int y) {
+    cameraX = x;
+    cameraY = y;
+    Push(Op::SetCamera, 0, 0, {x, y});
+}
+
+void DisplayList::SetClip(int x, int y, int w, int h) {
+    SetVisibleArea(x, y, static_cast<long long>(x) + std::max(w, 0), static_cast<long long>(y) + std::max(h, 0));
+    Push(Op::SetClip, 0, 0, {x, y, w, h});
+}
+
+void DisplayList::ResetClip() {
+    SetVisibleArea(0, 0, Rasterizer::UNCLIPPED, Rasterizer::UNCLIPPED);
+    Push(Op::ResetClip, 0, 0, {});
+}
+
+void DisplayList::SetTransparentColor(std::optional<uint8_t> colorIndex) {
+    transparency = TransparencyMask::FromColor(colorIndex);
+    Push(Op::SetTransparentColor, colorIndex.value_or(0), colorIndex ? FLAG_HAS_COLOR : 0, {});
+}
+
+void DisplayList::SetTransparent(uint8_t colorIndex, bool transparent) {
+    transparency.Set(colorIndex, transparent);
+    Push(Op::SetTransparent, colorIndex, transparent ? FLAG_TRANSPARENT : 0, {});
+}
+
+void DisplayList::SetDrawPaletteEntry(uint8_t from, uint8_t to) {
+    Push(Op::SetDrawPaletteEntry, from, 0, {to});
+}
+
+void DisplayList::ResetDrawPalette() {
+    Push(Op::ResetDrawPalette, 0, 0, {});
+}
+
+void DisplayList::SetFillPattern(uint16_t pattern, std::optional<uint8_t> altColor) {
+    Push(Op::SetFillPattern, altColor.value_or(0), altColor ? FLAG_HAS_COLOR : 0, {pattern});
+}
+
+void DisplayList::Remap(const uint8_t* lut) {
+    Push(Op::Remap, 0, 0, {});
+    arena.insert(arena.end(), lut, lut + 256);
+}
+
+void DisplayList::Mosaic(int size) {
+    // Each block takes its color from its first row, which may lie in another tile.
+    readsScreen = true;
+    Push(Op::Mosaic, 0, 0, {size});
+}
+
+void DisplayList::Wobble(int32_t amplitude, int32_t period, int32_t phase) {
+    Push(Op::Wobble, 0, 0, {amplitude, period, phase});
+}
+
+void DisplayList::Dissolve(int level, uint8_t colorIndex) {
+    Push(Op::Dissolve, colorIndex, 0, {level});
+}
+
+void DisplayList::Flush(AestheticLayer& layer) {
+    layer.ExecuteDisplayList(*this, flushedCommands, commands.size());
+    flushedCommands = commands.size();
+}
+
+void DisplayList::Replay(AestheticLayer& layer) const {
+    layer.SetDrawState(startState);
+    layer.ExecuteDisplayList(*this, 0, commands.size());
+}
+
+void DisplayList::ExecuteCommand(Rasterizer& raster, size_t index) const {
+    size_t offset = commands[index].offset;
+    Header header;
+    std::memcpy(&header, &arena[offset], sizeof(Header));
+    offset += sizeof(Header);
+    int32_t a[10];
+    std::memcpy(a, &arena[offset], header.argCount * sizeof(int32_t));
+    offset += header.argCount * sizeof(int32_t);
+
+    const bool flipX = (header.flags & FLAG_FLIP_X) != 0;
+    const bool flipY = (header.flags & FLAG_FLIP_Y) != 0;
+    switch (header.op) {
+        case Op::Clear:    raster.Clear(header.color); break;
+        case Op::SetPixel: raster.SetPixel(a[0], a[1], header.color); break;
+        case Op::Line:     raster.Line(a[0], a[1], a[2], a[3], header.color); break;
+        case Op::Rect:     raster.Rect(a[0], a[1], a[2], a[3], header.color); break;
+        case Op::RectFill: raster.RectFill(a[0], a[1], a[2], a[3], header.color); break;
+        case Op::Circ:     raster.Circ(a[0], a[1], a[2], header.color); break;
+        case Op::CircFill: raster.CircFill(a[0], a[1], a[2], header.color); break;
+        case Op::TriFill:  raster.TriFill(a[0], a[1], a[2], a[3], a[4], a[5], header.color); break;
+        case Op::PolyFill: {
+            // The arena is byte-aligned; copy the vertices out before handing them over.
+            static thread_local std::vector<int32_t> vertices;
+            vertices.resize(static_cast<size_t>(a[0]) * 2);
+            std::memcpy(vertices.data(), &arena[offset], vertices.size() * sizeof(int32_t));
+            raster.PolyFill(vertices.data(), a[0], header.color);
+            break;
+        }
+        case Op::FloodFill: raster.FloodFill(a[0], a[1], header.color); break;
+        case Op::Print: {
+            const auto* text = reinterpret_cast<const char*>(&arena[offset]);
+            raster.Print(std::string_view(text, a[2]), a[0], a[1], header.color);
+            break;
+        }
+        case Op::Spr:      raster.Spr(a[0], a[1], a[2], a[3], a[4], flipX, flipY); break;
+        case Op::Sspr:     raster.Sspr(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], flipX, flipY); break;
+        case Op::Map:      raster.Map(a[0], a[1], a[2], a[3], a[4], a[5]); break;
+        case Op::Blit:
+            raster.Blit(a[0], a[1], a[2], a[3], a[4], a[5], a[6], (header.flags & FLAG_MASKED) != 0);
+            break;
+        case Op::Rspr:     raster.Rspr(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8], a[9]); break;
+        case Op::SetCamera: raster.SetCamera(a[0], a[1]); break;
+        case Op::SetClip:   raster.SetClipRect(a[0], a[1], a[2], a[3]); break;
+        case Op::ResetClip: raster.ResetClip(); break;
+        case Op::SetTransparentColor:
+            raster.SetTransparentColor((header.flags & FLAG_HAS_COLOR) ? std::optional<uint8_t>(header.color) : std::nullopt);
+            break;
+        case Op::SetTransparent:
+            raster.SetTransparent(header.color, (header.flags & FLAG_TRANSPARENT) != 0);
+            break;
+        case Op::SetDrawPaletteEntry: raster.SetDrawPaletteEntry(header.color, static_cast<uint8_t>(a[0])); break;
+        case Op::ResetDrawPalette:    raster.ResetDrawPalette(); break;
+        case Op::SetFillPattern:
+            raster.SetFillPattern(static_cast<uint16_t>(a[0]),
+                                  (header.flags & FLAG_HAS_COLOR) ? std::optional<uint8_t>(header.color) : std::nullopt);
+            break;
+        case Op::Remap:    raster.Remap(&arena[offset]); break;
+        case Op::Mosaic:   raster.Mosaic(a[0]); break;
+        case Op::Wobble:   raster.Wobble(a[0], a[1], a[2]); break;
+        case Op::Dissolve: raster.Dissolve(a[0], header.color); break;
+    }
+}
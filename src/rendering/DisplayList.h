@@ -0,0 +1,164 @@
+#ifndef DISPLAY_LIST_H
+#define DISPLAY_LIST_H
+
+#include <vector>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include <initializer_list>
+#include "rendering/Rasterizer.h"
+#include "rendering/TransparencyMask.h"
+
+class AestheticLayer; // Forward declaration
+
+/// @class DisplayList
+/// @brief A per-frame recording of draw calls, executed against an AestheticLayer in one pass.
+///
+/// The recording methods mirror the AestheticLayer drawing API. Commands are packed into a
+/// byte arena that keeps its capacity between frames, so steady-state recording does not
+/// allocate. Commands that land entirely off screen under the camera in effect are dropped
+/// while recording; every other command keeps the screen rows it can touch, so the list can
+/// be binned into screen tiles. A finished list can be replayed to redraw an unchanged frame.
+class DisplayList {
+public:
+    // Starts a new recording for a screen of screenWidth x screenHeight pixels. `startState` is
+    // the layer's drawing state at the start of the frame; Replay() restores it before executing
+    // the commands.
+    void Begin(const Rasterizer::DrawState& startState, int screenWidth, int screenHeight);
+
+    // Continues recording after the layer was drawn to directly (e.g. on an offscreen surface)
+    // and left in `state`; commands recorded from here on are culled against it.
+    void Resume(const Rasterizer::DrawState& state);
+
+    // --- Recording, mirroring AestheticLayer ---
+    void Clear(uint8_t colorIndex);
+    void SetPixel(int x, int y, uint8_t colorIndex);
+    void Line(int x1, int y1, int x2, int y2, uint8_t colorIndex);
+    void Rect(int x, int y, int w, int h, uint8_t colorIndex);
+    void RectFill(int x, int y, int w, int h, uint8_t colorIndex);
+    void Circ(int centerX, int centerY, int radius, uint8_t colorIndex);
+    void CircFill(int centerX, int centerY, int radius, uint8_t colorIndex);
+    void TriFill(int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint8_t colorIndex);
+    void PolyFill(const int32_t* coords, int vertexCount, uint8_t colorIndex);
+    void FloodFill(int x, int y, uint8_t colorIndex);
+    void Print(std::string_view text, int x, int y, uint8_t colorIndex);
+    void Spr(int n, int x, int y, int w, int h, bool flipX, bool flipY);
+    void Sspr(int sx, int sy, int sw, int sh, int dx, int dy, int dw, int dh, bool flipX, bool flipY);
+    void Map(int celX, int celY, int x, int y, int celW, int celH);
+    void Blit(int sourceId, int sx, int sy, int w, int h, int dx, int dy, bool masked);
+    void Rspr(int sourceId, int sx, int sy, int sw, int sh, int x, int y, int32_t angle, int32_t scaleX, int32_t scaleY);
+    void SetCamera(int x, int y);
+    void SetClip(int x, int y, int w, int h);
+    void ResetClip();
+    void SetTransparentColor(std::optional<uint8_t> colorIndex);
+    void SetTransparent(uint8_t colorIndex, bool transparent);
+    void SetDrawPaletteEntry(uint8_t from, uint8_t to);
+    void ResetDrawPalette();
+    void SetFillPattern(uint16_t pattern, std::optional<uint8_t> altColor);
+    void Remap(const uint8_t* lut);
+    void Mosaic(int size);
+    void Wobble(int32_t amplitude, int32_t period, int32_t phase);
+    void Dissolve(int level, uint8_t colorIndex);
+
+    // Executes the commands recorded since the last Flush() (or Begin()) on the layer.
+    void Flush(AestheticLayer& layer);
+
+    // Restores the starting drawing state, then executes the whole list.
+    void Replay(AestheticLayer& layer) const;
+
+    // Executes command `index` on a rasterizer.
+    void ExecuteCommand(Rasterizer& raster, size_t index) const;
+
+    // Screen rows [top, bottom] command `index` can write. State changes and clears span every row.
+    int GetCommandTop(size_t index) const { return commands[index].top; }
+    int GetCommandBottom(size_t index) const { return commands[index].bottom; }
+
+    // True if the commands can be executed by several threads at once. Tilemap draws, and
+    // sprites drawn under more than one transparency mask, rebuild shared caches as they run;
+    // blits from the screen, flood fills and mosaics read rows that other tiles write.
+    bool IsParallelSafe() const { return !usesMap && !mixedSpriteTransparency && !readsScreen; }
+
+    // Whether any sprite is drawn, and the transparency mask all sprite draws use.
+    bool UsesSprites() const { return usesSprites; }
+    const TransparencyMask& GetSpriteTransparency() const { return spriteTransparency; }
+
+    // Number of commands recorded, and of commands dropped as off screen, since Begin().
+    size_t GetCommandCount() const { return commands.size(); }
+    size_t GetCulledCount() const { return culledCount; }
+
+    // Bytes of arena in use by the current recording.
+    size_t GetByteSize() const { return arena.size(); }
+
+private:
+    enum class Op : uint8_t {
+        Clear, SetPixel, Line, Rect, RectFill, Circ, CircFill, TriFill, PolyFill, FloodFill, Print, Spr, Sspr, Map, Blit, Rspr, SetCamera, SetClip, ResetClip, SetTransparentColor,
+        SetTransparent, SetDrawPaletteEntry, ResetDrawPalette, SetFillPattern, Remap, Mosaic, Wobble, Dissolve
+    };
+
+    // Every command starts with this header, followed by argCount int32 arguments.
+    // Print is additionally followed by its text, whose length is its last argument, and
+    // PolyFill by its vertex coordinates, whose count of x, y pairs is its only argument, and
+    // Remap by its 256-entry lookup table.
+    struct Header {
+        Op op;
+        uint8_t color;
+        uint8_t flags;
+        uint8_t argCount;
+    };
+
+    // Index entry of a recorded command: where it starts in the arena and the screen rows it covers.
+    struct Command {
+        uint32_t offset;
+        int32_t top;
+        int32_t bottom;
+    };
+
+    static constexpr uint8_t FLAG_FLIP_X = 1;
+    static constexpr uint8_t FLAG_FLIP_Y = 2;
+    static constexpr uint8_t FLAG_HAS_COLOR = 1; // SetTransparentColor / SetFillPattern: the color is used.
+    static constexpr uint8_t FLAG_TRANSPARENT = 1; // SetTransparent: the color becomes transparent.
+    static constexpr uint8_t FLAG_MASKED = 1;      // Blit: transparent colors are skipped.
+
+    // Appends a command covering every screen row.
+    void Push(Op op, uint8_t color, uint8_t flags, std::initializer_list<int32_t> args);
+
+    // Appends a drawing command covering the world-space box [x0, x1] x [y0, y1], or drops it if
+    // the box is entirely outside the screen and clip rectangle under the camera in effect at
+    // this point of the recording.
+    void PushBounded(long long x0, long long y0, long long x1, long long y1,
+                     Op op, uint8_t color, uint8_t flags, std::initializer_list<int32_t> args);
+
+    // Notes a sprite draw under the transparency mask in effect while recording.
+    void NoteSpriteDraw();
+
+    std::vector<uint8_t> arena;
+    std::vector<Command> commands;
+    size_t flushedCommands = 0;
+    size_t culledCount = 0;
+
+    Rasterizer::DrawState startState;
+    int screenWidth = 0;
+    int screenHeight = 0;
+
+    // Camera, visible screen rectangle (clip cut to the screen, inclusive) and transparency in
+    // effect at the current end of the recording.
+    int cameraX = 0;
+    int cameraY = 0;
+    long long visibleX0 = 0;
+    long long visibleY0 = 0;
+    long long visibleX1 = 0;
+    long long visibleY1 = 0;
+    TransparencyMask transparency;
+
+    // Recomputes the visible rectangle from a clip rectangle [x0, x1) x [y0, y1).
+    void SetVisibleArea(long long x0, long long y0, long long x1, long long y1);
+
+    bool usesMap = false;
+    bool readsScreen = false;
+    bool usesSprites = false;
+    bool mixedSpriteTransparency = false;
+    TransparencyMask spriteTransparency;
+};
+
+#endif // DISPLAY_LIST_H
@@ -0,0 +1,284 @@
+#include "rendering/FrameCapture.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+void PutU16(std::vector<uint8_t>& out, int value) {
+    out.push_back(static_cast<uint8_t>(value & 0xFF));
+    out.push_back(static_cast<uint8_t>((value >> 8) & 0xFF));
+}
+
+void PutU32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        out.push_back(static_cast<uint8_t>((value >> shift) & 0xFF));
+    }
+}
+
+// Variable-length LZW as GIF uses it: 8-bit symbols, codes of 9 to 12 bits packed LSB first
+// and split into sub-blocks of at most 255 bytes.
+class GifLzwWriter {
+public:
+    explicit GifLzwWriter(std::vector<uint8_t>& out) : out(out) {}
+
+    void Encode(const uint8_t* symbols, size_t count) {
+        out.push_back(MIN_CODE_SIZE);
+        ResetTable();
+        Emit(CLEAR_CODE);
+        if (count != 0) {
+            int prefix = symbols[0];
+            for (size_t i = 1; i < count; ++i) {
+                const int symbol = symbols[i];
+                const int key = (prefix << 8) | symbol;
+                size_t slot = Find(key);
+                if (keys[slot] == key) {
+                    prefix = codes[slot];
+                    continue;
+                }
+                Emit(prefix);
+                if (nextCode < MAX_CODES) {
+                    keys[slot] = key;
+                    codes[slot] = static_cast<int16_t>(nextCode++);
+                    // The decoder adds its entries one code later, so it widens its codes
+                    // once the table has outgrown the current size.
+                    if (nextCode > (1 << codeSize) && codeSize < 12) {
+                        ++codeSize;
+                    }
+                } else {
+                    Emit(CLEAR_CODE);
+                    ResetTable();
+                }
+                prefix = symbol;
+            }
+            Emit(prefix);
+        }
+        Emit(END_CODE);
+        if (bitCount > 0) {
+            PutByte(static_cast<uint8_t>(bitBuffer));
+        }
+        FlushBlock();
+        out.push_back(0); // Block terminator.
+    }
+
+private:
+    static constexpr int MIN_CODE_SIZE = 8;
+    static constexpr int CLEAR_CODE = 1 << MIN_CODE_SIZE;
+    static constexpr int END_CODE = CLEAR_CODE + 1;
+    static constexpr int MAX_CODES = 4096;
+    static constexpr size_t TABLE_SIZE = 8192; // Open addressing, at most half full.
+
+    void ResetTable() {
+        keys.assign(TABLE_SIZE, -1);
+        codes.resize(TABLE_SIZE);
+        nextCode = END_CODE + 1;
+        codeSize = MIN_CODE_SIZE + 1;
+    }
+
+    size_t Find(int key) const {
+        size_t slot = (static_cast<uint32_t>(key) * 2654435761u) >> 19;
+        while (keys[slot] != -1 && keys[slot] != key) {
+            slot = (slot + 1) & (TABLE_SIZE - 1);
+        }
+        return slot;
+    }
+
+    void Emit(int code) {
+        bitBuffer |= static_cast<uint32_t>(code) << bitCount;
+        bitCount += codeSize;
+        while (bitCount >= 8) {
+            PutByte(static_cast<uint8_t>(bitBuffer & 0xFF));
+            bitBuffer >>= 8;
+            bitCount -= 8;
+        }
+    }
+
+    void PutByte(uint8_t byte) {
+        block[blockSize++] = byte;
+        if (blockSize == 255) {
+            FlushBlock();
+        }
+    }
+
+    void FlushBlock() {
+        if (blockSize == 0) return;
+        out.push_back(static_cast<uint8_t>(blockSize));
+        out.insert(out.end(), block, block + blockSize);
+        blockSize = 0;
+    }
+
+    std::vector<uint8_t>& out;
+    std::vector<int> keys;
+    std::vector<int16_t> codes;
+    int nextCode = 0;
+    int codeSize = 0;
+    uint32_t bitBuffer = 0;
+    int bitCount = 0;
+    uint8_t block[255];
+    int blockSize = 0;
+};
+
+} // namespace
+
+FrameCapture::FrameCapture(const std::string& capturePath, Format captureFormat)
+    : path(capturePath), format(captureFormat), file(capturePath, std::ios::binary | std::ios::trunc),
+      startTime(std::chrono::steady_clock::now()) {
+    if (!file) {
+        throw std::runtime_error("Could not create the capture file " + capturePath + ".");
+    }
+    if (format == Format::Raw) {
+        std::vector<uint8_t> header = {'U', 'L', 'I', 'C', 'S', 'R', 'A', 'W'};
+        PutU32(header, 1);
+        file.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+    }
+    encoder = std::thread(&FrameCapture::EncoderLoop, this);
+}
+
+FrameCapture::~FrameCapture() {
+    stopping.store(true, std::memory_order_release);
+    wakeups.fetch_add(1, std::memory_order_release);
+    wakeups.notify_one();
+    encoder.join();
+
+    if (format == Format::Gif && gifWidth != 0) {
+        FlushPendingGif(MIN_GIF_DELAY_CS);
+        const uint8_t trailer = 0x3B;
+        file.write(reinterpret_cast<const char*>(&trailer), 1);
+    }
+    file.close();
+    std::cout << "FrameCapture: Wrote " << path << " (" << GetQueuedFrames() << " frames captured, "
+              << GetDroppedFrames() << " dropped)." << std::endl;
+}
+
+bool FrameCapture::Submit(const FrameView& frame) {
+    const uint64_t write = writeCount.load(std::memory_order_relaxed);
+    if (write - readCount.load(std::memory_order_acquire) == RING_FRAMES) {
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Slots keep their buffers, so steady-state capture does not allocate.
+    Slot& slot = slots[write % RING_FRAMES];
+    const size_t rowBytes = frame.packed ? static_cast<size_t>(frame.width + 1) / 2 : static_cast<size_t>(frame.width);
+    slot.width = frame.width;
+    slot.height = frame.height;
+    slot.packed = frame.packed;
+    slot.pixels.assign(frame.pixels, frame.pixels + rowBytes * frame.height);
+    slot.rowBanks.assign(frame.rowBanks, frame.rowBanks + frame.height);
+    slot.displayPalettes.assign(frame.displayPalettes, frame.displayPalettes + frame.bankCount);
+    slot.palette.fill(SDL_Color{0, 0, 0, 255});
+    std::copy_n(frame.palette, std::min<size_t>(frame.paletteSize, slot.palette.size()), slot.palette.begin());
+    slot.time = std::chrono::steady_clock::now();
+
+    writeCount.store(write + 1, std::memory_order_release);
+    wakeups.fetch_add(1, std::memory_order_release);
+    wakeups.notify_one();
+    return true;
+}
+
+void FrameCapture::EncoderLoop() {
+    while (true) {
+        // Read the wake-up counter before looking at the ring, so a frame submitted in between
+        // changes it and the wait returns at once.
+        const uint32_t seen = wakeups.load(std::memory_order_acquire);
+        const uint64_t read = readCount.load(std::memory_order_relaxed);
+        if (read == writeCount.load(std::memory_order_acquire)) {
+            if (stopping.load(std::memory_order_acquire)) {
+                return;
+            }
+            wakeups.wait(seen, std::memory_order_acquire);
+            continue;
+        }
+        WriteFrame(slots[read % RING_FRAMES]);
+        readCount.store(read + 1, std::memory_order_release);
+    }
+}
+
+void FrameCapture::ResolveIndices(const Slot& slot, std::vector<uint8_t>& indices) {
+    indices.resize(static_cast<size_t>(slot.width) * slot.height);
+    const size_t rowBytes = slot.packed ? static_cast<size_t>(slot.width + 1) / 2 : static_cast<size_t>(slot.width);
+    for (int y = 0; y < slot.height; ++y) {
+        const uint8_t* row = &slot.pixels[y * rowBytes];
+        const size_t bank = slot.rowBanks[y];
+        const uint8_t* remap = bank < slot.displayPalettes.size() ? slot.displayPalettes[bank].data() : nullptr;
+        uint8_t* out = &indices[static_cast<size_t>(y) * slot.width];
+        for (int x = 0; x < slot.width; ++x) {
+            const uint8_t index = slot.packed ? static_cast<uint8_t>((row[x >> 1] >> ((x & 1) * 4)) & 0x0F) : row[x];
+            out[x] = remap ? remap[index] : index;
+        }
+    }
+}
+
+void FrameCapture::WriteFrame(const Slot& slot) {
+    if (format == Format::Gif) {
+        WriteGifFrame(slot);
+    } else {
+        WriteRawFrame(slot);
+    }
+}
+
+void FrameCapture::WriteRawFrame(const Slot& slot) {
+    ResolveIndices(slot, indices);
+    std::vector<uint8_t> header;
+    header.reserve(8 + 768);
+    PutU16(header, slot.width);
+    PutU16(header, slot.height);
+    PutU32(header, static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(slot.time - startTime).count()));
+    for (const SDL_Color& color : slot.palette) {
+        header.insert(header.end(), {color.r, color.g, color.b});
+    }
+    file.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+    file.write(reinterpret_cast<const char*>(indices.data()), static_cast<std::streamsize>(indices.size()));
+}
+
+void FrameCapture::WriteGifFrame(const Slot& slot) {
+    const long long timeCs =
+        std::chrono::duration_cast<std::chrono::milliseconds>(slot.time - startTime).count() / 10;
+    if (gifWidth == 0) {
+        // The first frame fixes the logical screen size.
+        gifWidth = slot.width;
+        gifHeight = slot.height;
+        std::vector<uint8_t> header = {'G', 'I', 'F', '8', '9', 'a'};
+        PutU16(header, gifWidth);
+        PutU16(header, gifHeight);
+        header.insert(header.end(), {0x00, 0x00, 0x00}); // No global color table.
+        // NETSCAPE2.0 application extension: loop forever.
+        header.insert(header.end(), {0x21, 0xFF, 0x0B, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0',
+                                     0x03, 0x01, 0x00, 0x00, 0x00});
+        file.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+    } else if (slot.width != gifWidth || slot.height != gifHeight ||
+               timeCs - pendingGifCs < MIN_GIF_DELAY_CS) {
+        return;
+    }
+    FlushPendingGif(static_cast<int>(std::min<long long>(timeCs - pendingGifCs, 0xFFFF)));
+
+    // Image descriptor with a local 256-color table, then the LZW-coded indices.
+    ResolveIndices(slot, indices);
+    pendingGif.clear();
+    pendingGif.push_back(0x2C);
+    PutU16(pendingGif, 0);
+    PutU16(pendingGif, 0);
+    PutU16(pendingGif, slot.width);
+    PutU16(pendingGif, slot.height);
+    pendingGif.push_back(0x87);
+    for (const SDL_Color& color : slot.palette) {
+        pendingGif.insert(pendingGif.end(), {color.r, color.g, color.b});
+    }
+    GifLzwWriter(pendingGif).Encode(indices.data(), indices.size());
+    pendingGifCs = timeCs;
+}
+
+void FrameCapture::FlushPendingGif(int delayCs) {
+    if (pendingGif.empty()) {
+        return;
+    }
+    // Graphic control extension: how long the frame stays up, no transparency.
+    std::vector<uint8_t> control = {0x21, 0xF9, 0x04, 0x00};
+    PutU16(control, delayCs);
+    control.insert(control.end(), {0x00, 0x00});
+    file.write(reinterpret_cast<const char*>(control.data()), static_cast<std::streamsize>(control.size()));
+    file.write(reinterpret_cast<const char*>(pendingGif.data()), static_cast<std::streamsize>(pendingGif.size()));
+    pendingGif.clear();
+}
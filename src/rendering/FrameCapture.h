@@ -0,0 +1,121 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <SDL.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// @class FrameCapture
+/// @brief Records presented frames to disk on a background thread.
+///
+/// Submit() copies the color-indexed screen, with the palette and display palettes needed to
+/// show it, into a fixed ring of RING_FRAMES slots and returns; it never waits for the disk.
+/// The ring is single-producer, single-consumer: the submitting thread and the encoder thread
+/// only meet through two atomic frame counters. When the encoder falls behind and the ring is
+/// full, new frames are dropped and counted.
+///
+/// Two formats are written:
+/// - Gif: an endlessly looping animated GIF with a 256-entry local color table per frame.
+///   Frames closer than MIN_GIF_DELAY_CS to the previous one are skipped, as most viewers slow
+///   shorter delays down, and frames of a size other than the first are skipped as well.
+/// - Raw: the magic "ULICSRAW", a little-endian uint32 version (1), then per frame uint16
+///   width and height, uint32 milliseconds since the capture started, the 256-color palette as
+///   768 RGB bytes and width x height color indices, with display palettes applied.
+class FrameCapture {
+public:
+    enum class Format { Gif, Raw };
+
+    static constexpr size_t RING_FRAMES = 32;
+    static constexpr int MIN_GIF_DELAY_CS = 2;
+
+    // One frame as the AestheticLayer holds it. `rowBanks` gives each row's display palette,
+    // an index into the `bankCount` tables of `displayPalettes`.
+    struct FrameView {
+        const uint8_t* pixels = nullptr;
+        int width = 0;
+        int height = 0;
+        bool packed = false; // Two pixels per byte, the left one in the low nibble.
+        const uint8_t* rowBanks = nullptr;
+        const std::array<uint8_t, 256>* displayPalettes = nullptr;
+        size_t bankCount = 0;
+        const SDL_Color* palette = nullptr;
+        size_t paletteSize = 0;
+    };
+
+    // Opens `path` for writing and starts the encoder thread. Throws std::runtime_error if the
+    // file cannot be created.
+    FrameCapture(const std::string& path, Format format);
+    // Encodes the frames still in the ring, finishes the file and joins the encoder.
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    // Queues a copy of the frame. Returns false if the ring was full and the frame was dropped.
+    bool Submit(const FrameView& frame);
+
+    const std::string& GetPath() const { return path; }
+    Format GetFormat() const { return format; }
+
+    // Frames queued and frames dropped so far.
+    uint64_t GetQueuedFrames() const { return writeCount.load(std::memory_order_relaxed); }
+    uint64_t GetDroppedFrames() const { return droppedCount.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        int width = 0;
+        int height = 0;
+        bool packed = false;
+        std::vector<uint8_t> pixels;
+        std::vector<uint8_t> rowBanks;
+        std::vector<std::array<uint8_t, 256>> displayPalettes;
+        std::array<SDL_Color, 256> palette{};
+        std::chrono::steady_clock::time_point time;
+    };
+
+    // Body of the encoder thread.
+    void EncoderLoop();
+
+    // Writes one frame in the file's format.
+    void WriteFrame(const Slot& slot);
+    void WriteGifFrame(const Slot& slot);
+    void WriteRawFrame(const Slot& slot);
+
+    // Writes the GIF frame held in pendingGif with the given delay, if there is one.
+    void FlushPendingGif(int delayCs);
+
+    // Expands a slot into one display-remapped color index per pixel.
+    static void ResolveIndices(const Slot& slot, std::vector<uint8_t>& indices);
+
+    std::string path;
+    Format format;
+    std::ofstream file;
+    std::chrono::steady_clock::time_point startTime;
+
+    // The ring. The slot of frame i (i % RING_FRAMES) belongs to the encoder while
+    // readCount <= i < writeCount, and to the submitter otherwise.
+    std::array<Slot, RING_FRAMES> slots;
+    std::atomic<uint64_t> writeCount{0};
+    std::atomic<uint64_t> readCount{0};
+    std::atomic<uint64_t> droppedCount{0};
+    // Bumped after every Submit() and on stop, so the idle encoder can wait on it.
+    std::atomic<uint32_t> wakeups{0};
+    std::atomic<bool> stopping{false};
+    std::thread encoder;
+
+    // Encoder state, only touched by the encoder thread.
+    std::vector<uint8_t> indices;
+    int gifWidth = 0;
+    int gifHeight = 0;
+    std::vector<uint8_t> pendingGif; // Color table and image data of the last frame, awaiting its delay.
+    long long pendingGifCs = 0;      // Its time in centiseconds since the start.
+};
+
+#endif // FRAME_CAPTURE_H
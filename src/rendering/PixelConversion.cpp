@@ -0,0 +1,105 @@
+#include "rendering/PixelConversion.h"
+#include <SDL.h>
+
+#ifdef ULICS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace PixelConversion {
+
+void ExpandScalar(const uint8_t* src, uint32_t* dst, size_t count, const uint32_t* lut) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        dst[i + 0] = lut[src[i + 0]];
+        dst[i + 1] = lut[src[i + 1]];
+        dst[i + 2] = lut[src[i + 2]];
+        dst[i + 3] = lut[src[i + 3]];
+    }
+    for (; i < count; ++i) {
+        dst[i] = lut[src[i]];
+    }
+}
+
+void ExpandPackedScalar(const uint8_t* src, uint32_t* dst, size_t count, const uint32_t* lut) {
+    for (size_t i = 0; i + 2 <= count; i += 2) {
+        const uint8_t pair = src[i / 2];
+        dst[i + 0] = lut[pair & 0x0F];
+        dst[i + 1] = lut[pair >> 4];
+    }
+}
+
+#ifdef ULICS_X86_SIMD
+ULICS_TARGET_AVX2
+void ExpandAVX2(const uint8_t* src, uint32_t* dst, size_t count, const uint32_t* lut) {
+    const int* table = reinterpret_cast<const int*>(lut);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        // Widen 2x8 byte indices to 32-bit lanes and gather their colors from the table.
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m256i lo = _mm256_cvtepu8_epi32(bytes);
+        __m256i hi = _mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_i32gather_epi32(table, lo, 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 8), _mm256_i32gather_epi32(table, hi, 4));
+    }
+    ExpandScalar(src + i, dst + i, count - i, lut);
+}
+
+ULICS_TARGET_AVX2
+void ExpandPackedAVX2(const uint8_t* src, uint32_t* dst, size_t count, const uint32_t* lut) {
+    // Entries 0-7 and 8-15 of the table each fit one register; bit 3 of the index picks between them.
+    const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lut));
+    const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lut + 8));
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m256i seven = _mm256_set1_epi32(7);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        // Split 8 bytes into 16 nibbles in pixel order: low, high, low, high, ...
+        const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i / 2));
+        const __m128i lo = _mm_and_si128(bytes, nibble);
+        const __m128i hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble);
+        const __m128i indices = _mm_unpacklo_epi8(lo, hi);
+        for (int half = 0; half < 2; ++half) {
+            const __m256i lanes = _mm256_cvtepu8_epi32(half == 0 ? indices : _mm_srli_si128(indices, 8));
+            const __m256i useHigh = _mm256_cmpgt_epi32(lanes, seven);
+            const __m256i colors = _mm256_blendv_epi8(_mm256_permutevar8x32_epi32(low, lanes),
+                                                      _mm256_permutevar8x32_epi32(high, lanes), useHigh);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 8 * half), colors);
+        }
+    }
+    ExpandPackedScalar(src + i / 2, dst + i, count - i, lut);
+}
+#endif
+
+ExpandFunc SelectExpandKernel(const char** name) {
+    const char* selectedName = "scalar";
+    ExpandFunc selected = &ExpandScalar;
+#ifdef ULICS_X86_SIMD
+    // Only AVX2 has a gather; a 256-entry table lookup in SSE2 is as many scalar loads and
+    // runs no faster than ExpandScalar, so CPUs without AVX2 use the scalar kernel.
+    if (SDL_HasAVX2()) {
+        selectedName = "AVX2";
+        selected = &ExpandAVX2;
+    }
+#endif
+    if (name) {
+        *name = selectedName;
+    }
+    return selected;
+}
+
+ExpandFunc SelectExpandPackedKernel(const char** name) {
+    const char* selectedName = "scalar";
+    ExpandFunc selected = &ExpandPackedScalar;
+#ifdef ULICS_X86_SIMD
+    if (SDL_HasAVX2()) {
+        selectedName = "AVX2";
+        selected = &ExpandPackedAVX2;
+    }
+#endif
+    if (name) {
+        *name = selectedName;
+    }
+    return selected;
+}
+
+} // namespace PixelConversion
@@ -0,0 +1,48 @@
+#ifndef PIXEL_CONVERSION_H
+#define PIXEL_CONVERSION_H
+
+#include <cstddef>
+#include <cstdint>
+
+/// @brief Kernels that expand palette-indexed pixels into 32-bit texture pixels.
+/// Every kernel reads `count` indices from `src` and writes `count` words to `dst`,
+/// looking each index up in a 256-entry table, so any byte value is a valid index.
+namespace PixelConversion {
+
+constexpr size_t LUT_SIZE = 256;
+
+using ExpandFunc = void (*)(const uint8_t* src, uint32_t* dst, size_t count, const uint32_t* lut);
+
+// Portable fallback, always available.
+void ExpandScalar(const uint8_t* src, uint32_t* dst, size_t count, const uint32_t* lut);
+
+// Packed variants: `src` holds two indices per byte, the first in the low nibble, so only the
+// first 16 table entries are used. `count` is in pixels and must be even.
+void ExpandPackedScalar(const uint8_t* src, uint32_t* dst, size_t count, const uint32_t* lut);
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ULICS_X86_SIMD 1
+
+// GCC and Clang only emit AVX2 instructions inside functions that opt in;
+// MSVC accepts the intrinsics anywhere.
+#if defined(__GNUC__) || defined(__clang__)
+#define ULICS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define ULICS_TARGET_AVX2
+#endif
+
+// Eight lookups per iteration using the AVX2 gather instruction.
+void ExpandAVX2(const uint8_t* src, uint32_t* dst, size_t count, const uint32_t* lut);
+// Sixteen pixels per iteration from two in-register permutes of the 16-entry table; no gathers.
+void ExpandPackedAVX2(const uint8_t* src, uint32_t* dst, size_t count, const uint32_t* lut);
+#endif
+
+/// @brief Picks the fastest kernel the running CPU supports: AVX2 if available, else scalar.
+/// @param name Optional out-parameter receiving a human-readable kernel name.
+ExpandFunc SelectExpandKernel(const char** name = nullptr);
+// The same for packed sources.
+ExpandFunc SelectExpandPackedKernel(const char** name = nullptr);
+
+} // namespace PixelConversion
+
+#endif // PIXEL_CONVERSION_H
@@ -0,0 +1,329 @@
+#include "rendering/PostProcessor.h"
+#include "rendering/PixelConversion.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef ULICS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Byte-wise helpers on whole pixels. Every channel is treated alike; the weights decide what
+// happens to each one.
+
+// Each byte of a scaled by (w + 1) / 256, so a weight of 255 keeps it unchanged.
+uint32_t MultiplyPixel(uint32_t a, uint32_t w) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        const uint32_t product = ((a >> shift) & 0xFF) * (((w >> shift) & 0xFF) + 1);
+        result |= (product >> 8) << shift;
+    }
+    return result;
+}
+
+// Rounded-up average of each byte pair, like the SIMD average instructions.
+uint32_t AveragePixels(uint32_t a, uint32_t b) {
+    return (a | b) - (((a ^ b) >> 1) & 0x7F7F7F7Fu);
+}
+
+// Each byte of a + b, or of a - b, saturated to 0-255.
+uint32_t AddPixels(uint32_t a, uint32_t b) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        result |= std::min<uint32_t>(((a >> shift) & 0xFF) + ((b >> shift) & 0xFF), 0xFF) << shift;
+    }
+    return result;
+}
+
+uint32_t SubtractPixels(uint32_t a, uint32_t b) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        const uint32_t x = (a >> shift) & 0xFF;
+        const uint32_t y = (b >> shift) & 0xFF;
+        result |= (x > y ? x - y : 0) << shift;
+    }
+    return result;
+}
+
+uint32_t BloomPixel(uint32_t left, uint32_t center, uint32_t right, uint32_t above, uint32_t below,
+                    uint32_t threshold, uint32_t strength) {
+    const uint32_t glow = AveragePixels(AveragePixels(left, right), AveragePixels(above, below));
+    return AddPixels(center, MultiplyPixel(SubtractPixels(glow, threshold), strength));
+}
+
+void MultiplyScalar(const uint32_t* src, const uint32_t* weights, uint32_t* dst, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] = MultiplyPixel(src[i], weights[i]);
+    }
+}
+
+// The first and last pixels of a row have no left or right neighbor; they use themselves.
+void BloomEdges(const uint32_t* above, const uint32_t* row, const uint32_t* below, uint32_t* dst, size_t count,
+                uint32_t threshold, uint32_t strength) {
+    dst[0] = BloomPixel(row[0], row[0], row[count > 1 ? 1 : 0], above[0], below[0], threshold, strength);
+    if (count > 1) {
+        const size_t last = count - 1;
+        dst[last] = BloomPixel(row[last - 1], row[last], row[last], above[last], below[last], threshold, strength);
+    }
+}
+
+void BloomScalar(const uint32_t* above, const uint32_t* row, const uint32_t* below, uint32_t* dst, size_t count,
+                 uint32_t threshold, uint32_t strength) {
+    for (size_t x = 1; x + 1 < count; ++x) {
+        dst[x] = BloomPixel(row[x - 1], row[x], row[x + 1], above[x], below[x], threshold, strength);
+    }
+    BloomEdges(above, row, below, dst, count, threshold, strength);
+}
+
+#ifdef ULICS_X86_SIMD
+// (a * (w + 1)) >> 8 on 16 bytes: widened to 16 bits, multiplied, narrowed back.
+inline __m128i MultiplyBytesSSE2(__m128i a, __m128i w) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), _mm_add_epi16(_mm_unpacklo_epi8(w, zero), one)), 8);
+    const __m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), _mm_add_epi16(_mm_unpackhi_epi8(w, zero), one)), 8);
+    return _mm_packus_epi16(lo, hi);
+}
+
+void MultiplySSE2(const uint32_t* src, const uint32_t* weights, uint32_t* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), MultiplyBytesSSE2(a, w));
+    }
+    MultiplyScalar(src + i, weights + i, dst + i, count - i);
+}
+
+void BloomSSE2(const uint32_t* above, const uint32_t* row, const uint32_t* below, uint32_t* dst, size_t count,
+               uint32_t threshold, uint32_t strength) {
+    const __m128i thresholds = _mm_set1_epi32(static_cast<int>(threshold));
+    const __m128i strengths = _mm_set1_epi32(static_cast<int>(strength));
+    size_t x = 1;
+    for (; x + 5 <= count; x += 4) {
+        auto load = [](const uint32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); };
+        const __m128i glow = _mm_avg_epu8(_mm_avg_epu8(load(row + x - 1), load(row + x + 1)),
+                                          _mm_avg_epu8(load(above + x), load(below + x)));
+        const __m128i added = MultiplyBytesSSE2(_mm_subs_epu8(glow, thresholds), strengths);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_adds_epu8(load(row + x), added));
+    }
+    for (; x + 1 < count; ++x) {
+        dst[x] = BloomPixel(row[x - 1], row[x], row[x + 1], above[x], below[x], threshold, strength);
+    }
+    BloomEdges(above, row, below, dst, count, threshold, strength);
+}
+
+ULICS_TARGET_AVX2 inline __m256i MultiplyBytesAVX2(__m256i a, __m256i w) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi16(1);
+    const __m256i lo = _mm256_srli_epi16(
+        _mm256_mullo_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_add_epi16(_mm256_unpacklo_epi8(w, zero), one)), 8);
+    const __m256i hi = _mm256_srli_epi16(
+        _mm256_mullo_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_add_epi16(_mm256_unpackhi_epi8(w, zero), one)), 8);
+    return _mm256_packus_epi16(lo, hi); // Unpack and pack both work within 128-bit lanes.
+}
+
+ULICS_TARGET_AVX2 void MultiplyAVX2(const uint32_t* src, const uint32_t* weights, uint32_t* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        const __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), MultiplyBytesAVX2(a, w));
+    }
+    MultiplyScalar(src + i, weights + i, dst + i, count - i);
+}
+
+ULICS_TARGET_AVX2 void BloomAVX2(const uint32_t* above, const uint32_t* row, const uint32_t* below, uint32_t* dst,
+                                 size_t count, uint32_t threshold, uint32_t strength) {
+    const __m256i thresholds = _mm256_set1_epi32(static_cast<int>(threshold));
+    const __m256i strengths = _mm256_set1_epi32(static_cast<int>(strength));
+    size_t x = 1;
+    for (; x + 9 <= count; x += 8) {
+        const __m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x - 1));
+        const __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x + 1));
+        const __m256i up = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + x));
+        const __m256i down = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(below + x));
+        const __m256i center = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x));
+        const __m256i glow = _mm256_avg_epu8(_mm256_avg_epu8(left, right), _mm256_avg_epu8(up, down));
+        const __m256i added = MultiplyBytesAVX2(_mm256_subs_epu8(glow, thresholds), strengths);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_adds_epu8(center, added));
+    }
+    for (; x + 1 < count; ++x) {
+        dst[x] = BloomPixel(row[x - 1], row[x], row[x + 1], above[x], below[x], threshold, strength);
+    }
+    BloomEdges(above, row, below, dst, count, threshold, strength);
+}
+#endif
+
+// Scratch rows of the thread filtering a screen row: the bloomed row and its upscaled copy.
+struct RowScratch {
+    std::vector<uint32_t> bloomed;
+    std::vector<uint32_t> wide;
+};
+
+RowScratch& ThreadScratch() {
+    static thread_local RowScratch scratch;
+    return scratch;
+}
+
+} // namespace
+
+PostProcessor::PostProcessor(const Settings& requested, const RenderBackend& backend)
+    : settings(requested), multiplyKernel(&MultiplyScalar), bloomKernel(&BloomScalar) {
+    settings.scale = std::clamp(settings.scale, 1, MAX_SCALE);
+    settings.threads = std::max(settings.threads, 1);
+#ifdef ULICS_X86_SIMD
+    if (SDL_HasAVX2()) {
+        multiplyKernel = &MultiplyAVX2;
+        bloomKernel = &BloomAVX2;
+    } else if (SDL_HasSSE2()) {
+        multiplyKernel = &MultiplySSE2;
+        bloomKernel = &BloomSSE2;
+    }
+#endif
+
+    auto pack = [&backend](int r, int g, int b, int a) {
+        return backend.MapColor(SDL_Color{static_cast<Uint8>(r), static_cast<Uint8>(g), static_cast<Uint8>(b),
+                                          static_cast<Uint8>(a)});
+    };
+    const int dimmed = 255 - settings.shadowMask;
+    const int scanline = 255 - settings.scanlines;
+    for (int phase = 0; phase < 3; ++phase) {
+        const int r = phase == 0 ? 255 : dimmed;
+        const int g = phase == 1 ? 255 : dimmed;
+        const int b = phase == 2 ? 255 : dimmed;
+        maskWeights[phase] = pack(r, g, b, 255);
+        auto darken = [scanline](int weight) { return (weight * (scanline + 1)) >> 8; };
+        scanlineWeights[phase] = pack(darken(r), darken(g), darken(b), 255);
+    }
+    bloomStrength = pack(settings.bloom, settings.bloom, settings.bloom, 0);
+    bloomThreshold = pack(BLOOM_THRESHOLD, BLOOM_THRESHOLD, BLOOM_THRESHOLD, 255);
+
+    for (int i = 1; i < settings.threads; ++i) {
+        workers.emplace_back(&PostProcessor::WorkerLoop, this);
+    }
+}
+
+PostProcessor::~PostProcessor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    startCondition.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void PostProcessor::Process(const uint32_t* image, int width, int height, int y0, int y1, uint32_t* out, int pitch) {
+    if (y0 >= y1) {
+        return;
+    }
+    const size_t outputWidth = static_cast<size_t>(width) * settings.scale;
+    if (rowWeights.size() != outputWidth) {
+        rowWeights.resize(outputWidth);
+        scanlineRowWeights.resize(outputWidth);
+        for (size_t x = 0; x < outputWidth; ++x) {
+            rowWeights[x] = maskWeights[x % 3];
+            scanlineRowWeights[x] = scanlineWeights[x % 3];
+        }
+    }
+
+    jobImage = image;
+    jobWidth = width;
+    jobHeight = height;
+    jobY0 = y0;
+    jobY1 = y1;
+    jobOut = reinterpret_cast<uint8_t*>(out);
+    jobPitch = pitch;
+    nextBand = 0;
+
+    // Small updates are not worth waking the workers for.
+    if (workers.empty() || y1 - y0 <= BAND_ROWS) {
+        RunBands();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++generation;
+        busyWorkers = static_cast<int>(workers.size());
+    }
+    startCondition.notify_all();
+    RunBands();
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        doneCondition.wait(lock, [this] { return busyWorkers == 0; });
+    }
+}
+
+void PostProcessor::ProcessRow(int y) {
+    const int width = jobWidth;
+    const int scale = settings.scale;
+    RowScratch& scratch = ThreadScratch();
+    const uint32_t* row = jobImage + static_cast<size_t>(y) * width;
+
+    if (settings.bloom != 0) {
+        const uint32_t* above = y > 0 ? row - width : row;
+        const uint32_t* below = y + 1 < jobHeight ? row + width : row;
+        scratch.bloomed.resize(width);
+        bloomKernel(above, row, below, scratch.bloomed.data(), width, bloomThreshold, bloomStrength);
+        row = scratch.bloomed.data();
+    }
+
+    const size_t outputWidth = static_cast<size_t>(width) * scale;
+    if (scale > 1) {
+        scratch.wide.resize(outputWidth);
+        uint32_t* wide = scratch.wide.data();
+        for (int x = 0; x < width; ++x) {
+            std::fill_n(wide + static_cast<size_t>(x) * scale, scale, row[x]);
+        }
+        row = wide;
+    }
+
+    for (int sub = 0; sub < scale; ++sub) {
+        const bool scanline = settings.scanlines != 0 && (scale == 1 ? (y & 1) != 0 : sub == scale - 1);
+        auto* dst = reinterpret_cast<uint32_t*>(jobOut + (static_cast<size_t>(y - jobY0) * scale + sub) * jobPitch);
+        if (scanline) {
+            multiplyKernel(row, scanlineRowWeights.data(), dst, outputWidth);
+        } else if (settings.shadowMask != 0) {
+            multiplyKernel(row, rowWeights.data(), dst, outputWidth);
+        } else {
+            std::memcpy(dst, row, outputWidth * sizeof(uint32_t));
+        }
+    }
+}
+
+void PostProcessor::RunBands() {
+    const int bandCount = (jobY1 - jobY0 + BAND_ROWS - 1) / BAND_ROWS;
+    for (int band = nextBand.fetch_add(1); band < bandCount; band = nextBand.fetch_add(1)) {
+        const int first = jobY0 + band * BAND_ROWS;
+        const int last = std::min(first + BAND_ROWS, jobY1);
+        for (int y = first; y < last; ++y) {
+            ProcessRow(y);
+        }
+    }
+}
+
+void PostProcessor::WorkerLoop() {
+    uint64_t seenGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            startCondition.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping) {
+                return;
+            }
+            seenGeneration = generation;
+        }
+
+        RunBands();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busyWorkers == 0) {
+                doneCondition.notify_one();
+            }
+        }
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef POST_PROCESSOR_H
+#define POST_PROCESSOR_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "rendering/RenderBackend.h"
+
+/// @class PostProcessor
+/// @brief Turns the palette-expanded screen into a larger, CRT-styled output image.
+///
+/// Every screen pixel becomes a scale x scale block of output pixels. Bloom adds the part of
+/// the average of a pixel's four neighbors above BLOOM_THRESHOLD, so bright colors bleed into
+/// their surroundings. The shadow mask dims two of the three color channels in every output
+/// column, cycling red, green and blue. Scanlines darken the last output row of every block
+/// (every other row at scale 1). All filters work on the bytes of the backend's 32-bit pixels
+/// with SIMD kernels, and the rows of a frame are split into bands shared by worker threads.
+class PostProcessor {
+public:
+    struct Settings {
+        int scale = 1;          // Output pixels per screen pixel, on each axis (1 to MAX_SCALE).
+        uint8_t scanlines = 0;  // How far scanline rows are darkened, 0 (off) to 255 (black).
+        uint8_t shadowMask = 0; // How far each mask column dims its two other channels, 0 to 255.
+        uint8_t bloom = 0;      // Strength of the glow from bright neighbors, 0 (off) to 255.
+        int threads = 1;        // Threads sharing the work, including the caller.
+
+        // True if the output would be an unchanged copy of the screen.
+        bool IsIdentity() const { return scale == 1 && scanlines == 0 && shadowMask == 0 && bloom == 0; }
+    };
+
+    static constexpr int MAX_SCALE = 4;
+
+    // Channels at or below this level do not bloom.
+    static constexpr uint8_t BLOOM_THRESHOLD = 128;
+
+    // Screen rows are handed to the threads in bands of this many rows.
+    static constexpr int BAND_ROWS = 8;
+
+    // Filter weights are packed in the backend's pixel format, through its MapColor().
+    PostProcessor(const Settings& settings, const RenderBackend& backend);
+    ~PostProcessor();
+
+    PostProcessor(const PostProcessor&) = delete;
+    PostProcessor& operator=(const PostProcessor&) = delete;
+
+    const Settings& GetSettings() const { return settings; }
+
+    // Output rows of a screen row also depend on the screen rows this far above and below it.
+    int GetRowReach() const { return settings.bloom != 0 ? 1 : 0; }
+
+    // Writes the output rows of screen rows [y0, y1) of `image`, a width x height screen of
+    // backend pixels. `out` points to output row y0 * scale; rows are `pitch` bytes apart.
+    void Process(const uint32_t* image, int width, int height, int y0, int y1, uint32_t* out, int pitch);
+
+private:
+    using MultiplyFunc = void (*)(const uint32_t* src, const uint32_t* weights, uint32_t* dst, size_t count);
+    using BloomFunc = void (*)(const uint32_t* above, const uint32_t* row, const uint32_t* below, uint32_t* dst,
+                               size_t count, uint32_t threshold, uint32_t strength);
+
+    // Filters screen row y into its output rows.
+    void ProcessRow(int y);
+
+    // Processes bands taken from nextBand until none are left.
+    void RunBands();
+
+    // Body of each worker thread.
+    void WorkerLoop();
+
+    Settings settings;
+    MultiplyFunc multiplyKernel;
+    BloomFunc bloomKernel;
+
+    // Per-channel weights, in the backend's format: the shadow mask for output columns with
+    // x % 3 == 0, 1 and 2, without and with the scanline darkening, and the bloom strength and
+    // threshold. Alpha is kept at full weight.
+    uint32_t maskWeights[3];
+    uint32_t scanlineWeights[3];
+    uint32_t bloomStrength;
+    uint32_t bloomThreshold;
+
+    // maskWeights and scanlineWeights repeated along an output row, rebuilt when its width changes.
+    std::vector<uint32_t> rowWeights;
+    std::vector<uint32_t> scanlineRowWeights;
+
+    // The current job. Written by Process() before the workers are woken.
+    const uint32_t* jobImage = nullptr;
+    int jobWidth = 0;
+    int jobHeight = 0;
+    int jobY0 = 0;
+    int jobY1 = 0;
+    uint8_t* jobOut = nullptr;
+    int jobPitch = 0;
+    std::atomic<int> nextBand{0};
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable startCondition;
+    std::condition_variable doneCondition;
+    uint64_t generation = 0; // Guarded by mutex. Incremented for every job.
+    int busyWorkers = 0;     // Guarded by mutex.
+    bool stopping = false;   // Guarded by mutex.
+};
+
+#endif // POST_PROCESSOR_H
@@ -0,0 +1,1359 @@
+#include "rendering/Rasterizer.h"
+#include "rendering/EmbeddedFont.h"
+#include "rendering/SpriteSheet.h"
+#include "cartridge/Tilemap.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+constexpr int64_t FIXED_HALF = Rasterizer::FIXED_ONE / 2;
+
+// floor(sqrt(value)) for value >= 0, exact for every int64_t the rasterizer produces.
+int64_t FloorSqrt(int64_t value) {
+    int64_t root = static_cast<int64_t>(std::sqrt(static_cast<double>(value)));
+    while (root * root > value) --root;
+    while ((root + 1) * (root + 1) <= value) ++root;
+    return root;
+}
+
+// Vertices are clamped to +/-2^30 in fixed point (about 4 million pixels), which keeps every
+// product in the edge setup below within 64 bits.
+constexpr int64_t MAX_FIXED_COORD = int64_t{1} << 30;
+
+int64_t FloorDiv(int64_t a, int64_t b) {
+    const int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+// First pixel row or column whose center is at or after the fixed-point coordinate v.
+int64_t FirstCenterAtOrAfter(int64_t v) {
+    return -FloorDiv(FIXED_HALF - v, Rasterizer::FIXED_ONE);
+}
+
+int64_t CeilDiv(int64_t a, int64_t b) {
+    return -FloorDiv(-a, b);
+}
+
+// Narrows the steps [kLo, kHi) along a row to those where lo <= a + k * d < hi.
+void NarrowSteps(int64_t a, int64_t d, int64_t lo, int64_t hi, int64_t& kLo, int64_t& kHi) {
+    if (d > 0) {
+        kLo = std::max(kLo, CeilDiv(lo - a, d));
+        kHi = std::min(kHi, FloorDiv(hi - 1 - a, d) + 1);
+    } else if (d < 0) {
+        kLo = std::max(kLo, CeilDiv(a - hi + 1, -d));
+        kHi = std::min(kHi, FloorDiv(a - lo, -d) + 1);
+    } else if (a < lo || a >= hi) {
+        kHi = kLo;
+    }
+}
+
+// Walks one polygon edge down the pixel-center rows. At each row, Start() is the first column
+// whose center lies at or right of the edge. The edge's x is kept as the exact fraction
+// q + r / den and stepped with quotient and remainder, so there is no drift and no division
+// per row.
+struct EdgeStepper {
+    int64_t q = 0, r = 0, qStep = 0, rStep = 0, den = 1;
+
+    // Edge from (xa, ya) to (xb, yb) with ya < yb; `row` is the first pixel row to walk.
+    void Init(int64_t xa, int64_t ya, int64_t xb, int64_t yb, int64_t row) {
+        const int64_t dy = yb - ya;
+        const int64_t rowCenter = row * Rasterizer::FIXED_ONE + FIXED_HALF;
+        den = dy * Rasterizer::FIXED_ONE;
+        // (x(rowCenter) - 1/2) in pixels, as a fraction over den.
+        const int64_t num = (xa - FIXED_HALF) * dy + (rowCenter - ya) * (xb - xa);
+        q = FloorDiv(num, den);
+        r = num - q * den;
+        const int64_t step = Rasterizer::FIXED_ONE * (xb - xa);
+        qStep = FloorDiv(step, den);
+        rStep = step - qStep * den;
+    }
+
+    int64_t Start() const { return q + (r > 0 ? 1 : 0); }
+
+    void Step() {
+        q += qStep;
+        r += rStep;
+        if (r >= den) {
+            r -= den;
+            ++q;
+        }
+    }
+};
+
+struct PolyEdge {
+    int64_t xa, ya, xb, yb;
+    int64_t rowStart, rowEnd; // Pixel rows [rowStart, rowEnd) whose centers the edge crosses.
+    EdgeStepper stepper;
+};
+
+// Packed rows hold pixel x in the low nibble of byte x / 2 when x is even, the high one otherwise.
+
+// Reads pixels [x0, x1) of a packed row into out[0, x1 - x0).
+void UnpackSpan(const uint8_t* row, int64_t x0, int64_t x1, uint8_t* out) {
+    for (int64_t x = x0; x < x1; ++x) {
+        *out++ = static_cast<uint8_t>((row[x >> 1] >> ((x & 1) * 4)) & 0x0F);
+    }
+}
+
+// Writes in[0, x1 - x0) to pixels [x0, x1) of a packed row, keeping the pixels beside the span.
+void PackSpan(const uint8_t* in, int64_t x0, int64_t x1, uint8_t* row) {
+    int64_t x = x0;
+    if ((x & 1) && x < x1) {
+        row[x >> 1] = static_cast<uint8_t>((row[x >> 1] & 0x0F) | (*in++ << 4));
+        ++x;
+    }
+    for (; x + 1 < x1; x += 2, in += 2) {
+        row[x >> 1] = static_cast<uint8_t>((in[0] & 0x0F) | (in[1] << 4));
+    }
+    if (x < x1) {
+        row[x >> 1] = static_cast<uint8_t>((row[x >> 1] & 0xF0) | (*in & 0x0F));
+    }
+}
+
+// Fills pixels [x0, x1) of a packed row: the odd edges by nibble, the whole bytes between at once.
+void FillPackedSpan(uint8_t* row, int x0, int x1, uint8_t color) {
+    color &= 0x0F;
+    if (x0 & 1) {
+        row[x0 >> 1] = static_cast<uint8_t>((row[x0 >> 1] & 0x0F) | (color << 4));
+        ++x0;
+    }
+    if (x1 & 1 && x0 < x1) {
+        row[x1 >> 1] = static_cast<uint8_t>((row[x1 >> 1] & 0xF0) | color);
+        --x1;
+    }
+    if (x0 < x1) {
+        std::memset(row + (x0 >> 1), color * 0x11, static_cast<size_t>(x1 - x0) >> 1);
+    }
+}
+
+// Flood fill seeds: a pixel from which a span is grown. The stack keeps its capacity between
+// fills, so a fill only allocates when it needs more seeds than any earlier one.
+struct FloodSeed {
+    int x, y;
+};
+
+std::vector<FloodSeed>& FloodStack() {
+    static thread_local std::vector<FloodSeed> stack = [] {
+        std::vector<FloodSeed> seeds;
+        seeds.reserve(4096);
+        return seeds;
+    }();
+    return stack;
+}
+
+// Unpacked copy of the row a packed-buffer kernel is working on; see Rasterizer::BeginRow.
+std::vector<uint8_t>& RowScratch() {
+    static thread_local std::vector<uint8_t> row;
+    return row;
+}
+
+// Pixels an effect moves out of a row while the rest of the row is shifted over them.
+std::vector<uint8_t>& CarryScratch() {
+    static thread_local std::vector<uint8_t> carry;
+    return carry;
+}
+
+} // namespace
+
+Rasterizer::Rasterizer(uint8_t* pixels, int width, int height)
+    : pixels(pixels), width(width), height(height), stride(width), bandY1(height), clipX1(width), clipY1(height) {
+    UpdateTransparency();
+}
+
+void Rasterizer::SetTarget(uint8_t* targetPixels, int targetWidth, int targetHeight, bool packedTarget) {
+    pixels = targetPixels;
+    width = targetWidth;
+    height = targetHeight;
+    packed = packedTarget;
+    stride = packed ? (width + 1) / 2 : width;
+    bandY0 = 0;
+    bandY1 = targetHeight;
+    UpdateClip();
+    ResetDamage();
+}
+
+void Rasterizer::SetClip(int x0, int y0, int x1, int y1) {
+    state.clipX0 = x0;
+    state.clipY0 = y0;
+    state.clipX1 = x1;
+    state.clipY1 = y1;
+    UpdateClip();
+}
+
+void Rasterizer::SetClipRect(int x, int y, int w, int h) {
+    const int64_t right = static_cast<int64_t>(x) + std::max(w, 0);
+    const int64_t bottom = static_cast<int64_t>(y) + std::max(h, 0);
+    SetClip(x, y, static_cast<int>(std::min<int64_t>(right, UNCLIPPED)), static_cast<int>(std::min<int64_t>(bottom, UNCLIPPED)));
+}
+
+void Rasterizer::SetBand(int y0, int y1) {
+    bandY0 = y0;
+    bandY1 = y1;
+    UpdateClip();
+}
+
+void Rasterizer::UpdateClip() {
+    clipX0 = std::clamp(state.clipX0, 0, width);
+    clipY0 = std::clamp(std::max(state.clipY0, bandY0), 0, height);
+    clipX1 = std::clamp(state.clipX1, clipX0, width);
+    clipY1 = std::clamp(std::min(state.clipY1, bandY1), clipY0, height);
+}
+
+void Rasterizer::SetTransparentColor(std::optional<uint8_t> colorIndex) {
+    state.transparency = TransparencyMask::FromColor(colorIndex);
+    UpdateTransparency();
+}
+
+void Rasterizer::SetTransparent(uint8_t colorIndex, bool transparent) {
+    state.transparency.Set(colorIndex, transparent);
+    UpdateTransparency();
+}
+
+void Rasterizer::UpdateTransparency() {
+    for (int i = 0; i < 256; ++i) {
+        opaqueBytes[i] = state.transparency.Test(static_cast<uint8_t>(i)) ? 0x00 : 0xFF;
+    }
+}
+
+void Rasterizer::SetDrawPaletteEntry(uint8_t from, uint8_t to) {
+    state.drawPalette[from] = to;
+    identityDrawPalette = state.drawPalette == IdentityPalette();
+}
+
+void Rasterizer::ResetDrawPalette() {
+    state.drawPalette = IdentityPalette();
+    identityDrawPalette = true;
+}
+
+void Rasterizer::SetFillPattern(uint16_t pattern, std::optional<uint8_t> altColor) {
+    state.fillPattern = pattern;
+    state.fillAltColor = altColor;
+    UpdateFillPattern();
+}
+
+void Rasterizer::UpdateFillPattern() {
+    auto bit = [this](int row, int column) { return (state.fillPattern >> (15 - row * 4 - (column & 3))) & 1; };
+    for (int row = 0; row < 4; ++row) {
+        for (int phase = 0; phase < 4; ++phase) {
+            // Built byte by byte in memory order, so the words work on either endianness.
+            uint8_t unpackedBytes[8];
+            uint8_t packedBytes[8];
+            for (int i = 0; i < 8; ++i) {
+                unpackedBytes[i] = bit(row, phase + i) ? 0xFF : 0x00;
+                packedBytes[i] = static_cast<uint8_t>((bit(row, phase + 2 * i) ? 0x0F : 0x00) |
+                                                      (bit(row, phase + 2 * i + 1) ? 0xF0 : 0x00));
+            }
+            std::memcpy(&patternMasks[0][row][phase], unpackedBytes, 8);
+            std::memcpy(&patternMasks[1][row][phase], packedBytes, 8);
+        }
+    }
+}
+
+void Rasterizer::SetDrawState(const DrawState& newState) {
+    state = newState;
+    identityDrawPalette = state.drawPalette == IdentityPalette();
+    UpdateTransparency();
+    UpdateFillPattern();
+    UpdateClip();
+}
+
+void Rasterizer::CopyRemapped(uint8_t* dst, const uint8_t* src, int count) const {
+    if (identityDrawPalette) {
+        std::memcpy(dst, src, count);
+        return;
+    }
+    const uint8_t* remap = state.drawPalette.data();
+    for (int i = 0; i < count; ++i) {
+        dst[i] = remap[src[i]];
+    }
+}
+
+void Rasterizer::Clear(uint8_t colorIndex) {
+    // Clear ignores transparency, so only the palette wrap is applied before the bulk fill.
+    const uint8_t color = static_cast<uint8_t>(colorIndex % paletteSize);
+    if (clipX0 == 0 && clipX1 == width && (!packed || width % 2 == 0)) {
+        const uint8_t fill = packed ? static_cast<uint8_t>((color & 0x0F) * 0x11) : color;
+        std::memset(&pixels[clipY0 * stride], fill, static_cast<size_t>(clipY1 - clipY0) * stride);
+        if (clipY0 < clipY1) MarkDirtyRows(clipY0, clipY1 - 1);
+        return;
+    }
+    for (int row = clipY0; row < clipY1 && clipX0 < clipX1; ++row) {
+        FillSolidSpan(row, clipX0, clipX1, color);
+    }
+}
+
+bool Rasterizer::ResolveColor(uint8_t colorIndex, uint8_t& resolved) const {
+    // Transparency is tested on the color as drawn, before the draw palette remaps it.
+    if (state.transparency.Test(colorIndex)) {
+        return false;
+    }
+    resolved = static_cast<uint8_t>(state.drawPalette[colorIndex] % paletteSize);
+    return true;
+}
+
+void Rasterizer::FillSolidSpan(int y, int x0, int x1, uint8_t resolvedColor) {
+    if (packed) {
+        FillPackedSpan(&pixels[y * stride], x0, x1, resolvedColor);
+    } else {
+        std::memset(&pixels[y * stride + x0], resolvedColor, x1 - x0);
+    }
+    MarkDirtyRows(y, y);
+}
+
+void Rasterizer::FillPatternSpan(int y, int x0, int x1, uint8_t resolvedColor) {
+    if (packed) {
+        // Odd edge pixels share a byte with pixels outside the span.
+        if (x0 & 1) Plot(x0++, y, resolvedColor);
+        if ((x1 & 1) && x0 < x1) Plot(--x1, y, resolvedColor);
+    }
+
+    // Every byte of the span gets `fill`, except where `mask` is set: there it gets the pattern's
+    // second color, or keeps its old value if the pattern is transparent.
+    const uint64_t mask = patternMasks[packed][y & 3][x0 & 3];
+    const uint64_t splat = packed ? 0x1111111111111111ULL : 0x0101010101010101ULL;
+    const uint64_t color = (packed ? (resolvedColor & 0x0F) : resolvedColor) * splat;
+    const bool transparent = !state.fillAltColor;
+    uint64_t fill = color & ~mask;
+    if (!transparent) {
+        const uint8_t alt = static_cast<uint8_t>(state.drawPalette[*state.fillAltColor] % paletteSize);
+        fill |= ((packed ? (alt & 0x0F) : alt) * splat) & mask;
+    }
+
+    uint8_t* dst = packed ? &pixels[y * stride + (x0 >> 1)] : &pixels[y * stride + x0];
+    size_t bytes = packed ? static_cast<size_t>(x1 - x0) >> 1 : static_cast<size_t>(x1 - x0);
+    auto store = [&](size_t count) {
+        uint64_t word = fill;
+        if (transparent) {
+            uint64_t old = 0;
+            std::memcpy(&old, dst, count);
+            word = (old & mask) | fill;
+        }
+        std::memcpy(dst, &word, count);
+    };
+    // Eight bytes cover a whole number of pattern periods in either layout, so the same word
+    // repeats along the row.
+    for (; bytes >= 8; bytes -= 8, dst += 8) {
+        store(8);
+    }
+    if (bytes > 0) {
+        store(bytes);
+    }
+    MarkDirtyRows(y, y);
+}
+
+uint8_t* Rasterizer::BeginRow(int y, int x0, int x1) {
+    if (!packed) {
+        return &pixels[y * stride];
+    }
+    std::vector<uint8_t>& row = RowScratch();
+    if (row.size() < static_cast<size_t>(width)) {
+        row.resize(width);
+    }
+    UnpackSpan(&pixels[y * stride], x0, x1, row.data() + x0);
+    return row.data();
+}
+
+void Rasterizer::EndRow(int y, int x0, int x1) {
+    if (packed) {
+        PackSpan(RowScratch().data() + x0, x0, x1, &pixels[y * stride]);
+    }
+}
+
+void Rasterizer::SetPixel(int x, int y, uint8_t colorIndex) {
+    uint8_t color;
+    if (!ResolveColor(colorIndex, color)) return;
+
+    int screenX = x - state.cameraX;
+    int screenY = y - state.cameraY;
+
+    if (screenX >= clipX0 && screenX < clipX1 && screenY >= clipY0 && screenY < clipY1) {
+        Plot(screenX, screenY, color);
+        MarkDirtyRows(screenY, screenY);
+    }
+}
+
+void Rasterizer::HLine(int64_t y, int64_t x0, int64_t x1, uint8_t resolvedColor) {
+    if (y < clipY0 || y >= clipY1) return;
+    x0 = std::max<int64_t>(x0, clipX0);
+    x1 = std::min<int64_t>(x1, clipX1 - 1);
+    if (x0 <= x1) {
+        FillSpan(static_cast<int>(y), static_cast<int>(x0), static_cast<int>(x1) + 1, resolvedColor);
+    }
+}
+
+void Rasterizer::VLine(int64_t x, int64_t y0, int64_t y1, uint8_t resolvedColor) {
+    if (x < clipX0 || x >= clipX1) return;
+    y0 = std::max<int64_t>(y0, clipY0);
+    y1 = std::min<int64_t>(y1, clipY1 - 1);
+    if (y0 > y1) return;
+    if (packed || state.fillPattern != 0) {
+        for (int64_t row = y0; row <= y1; ++row) {
+            Plot(x, row, resolvedColor);
+        }
+    } else {
+        uint8_t* dst = &pixels[y0 * stride + x];
+        for (int64_t row = y0; row <= y1; ++row, dst += stride) {
+            *dst = resolvedColor;
+        }
+    }
+    MarkDirtyRows(static_cast<int>(y0), static_cast<int>(y1));
+}
+
+void Rasterizer::Line(int x1, int y1, int x2, int y2, uint8_t colorIndex) {
+    uint8_t color;
+    if (!ResolveColor(colorIndex, color)) return;
+
+    // Screen-space endpoints, wide enough that far-off coordinates cannot overflow.
+    const int64_t ax = static_cast<int64_t>(x1) - state.cameraX;
+    const int64_t ay = static_cast<int64_t>(y1) - state.cameraY;
+    const int64_t bx = static_cast<int64_t>(x2) - state.cameraX;
+    const int64_t by = static_cast<int64_t>(y2) - state.cameraY;
+
+    if (ay == by) {
+        HLine(ay, std::min(ax, bx), std::max(ax, bx), color);
+        return;
+    }
+    if (ax == bx) {
+        VLine(ax, std::min(ay, by), std::max(ay, by), color);
+        return;
+    }
+
+    // Bresenham steps the major axis once per pixel, and the pixel at major step u sits at minor
+    // step v(u) = floor((2*u*minorLen + majorLen) / (2*majorLen)). That closed form lets the line
+    // be clipped exactly against the clip rectangle before rasterizing: only the steps whose
+    // pixels are inside are visited, and they are the same pixels the unclipped walk would draw.
+    const bool xMajor = std::abs(bx - ax) >= std::abs(by - ay);
+    const int64_t majorStart = xMajor ? ax : ay;
+    const int64_t minorStart = xMajor ? ay : ax;
+    const int64_t majorEnd = xMajor ? bx : by;
+    const int64_t minorEnd = xMajor ? by : bx;
+    const int64_t majorLen = std::abs(majorEnd - majorStart);
+    const int64_t minorLen = std::abs(minorEnd - minorStart);
+    const int majorStep = majorEnd > majorStart ? 1 : -1;
+    const int minorStep = minorEnd > minorStart ? 1 : -1;
+    const int64_t majorLo = xMajor ? clipX0 : clipY0;
+    const int64_t majorHi = (xMajor ? clipX1 : clipY1) - 1;
+    const int64_t minorLo = xMajor ? clipY0 : clipX0;
+    const int64_t minorHi = (xMajor ? clipY1 : clipX1) - 1;
+    if (majorLo > majorHi || minorLo > minorHi) return;
+
+    // Steps along each axis that stay inside the clip rectangle.
+    int64_t uMin = majorStep > 0 ? majorLo - majorStart : majorStart - majorHi;
+    int64_t uMax = majorStep > 0 ? majorHi - majorStart : majorStart - majorLo;
+    const int64_t vMin = std::max<int64_t>(minorStep > 0 ? minorLo - minorStart : minorStart - minorHi, 0);
+    const int64_t vMax = std::min(minorStep > 0 ? minorHi - minorStart : minorStart - minorLo, minorLen);
+    if (vMin > vMax) return;
+
+    // Invert v(u) to turn the minor range into a major one.
+    const int64_t twoMajor = 2 * majorLen;
+    const int64_t twoMinor = 2 * minorLen;
+    if (vMin > 0) {
+        uMin = std::max(uMin, (twoMajor * vMin - majorLen + twoMinor - 1) / twoMinor);
+    }
+    uMax = std::min(uMax, (twoMajor * (vMax + 1) - majorLen - 1) / twoMinor);
+    uMin = std::max<int64_t>(uMin, 0);
+    uMax = std::min(uMax, majorLen);
+    if (uMin > uMax) return;
+
+    // Walk [uMin, uMax] with the remainder of the closed form as the error term.
+    const int64_t numerator = uMin * twoMinor + majorLen;
+    int64_t v = numerator / twoMajor;
+    int64_t remainder = numerator % twoMajor;
+    const int64_t startMajor = majorStart + majorStep * uMin;
+    const int64_t startMinor = minorStart + minorStep * v;
+    if (packed || state.fillPattern != 0) {
+        // Packed pixels are not byte-addressable and the pattern depends on the position, so
+        // the walk keeps coordinates instead.
+        int64_t major = startMajor;
+        int64_t minor = startMinor;
+        for (int64_t u = uMin; u <= uMax; ++u) {
+            Plot(xMajor ? major : minor, xMajor ? minor : major, color);
+            major += majorStep;
+            remainder += twoMinor;
+            if (remainder >= twoMajor) {
+                remainder -= twoMajor;
+                minor += minorStep;
+                ++v;
+            }
+        }
+    } else {
+        const int64_t majorStride = xMajor ? majorStep : static_cast<int64_t>(majorStep) * stride;
+        const int64_t minorStride = xMajor ? static_cast<int64_t>(minorStep) * stride : minorStep;
+        uint8_t* dst = xMajor ? &pixels[startMinor * stride + startMajor] : &pixels[startMajor * stride + startMinor];
+        for (int64_t u = uMin; u <= uMax; ++u) {
+            *dst = color;
+            dst += majorStride;
+            remainder += twoMinor;
+            if (remainder >= twoMajor) {
+                remainder -= twoMajor;
+                dst += minorStride;
+                ++v;
+            }
+        }
+    }
+
+    // Rows touched: v ends one past the last pixel's minor step if the walk just advanced it.
+    const int64_t lastV = (remainder < twoMinor) ? v - 1 : v;
+    const int64_t endMinor = minorStart + minorStep * lastV;
+    const int64_t endMajor = majorStart + majorStep * uMax;
+    const int64_t rowA = xMajor ? startMinor : startMajor;
+    const int64_t rowB = xMajor ? endMinor : endMajor;
+    MarkDirtyRows(static_cast<int>(std::min(rowA, rowB)), static_cast<int>(std::max(rowA, rowB)));
+}
+
+void Rasterizer::Rect(int x, int y, int w, int h, uint8_t colorIndex) {
+    uint8_t color;
+    if (w <= 0 || h <= 0 || !ResolveColor(colorIndex, color)) return;
+    const int64_t x0 = static_cast<int64_t>(x) - state.cameraX;
+    const int64_t y0 = static_cast<int64_t>(y) - state.cameraY;
+    const int64_t x1 = x0 + w - 1;
+    const int64_t y1 = y0 + h - 1;
+
+    // Two clipped spans for the top and bottom edges, two clipped columns for the sides.
+    HLine(y0, x0, x1, color);
+    if (y1 != y0) HLine(y1, x0, x1, color);
+    VLine(x0, y0 + 1, y1 - 1, color);
+    if (x1 != x0) VLine(x1, y0 + 1, y1 - 1, color);
+}
+
+void Rasterizer::RectFill(int x, int y, int w, int h, uint8_t colorIndex) {
+    uint8_t color;
+    if (w <= 0 || h <= 0 || !ResolveColor(colorIndex, color)) return;
+
+    // Clip the rectangle against the clip rectangle once, in screen space.
+    int x0 = std::max(x - state.cameraX, clipX0);
+    int y0 = std::max(y - state.cameraY, clipY0);
+    int x1 = std::min(x - state.cameraX + w, clipX1);
+    int y1 = std::min(y - state.cameraY + h, clipY1);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    for (int row = y0; row < y1; ++row) {
+        FillSpan(row, x0, x1, color);
+    }
+}
+
+void Rasterizer::Circ(int centerX, int centerY, int radius, uint8_t colorIndex) {
+    uint8_t color;
+    if (radius < 0 || !ResolveColor(colorIndex, color)) return;
+
+    const int64_t cx = static_cast<int64_t>(centerX) - state.cameraX;
+    const int64_t cy = static_cast<int64_t>(centerY) - state.cameraY;
+    if (cx + radius < clipX0 || cx - radius >= clipX1 || cy + radius < clipY0 || cy - radius >= clipY1) return;
+
+    // The midpoint walk goes from (r, 0) to about (r/sqrt(2), r/sqrt(2)) and mirrors each step
+    // into eight octants. It advances y by one per step, and its x at step y has the closed form
+    // x(y) = floor(sqrt(r^2 - y^2 - 2y)), the largest x with x^2 + y^2 + 2y <= r^2. Each octant
+    // draws one of (x(y), y) and (y, x(y)), mirrored: y must keep its pixel coordinate inside
+    // the clip rectangle, and since x(y) only decreases, so must a range of y for the other
+    // coordinate. Each octant walks just that range, so huge circles cost no more than the
+    // part of them that is visible, and every pixel is drawn as the unclipped walk would.
+    struct Octant { int sx, sy; bool xFar; };
+    static constexpr Octant octants[8] = {
+        {1, 1, true}, {1, 1, false}, {-1, 1, false}, {-1, 1, true},
+        {-1, -1, true}, {-1, -1, false}, {1, -1, false}, {1, -1, true},
+    };
+    const int64_t radiusSq = static_cast<int64_t>(radius) * radius;
+    for (const Octant& o : octants) {
+        // Offsets from the center along each axis whose pixels are inside the clip rectangle.
+        const int64_t xLo = o.sx > 0 ? clipX0 - cx : cx - (clipX1 - 1);
+        const int64_t xHi = o.sx > 0 ? clipX1 - 1 - cx : cx - clipX0;
+        const int64_t yLo = o.sy > 0 ? clipY0 - cy : cy - (clipY1 - 1);
+        const int64_t yHi = o.sy > 0 ? clipY1 - 1 - cy : cy - clipY0;
+        // The walk index runs along one axis, x(y) along the other.
+        const int64_t stepLo = o.xFar ? yLo : xLo, stepHi = o.xFar ? yHi : xHi;
+        const int64_t farLo = o.xFar ? xLo : yLo, farHi = o.xFar ? xHi : yHi;
+        if (farHi < 0 || farLo > radius) continue;
+
+        int64_t yMin = std::max<int64_t>(stepLo, 0);
+        int64_t yMax = stepHi;
+        if (farHi < radius) {
+            // x(y) <= farHi  <=>  (y + 1)^2 > r^2 - (farHi + 1)^2 + 1
+            yMin = std::max(yMin, FloorSqrt(radiusSq - (farHi + 1) * (farHi + 1) + 1));
+        }
+        if (farLo > 0) {
+            // x(y) >= farLo  <=>  (y + 1)^2 <= r^2 - farLo^2 + 1
+            yMax = std::min(yMax, FloorSqrt(radiusSq - farLo * farLo + 1) - 1);
+        }
+        const int64_t start = radiusSq - yMin * yMin - 2 * yMin;
+        if (yMin > yMax || start < 0) continue;
+
+        int64_t x = FloorSqrt(start);
+        int64_t err = x * x + yMin * yMin + 2 * yMin - radiusSq;
+        for (int64_t y = yMin; y <= yMax && x >= y;) {
+            const int64_t dx = o.xFar ? x : y;
+            const int64_t dy = o.xFar ? y : x;
+            Plot(cx + o.sx * dx, cy + o.sy * dy, color);
+
+            y += 1;
+            err += 2 * y + 1;
+            if (err > 0) {
+                x -= 1;
+                err -= 2 * x + 1;
+            }
+        }
+    }
+    MarkDirtyRows(static_cast<int>(std::max<int64_t>(cy - radius, clipY0)),
+                  static_cast<int>(std::min<int64_t>(cy + radius, clipY1 - 1)));
+}
+
+void Rasterizer::CircFill(int centerX, int centerY, int radius, uint8_t colorIndex) {
+    uint8_t color;
+    if (radius < 0 || !ResolveColor(colorIndex, color)) return;
+
+    int cx = centerX - state.cameraX;
+    int cy = centerY - state.cameraY;
+
+    // Only the rows that intersect the clip rectangle are visited.
+    int y0 = std::max(cy - radius, clipY0);
+    int y1 = std::min(cy + radius, clipY1 - 1);
+    if (y0 > y1 || cx + radius < clipX0 || cx - radius >= clipX1) return;
+
+    const int64_t radiusSq = static_cast<int64_t>(radius) * radius;
+    for (int row = y0; row <= y1; ++row) {
+        // Half-width of the span: the largest dx with dx^2 + dy^2 <= r^2.
+        int64_t dy = row - cy;
+        int64_t remaining = radiusSq - dy * dy;
+        const int64_t half = FloorSqrt(remaining);
+
+        int x0 = static_cast<int>(std::max<int64_t>(cx - half, clipX0));
+        int x1 = static_cast<int>(std::min<int64_t>(cx + half + 1, clipX1));
+        if (x0 < x1) {
+            FillSpan(row, x0, x1, color);
+        }
+    }
+}
+
+void Rasterizer::Blit(int sourceId, int sx, int sy, int w, int h, int dx, int dy, bool masked) {
+    if (!surfaces || sourceId < 0 || sourceId >= static_cast<int>(surfaces->size()) || !(*surfaces)[sourceId]) return;
+    const Surface& source = *(*surfaces)[sourceId];
+
+    // Cut the rectangle to the source, then to the clip rectangle, moving both corners together.
+    int64_t srcX = sx, srcY = sy, dstX = static_cast<int64_t>(dx) - state.cameraX, dstY = static_cast<int64_t>(dy) - state.cameraY;
+    int64_t cols = w, rows = h;
+    auto cut = [](int64_t& src, int64_t& dst, int64_t& size, int64_t srcLimit, int64_t dstLo, int64_t dstHi) {
+        const int64_t skip = std::max({int64_t{0}, -src, dstLo - dst});
+        src += skip;
+        dst += skip;
+        size = std::min({size - skip, srcLimit - src, dstHi - dst});
+    };
+    cut(srcX, dstX, cols, source.width, clipX0, clipX1);
+    cut(srcY, dstY, rows, source.height, clipY0, clipY1);
+    if (cols <= 0 || rows <= 0) return;
+
+    // Copying a surface onto itself: rows are visited away from the overlap, and each source
+    // row is staged in a scratch row unless a plain memmove will do. Packed sources are always
+    // staged, unpacked.
+    const bool sameBuffer = source.pixels == pixels;
+    const bool applyMask = masked && state.transparency.Any();
+    const bool plainCopy = !applyMask && identityDrawPalette;
+    static thread_local std::vector<uint8_t> scratch;
+    if ((sameBuffer && !plainCopy) || source.packed) {
+        scratch.resize(static_cast<size_t>(cols));
+    }
+    const int sourceStride = source.Stride();
+    const bool bottomUp = sameBuffer && dstY > srcY;
+    for (int64_t i = 0; i < rows; ++i) {
+        const int64_t row = bottomUp ? rows - 1 - i : i;
+        const uint8_t* src;
+        if (source.packed) {
+            UnpackSpan(source.pixels + (srcY + row) * sourceStride, srcX, srcX + cols, scratch.data());
+            src = scratch.data();
+        } else {
+            src = source.pixels + (srcY + row) * sourceStride + srcX;
+            if (sameBuffer && !plainCopy) {
+                std::memcpy(scratch.data(), src, static_cast<size_t>(cols));
+                src = scratch.data();
+            }
+        }
+        const int y = static_cast<int>(dstY + row);
+        const int x0 = static_cast<int>(dstX);
+        const int x1 = static_cast<int>(dstX + cols);
+        uint8_t* dst = BeginRow(y, x0, x1) + x0;
+        if (plainCopy) {
+            std::memmove(dst, src, static_cast<size_t>(cols));
+        } else if (!applyMask) {
+            CopyRemapped(dst, src, static_cast<int>(cols));
+        } else {
+            const uint8_t* remap = state.drawPalette.data();
+            for (int64_t x = 0; x < cols; ++x) {
+                const uint8_t color = src[x];
+                const uint8_t keep = opaqueBytes[color];
+                dst[x] = static_cast<uint8_t>((remap[color] & keep) | (dst[x] & ~keep));
+            }
+        }
+        EndRow(y, x0, x1);
+    }
+    MarkDirtyRows(static_cast<int>(dstY), static_cast<int>(dstY + rows - 1));
+}
+
+int32_t Rasterizer::ToFixed(double value) {
+    const double fixed = std::round(value * FIXED_ONE);
+    if (!(fixed > -static_cast<double>(MAX_FIXED_COORD))) return static_cast<int32_t>(-MAX_FIXED_COORD);
+    if (fixed > static_cast<double>(MAX_FIXED_COORD)) return static_cast<int32_t>(MAX_FIXED_COORD);
+    return static_cast<int32_t>(fixed);
+}
+
+int32_t Rasterizer::ToAffine(double value) {
+    const double fixed = std::round(value * AFFINE_ONE);
+    if (!(fixed > static_cast<double>(INT32_MIN))) return INT32_MIN;
+    if (fixed > static_cast<double>(INT32_MAX)) return INT32_MAX;
+    return static_cast<int32_t>(fixed);
+}
+
+void Rasterizer::TriFill(int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint8_t colorIndex) {
+    uint8_t color;
+    if (!ResolveColor(colorIndex, color)) return;
+
+    // Screen-space fixed-point vertices, sorted top to bottom.
+    struct Vertex { int64_t x, y; };
+    auto toScreen = [this](int32_t x, int32_t y) {
+        return Vertex{std::clamp<int64_t>(x - static_cast<int64_t>(state.cameraX) * FIXED_ONE, -MAX_FIXED_COORD, MAX_FIXED_COORD),
+                      std::clamp<int64_t>(y - static_cast<int64_t>(state.cameraY) * FIXED_ONE, -MAX_FIXED_COORD, MAX_FIXED_COORD)};
+    };
+    Vertex a = toScreen(x0, y0), b = toScreen(x1, y1), c = toScreen(x2, y2);
+    if (b.y < a.y) std::swap(a, b);
+    if (c.y < a.y) std::swap(a, c);
+    if (c.y < b.y) std::swap(b, c);
+
+    // Rows whose centers lie in [a.y, c.y), cut to the clip rectangle. The long edge a-c bounds
+    // every row; a-b bounds the rows above b's and b-c the rows from there down.
+    const int64_t rowTop = std::max<int64_t>(FirstCenterAtOrAfter(a.y), clipY0);
+    const int64_t rowBottom = std::min<int64_t>(FirstCenterAtOrAfter(c.y), clipY1);
+    if (rowTop >= rowBottom) return;
+    const int64_t rowMid = std::clamp<int64_t>(FirstCenterAtOrAfter(b.y), rowTop, rowBottom);
+
+    EdgeStepper longEdge;
+    EdgeStepper shortEdge;
+    longEdge.Init(a.x, a.y, c.x, c.y, rowTop);
+    auto fillRows = [&](int64_t row, int64_t end) {
+        for (; row < end; ++row) {
+            const int64_t s0 = longEdge.Start();
+            const int64_t s1 = shortEdge.Start();
+            const int64_t left = std::max<int64_t>(std::min(s0, s1), clipX0);
+            const int64_t right = std::min<int64_t>(std::max(s0, s1), clipX1);
+            if (left < right) {
+                FillSpan(static_cast<int>(row), static_cast<int>(left), static_cast<int>(right), color);
+            }
+            longEdge.Step();
+            shortEdge.Step();
+        }
+    };
+    if (rowTop < rowMid) {
+        shortEdge.Init(a.x, a.y, b.x, b.y, rowTop);
+        fillRows(rowTop, rowMid);
+    }
+    if (rowMid < rowBottom) {
+        shortEdge.Init(b.x, b.y, c.x, c.y, rowMid);
+        fillRows(rowMid, rowBottom);
+    }
+}
+
+void Rasterizer::PolyFill(const int32_t* coords, int vertexCount, uint8_t colorIndex) {
+    uint8_t color;
+    if (vertexCount < 3 || !ResolveColor(colorIndex, color)) return;
+
+    // Scratch buffers are per thread, so tile workers can fill polygons concurrently and
+    // steady-state frames do not allocate.
+    static thread_local std::vector<PolyEdge> edges;
+    static thread_local std::vector<PolyEdge*> active;
+    static thread_local std::vector<int64_t> crossings;
+    edges.clear();
+    active.clear();
+
+    // Build the non-horizontal edges, oriented downwards, in screen space.
+    const int64_t offsetX = static_cast<int64_t>(state.cameraX) * FIXED_ONE;
+    const int64_t offsetY = static_cast<int64_t>(state.cameraY) * FIXED_ONE;
+    int64_t rowTop = INT64_MAX;
+    int64_t rowBottom = INT64_MIN;
+    for (int i = 0; i < vertexCount; ++i) {
+        const int j = (i + 1) % vertexCount;
+        int64_t xa = std::clamp<int64_t>(coords[2 * i] - offsetX, -MAX_FIXED_COORD, MAX_FIXED_COORD);
+        int64_t ya = std::clamp<int64_t>(coords[2 * i + 1] - offsetY, -MAX_FIXED_COORD, MAX_FIXED_COORD);
+        int64_t xb = std::clamp<int64_t>(coords[2 * j] - offsetX, -MAX_FIXED_COORD, MAX_FIXED_COORD);
+        int64_t yb = std::clamp<int64_t>(coords[2 * j + 1] - offsetY, -MAX_FIXED_COORD, MAX_FIXED_COORD);
+        if (ya == yb) continue;
+        if (yb < ya) {
+            std::swap(xa, xb);
+            std::swap(ya, yb);
+        }
+        PolyEdge edge{xa, ya, xb, yb, FirstCenterAtOrAfter(ya), FirstCenterAtOrAfter(yb), {}};
+        if (edge.rowStart >= edge.rowEnd) continue; // Crosses no pixel center.
+        rowTop = std::min(rowTop, edge.rowStart);
+        rowBottom = std::max(rowBottom, edge.rowEnd);
+        edges.push_back(edge);
+    }
+    rowTop = std::max<int64_t>(rowTop, clipY0);
+    rowBottom = std::min<int64_t>(rowBottom, clipY1);
+    if (rowTop >= rowBottom) return;
+
+    // Scanline walk with an active edge list; edges join the list at their first row.
+    std::sort(edges.begin(), edges.end(), [](const PolyEdge& l, const PolyEdge& r) { return l.rowStart < r.rowStart; });
+    size_t nextEdge = 0;
+    for (int64_t row = rowTop; row < rowBottom; ++row) {
+        while (nextEdge < edges.size() && edges[nextEdge].rowStart <= row) {
+            PolyEdge& edge = edges[nextEdge++];
+            if (edge.rowEnd > row) {
+                edge.stepper.Init(edge.xa, edge.ya, edge.xb, edge.yb, row);
+                active.push_back(&edge);
+            }
+        }
+        active.erase(std::remove_if(active.begin(), active.end(), [row](const PolyEdge* e) { return e->rowEnd <= row; }),
+                     active.end());
+
+        crossings.clear();
+        for (PolyEdge* edge : active) {
+            crossings.push_back(edge->stepper.Start());
+            edge->stepper.Step();
+        }
+        std::sort(crossings.begin(), crossings.end());
+
+        // Even-odd: fill between each pair of crossings.
+        for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+            const int64_t left = std::max<int64_t>(crossings[i], clipX0);
+            const int64_t right = std::min<int64_t>(crossings[i + 1], clipX1);
+            if (left < right) {
+                FillSpan(static_cast<int>(row), static_cast<int>(left), static_cast<int>(right), color);
+            }
+        }
+    }
+}
+
+void Rasterizer::FloodFill(int x, int y, uint8_t colorIndex) {
+    uint8_t color;
+    if (!ResolveColor(colorIndex, color)) return;
+    const int64_t seedX = static_cast<int64_t>(x) - state.cameraX;
+    const int64_t seedY = static_cast<int64_t>(y) - state.cameraY;
+    if (seedX < clipX0 || seedX >= clipX1 || seedY < clipY0 || seedY >= clipY1) return;
+
+    // Without a pattern, filled pixels stop matching the target color, which keeps the fill
+    // from visiting them again. A pattern can leave filled pixels at the target color, so then
+    // a bitmap of the filled pixels is kept instead.
+    const uint8_t target = GetPixel(seedX, seedY);
+    const bool patterned = state.fillPattern != 0;
+    if (!patterned && (packed ? (color & 0x0F) : color) == target) return;
+    static thread_local std::vector<uint64_t> filled;
+    const int wordsPerRow = (width + 63) / 64;
+    if (patterned) {
+        filled.assign(static_cast<size_t>(wordsPerRow) * height, 0);
+    }
+    auto fillable = [&](int px, int py) {
+        if (GetPixel(px, py) != target) return false;
+        return !patterned || !((filled[py * wordsPerRow + (px >> 6)] >> (px & 63)) & 1);
+    };
+
+    // Span seed fill: grow each seed into the widest fillable span on its row, fill it, then
+    // seed the start of every fillable run directly above and below it.
+    std::vector<FloodSeed>& stack = FloodStack();
+    stack.clear();
+    stack.push_back({static_cast<int>(seedX), static_cast<int>(seedY)});
+    while (!stack.empty()) {
+        const FloodSeed seed = stack.back();
+        stack.pop_back();
+        if (!fillable(seed.x, seed.y)) continue;
+
+        int x0 = seed.x;
+        int x1 = seed.x + 1;
+        while (x0 > clipX0 && fillable(x0 - 1, seed.y)) --x0;
+        while (x1 < clipX1 && fillable(x1, seed.y)) ++x1;
+        if (patterned) {
+            for (int px = x0; px < x1; ++px) {
+                filled[seed.y * wordsPerRow + (px >> 6)] |= uint64_t{1} << (px & 63);
+            }
+        }
+        FillSpan(seed.y, x0, x1, color);
+
+        for (const int row : {seed.y - 1, seed.y + 1}) {
+            if (row < clipY0 || row >= clipY1) continue;
+            bool inRun = false;
+            for (int px = x0; px < x1; ++px) {
+                const bool open = fillable(px, row);
+                if (open && !inRun) stack.push_back({px, row});
+                inRun = open;
+            }
+        }
+    }
+}
+
+void Rasterizer::Remap(const uint8_t* table) {
+    if (clipX0 >= clipX1 || clipY0 >= clipY1) return;
+    // Wrap the table into the palette, as ResolveColor does for draw colors.
+    std::array<uint8_t, 256> lut;
+    for (int c = 0; c < 256; ++c) {
+        lut[c] = static_cast<uint8_t>(table[c] % paletteSize);
+    }
+    if (!packed) {
+        for (int y = clipY0; y < clipY1; ++y) {
+            uint8_t* row = &pixels[y * stride];
+            for (int x = clipX0; x < clipX1; ++x) {
+                row[x] = lut[row[x]];
+            }
+        }
+    } else {
+        // One lookup remaps both pixels of a byte.
+        std::array<uint8_t, 256> pairs;
+        for (int b = 0; b < 256; ++b) {
+            pairs[b] = static_cast<uint8_t>(lut[b & 0x0F] | (lut[b >> 4] << 4));
+        }
+        for (int y = clipY0; y < clipY1; ++y) {
+            int x0 = clipX0;
+            int x1 = clipX1;
+            if (x0 & 1) {
+                PutPixel(x0, y, lut[GetPixel(x0, y)]);
+                ++x0;
+            }
+            if ((x1 & 1) && x0 < x1) {
+                --x1;
+                PutPixel(x1, y, lut[GetPixel(x1, y)]);
+            }
+            uint8_t* row = &pixels[y * stride];
+            for (int i = x0 >> 1; i < x1 >> 1; ++i) {
+                row[i] = pairs[row[i]];
+            }
+        }
+    }
+    MarkDirtyRows(clipY0, clipY1 - 1);
+}
+
+void Rasterizer::Mosaic(int size) {
+    if (size <= 1 || clipX0 >= clipX1 || clipY0 >= clipY1) return;
+    const size_t spanWidth = static_cast<size_t>(clipX1 - clipX0);
+    for (int blockY0 = clipY0; blockY0 < clipY1;) {
+        const int blockY1 = std::min((blockY0 / size + 1) * size, clipY1);
+
+        // The first row of a band of blocks is reduced to one run per block, then copied down.
+        uint8_t* row = BeginRow(blockY0, clipX0, clipX1);
+        for (int blockX0 = clipX0; blockX0 < clipX1;) {
+            const int blockX1 = std::min((blockX0 / size + 1) * size, clipX1);
+            std::memset(row + blockX0, row[blockX0], static_cast<size_t>(blockX1 - blockX0));
+            blockX0 = blockX1;
+        }
+        EndRow(blockY0, clipX0, clipX1);
+        for (int y = blockY0 + 1; y < blockY1; ++y) {
+            if (packed) {
+                PackSpan(row + clipX0, clipX0, clipX1, &pixels[y * stride]);
+            } else {
+                std::memcpy(&pixels[y * stride + clipX0], row + clipX0, spanWidth);
+            }
+        }
+        blockY0 = blockY1;
+    }
+    MarkDirtyRows(clipY0, clipY1 - 1);
+}
+
+void Rasterizer::Wobble(int32_t amplitude, int32_t period, int32_t phase) {
+    if (clipX0 >= clipX1 || clipY0 >= clipY1) return;
+    const int spanWidth = clipX1 - clipX0;
+    const double pixelsAmplitude = static_cast<double>(amplitude) / AFFINE_ONE;
+    const double rows = static_cast<double>(period) / AFFINE_ONE;
+    const double turns = static_cast<double>(phase) / AFFINE_ONE;
+    std::vector<uint8_t>& carry = CarryScratch();
+    for (int y = clipY0; y < clipY1; ++y) {
+        const double angle = 6.283185307179586 * ((period != 0 ? y / rows : 0.0) + turns);
+        long long shift = std::llround(pixelsAmplitude * std::sin(angle)) % spanWidth;
+        if (shift < 0) shift += spanWidth;
+        if (shift == 0) continue;
+
+        // Rotate right: the last `shift` pixels wrap around to the front.
+        uint8_t* span = BeginRow(y, clipX0, clipX1) + clipX0;
+        const size_t kept = static_cast<size_t>(spanWidth - shift);
+        carry.assign(span + kept, span + spanWidth);
+        std::memmove(span + shift, span, kept);
+        std::memcpy(span, carry.data(), static_cast<size_t>(shift));
+        EndRow(y, clipX0, clipX1);
+    }
+    MarkDirtyRows(clipY0, clipY1 - 1);
+}
+
+void Rasterizer::Dissolve(int level, uint8_t colorIndex) {
+    // 4x4 Bayer matrix: each level adds the pixel spread farthest from those already set.
+    static constexpr uint8_t THRESHOLDS[4][4] = {{0, 8, 2, 10}, {12, 4, 14, 6}, {3, 11, 1, 9}, {15, 7, 13, 5}};
+    level = std::clamp(level, 0, DISSOLVE_LEVELS);
+    if (level == 0 || clipX0 >= clipX1) return;
+
+    // The pixels still to come are a fill pattern without an alternate color, so the spans
+    // run through the pattern kernel eight bytes at a time.
+    uint16_t skipped = 0;
+    for (int row = 0; row < 4; ++row) {
+        for (int column = 0; column < 4; ++column) {
+            if (THRESHOLDS[row][column] >= level) {
+                skipped |= static_cast<uint16_t>(0x8000 >> (row * 4 + column));
+            }
+        }
+    }
+    const uint16_t pattern = state.fillPattern;
+    const std::optional<uint8_t> altColor = state.fillAltColor;
+    SetFillPattern(skipped, std::nullopt);
+    const uint8_t color = static_cast<uint8_t>(colorIndex % paletteSize);
+    for (int y = clipY0; y < clipY1; ++y) {
+        FillSpan(y, clipX0, clipX1, color);
+    }
+    SetFillPattern(pattern, altColor);
+}
+
+uint8_t Rasterizer::Pget(int x, int y) const {
+    int screenX = x - state.cameraX;
+    int screenY = y - state.cameraY;
+
+    if (screenX >= 0 && screenX < width && screenY >= 0 && screenY < height) {
+        return GetPixel(screenX, screenY);
+    }
+    return 0; // Return color 0 (black) for out-of-bounds pixels.
+}
+
+void Rasterizer::Print(std::string_view text, int x, int y, uint8_t colorIndex) {
+    uint8_t color;
+    if (!ResolveColor(colorIndex, color)) return;
+
+    const int screenX = x - state.cameraX;
+    const int screenY = y - state.cameraY;
+
+    // Clip the glyph rows against the clip rectangle once for the whole string.
+    const int row0 = std::max(0, clipY0 - screenY);
+    const int row1 = std::min(EmbeddedFont::FONT_HEIGHT, clipY1 - screenY);
+    if (row0 >= row1) return;
+
+    const auto& glyphRuns = GetGlyphRuns();
+    int cursorX = screenX;
+    for (char c : text) {
+        // The cursor only moves right, so nothing after this point can be visible.
+        if (cursorX >= clipX1) break;
+
+        // Only render printable ASCII characters that are at least partly on screen.
+        if (c >= 32 && c <= 126 && cursorX + EmbeddedFont::FONT_WIDTH > clipX0) {
+            const GlyphRow* rows = &glyphRuns[(c - 32) * EmbeddedFont::FONT_HEIGHT];
+            for (int row = row0; row < row1; ++row) {
+                const GlyphRow& glyphRow = rows[row];
+                for (int run = 0; run < glyphRow.runCount; ++run) {
+                    int x0 = std::max(cursorX + glyphRow.runStart[run], clipX0);
+                    int x1 = std::min(cursorX + glyphRow.runStart[run] + glyphRow.runLength[run], clipX1);
+                    if (x0 < x1) {
+                        if (packed) {
+                            FillPackedSpan(&pixels[(screenY + row) * stride], x0, x1, color);
+                        } else {
+                            std::memset(&pixels[(screenY + row) * stride + x0], color, x1 - x0);
+                        }
+                    }
+                }
+            }
+        }
+        // Advance the cursor for the next character.
+        cursorX += EmbeddedFont::FONT_WIDTH; // Character spacing is now built into the font glyphs.
+    }
+    MarkDirtyRows(screenY + row0, screenY + row1 - 1);
+}
+
+void Rasterizer::Spr(int n, int x, int y, int w, int h, bool flipX, bool flipY) {
+    if (!spriteSheet || n < 0 || w <= 0 || h <= 0) return;
+    const int size = SpriteSheet::SPRITE_SIZE;
+    const int columns = spriteSheet->GetColumns();
+    BlitSheet((n % columns) * size, (n / columns) * size, w * size, h * size,
+              x - state.cameraX, y - state.cameraY, flipX, flipY);
+}
+
+void Rasterizer::BlitSheet(int sx, int sy, int sw, int sh, int dx, int dy, bool flipX, bool flipY) {
+    const SpriteSheet& sheet = *spriteSheet;
+    sheet.PrepareRuns(state.transparency);
+
+    // Visible source columns [u0, u1) and rows [v0, v1), relative to (sx, sy): inside the sheet
+    // and mapping inside the clip rectangle. Flipped axes map u to dx + sw - 1 - u.
+    int u0 = std::max(0, -sx);
+    int u1 = std::min(sw, sheet.GetWidth() - sx);
+    int v0 = std::max(0, -sy);
+    int v1 = std::min(sh, sheet.GetHeight() - sy);
+    if (flipX) {
+        u0 = std::max(u0, dx + sw - clipX1);
+        u1 = std::min(u1, dx + sw - clipX0);
+    } else {
+        u0 = std::max(u0, clipX0 - dx);
+        u1 = std::min(u1, clipX1 - dx);
+    }
+    if (flipY) {
+        v0 = std::max(v0, dy + sh - clipY1);
+        v1 = std::min(v1, dy + sh - clipY0);
+    } else {
+        v0 = std::max(v0, clipY0 - dy);
+        v1 = std::min(v1, clipY1 - dy);
+    }
+    if (u0 >= u1 || v0 >= v1) return;
+
+    const uint8_t* sheetPixels = sheet.GetPixels().data();
+    const int sheetWidth = sheet.GetWidth();
+    const int visibleX0 = sx + u0; // Visible source columns in sheet coordinates.
+    const int visibleX1 = sx + u1;
+    const int firstCell = visibleX0 / SpriteSheet::SPRITE_SIZE;
+    const int lastCell = (visibleX1 - 1) / SpriteSheet::SPRITE_SIZE;
+    const int dstX0 = flipX ? dx + sw - u1 : dx + u0; // Destination columns [dstX0, dstX1).
+    const int dstX1 = dstX0 + (u1 - u0);
+
+    for (int v = v0; v < v1; ++v) {
+        const int srcY = sy + v;
+        const int dstY = flipY ? dy + sh - 1 - v : dy + v;
+        const uint8_t* srcRow = &sheetPixels[srcY * sheetWidth];
+        uint8_t* dstRow = BeginRow(dstY, dstX0, dstX1);
+
+        for (int cell = firstCell; cell <= lastCell; ++cell) {
+            for (const SpriteSheet::Run* run = sheet.CellRunsBegin(srcY, cell); run != sheet.CellRunsEnd(srcY, cell); ++run) {
+                const int runX0 = std::max<int>(run->x, visibleX0);
+                const int runX1 = std::min<int>(run->x + run->length, visibleX1);
+                if (runX0 >= runX1) continue;
+
+                if (!flipX) {
+                    CopyRemapped(dstRow + dx + (runX0 - sx), srcRow + runX0, runX1 - runX0);
+                } else {
+                    uint8_t* dst = dstRow + dx + sw - 1 - (runX0 - sx);
+                    for (int srcX = runX0; srcX < runX1; ++srcX) {
+                        *dst-- = state.drawPalette[srcRow[srcX]];
+                    }
+                }
+            }
+        }
+        EndRow(dstY, dstX0, dstX1);
+    }
+
+    const int dirtyY0 = flipY ? dy + sh - v1 : dy + v0;
+    MarkDirtyRows(dirtyY0, dirtyY0 + (v1 - v0) - 1);
+}
+
+void Rasterizer::Sspr(int sx, int sy, int sw, int sh, int dx, int dy, int dw, int dh, bool flipX, bool flipY) {
+    if (!spriteSheet || sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0) return;
+    dx -= state.cameraX;
+    dy -= state.cameraY;
+    if (dw == sw && dh == sh) {
+        BlitSheet(sx, sy, sw, sh, dx, dy, flipX, flipY);
+        return;
+    }
+
+    // Stretched blit: nearest-neighbor sampling. Source columns are stepped with an exact
+    // integer DDA (quotient + remainder), so u == (x - dx) * sw / dw without a division per pixel.
+    // Transparent source pixels are masked out with opaqueBytes rather than a branch.
+    const SpriteSheet& sheet = *spriteSheet;
+    const int x0 = std::max(dx, clipX0);
+    const int x1 = std::min(dx + dw, clipX1);
+    const int y0 = std::max(dy, clipY0);
+    const int y1 = std::min(dy + dh, clipY1);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    const uint8_t* sheetPixels = sheet.GetPixels().data();
+    const uint8_t* remap = state.drawPalette.data();
+    const int stepWhole = sw / dw;
+    const int stepRemainder = sw % dw;
+    for (int y = y0; y < y1; ++y) {
+        int v = static_cast<int>(static_cast<int64_t>(y - dy) * sh / dh);
+        if (flipY) v = sh - 1 - v;
+        const int srcY = sy + v;
+        if (srcY < 0 || srcY >= sheet.GetHeight()) continue;
+
+        const uint8_t* srcRow = &sheetPixels[srcY * sheet.GetWidth()];
+        uint8_t* dstRow = BeginRow(y, x0, x1);
+        const int64_t start = static_cast<int64_t>(x0 - dx) * sw;
+        int u = static_cast<int>(start / dw);
+        int remainder = static_cast<int>(start % dw);
+        for (int x = x0; x < x1; ++x) {
+            int srcX = sx + (flipX ? sw - 1 - u : u);
+            if (srcX >= 0 && srcX < sheet.GetWidth()) {
+                const uint8_t color = srcRow[srcX];
+                const uint8_t keep = opaqueBytes[color];
+                dstRow[x] = static_cast<uint8_t>((remap[color] & keep) | (dstRow[x] & ~keep));
+            }
+            u += stepWhole;
+            remainder += stepRemainder;
+            if (remainder >= dw) {
+                remainder -= dw;
+                ++u;
+            }
+        }
+        EndRow(y, x0, x1);
+    }
+    MarkDirtyRows(y0, y1 - 1);
+}
+
+void Rasterizer::Rspr(int sourceId, int sx, int sy, int sw, int sh, int x, int y, int32_t angle, int32_t scaleX, int32_t scaleY) {
+    const uint8_t* source;
+    int sourceWidth, sourceHeight, sourceStride;
+    bool sourcePacked = false;
+    if (sourceId == SPRITE_SHEET_SOURCE) {
+        if (!spriteSheet) return;
+        source = spriteSheet->GetPixels().data();
+        sourceWidth = sourceStride = spriteSheet->GetWidth();
+        sourceHeight = spriteSheet->GetHeight();
+    } else {
+        if (!surfaces || sourceId < 0 || sourceId >= static_cast<int>(surfaces->size()) || !(*surfaces)[sourceId]) return;
+        const Surface& surface = *(*surfaces)[sourceId];
+        source = surface.pixels;
+        sourceWidth = surface.width;
+        sourceHeight = surface.height;
+        sourceStride = surface.Stride();
+        sourcePacked = surface.packed;
+    }
+
+    // Scales are kept within 1/256..256, so every product below fits in 64 bits.
+    constexpr int64_t minScale = AFFINE_ONE / 256;
+    constexpr int64_t maxScale = int64_t{AFFINE_ONE} * 256;
+    if (sw <= 0 || sh <= 0 || std::llabs(scaleX) < minScale || std::llabs(scaleY) < minScale) return;
+    const int64_t scaleU = std::clamp<int64_t>(scaleX, -maxScale, maxScale);
+    const int64_t scaleV = std::clamp<int64_t>(scaleY, -maxScale, maxScale);
+
+    // Source offsets [u0, u1) x [v0, v1) of the rectangle that lie inside the source.
+    const int64_t u0 = std::max<int64_t>(0, -static_cast<int64_t>(sx));
+    const int64_t u1 = std::min<int64_t>(sw, static_cast<int64_t>(sourceWidth) - sx);
+    const int64_t v0 = std::max<int64_t>(0, -static_cast<int64_t>(sy));
+    const int64_t v1 = std::min<int64_t>(sh, static_cast<int64_t>(sourceHeight) - sy);
+    if (u0 >= u1 || v0 >= v1) return;
+
+    // Rows are bounded, and the draw culled, by the rotated rectangle's bounding box.
+    const double radians = angle * (6.283185307179586 / AFFINE_ONE);
+    const double c = std::cos(radians);
+    const double s = std::sin(radians);
+    const double halfW = sw * std::fabs(static_cast<double>(scaleU)) / (2.0 * AFFINE_ONE);
+    const double halfH = sh * std::fabs(static_cast<double>(scaleV)) / (2.0 * AFFINE_ONE);
+    const double extentX = std::fabs(c) * halfW + std::fabs(s) * halfH + 1;
+    const double extentY = std::fabs(s) * halfW + std::fabs(c) * halfH + 1;
+    const int64_t cx = static_cast<int64_t>(x) - state.cameraX;
+    const int64_t cy = static_cast<int64_t>(y) - state.cameraY;
+    const int rowLo = static_cast<int>(std::max<double>(clipY0, std::floor(cy - extentY)));
+    const int rowHi = static_cast<int>(std::min<double>(clipY1, std::ceil(cy + extentY) + 1));
+    if (rowLo >= rowHi || cx + extentX < clipX0 || cx - extentX >= clipX1 || clipX0 >= clipX1) return;
+
+    // A packed source, or one that is also the target, is staged unpacked so that sampling
+    // reads the original pixels. `offsetU`/`offsetV` turn a source offset into a column and row.
+    const uint8_t* sample = source;
+    int sampleStride = sourceStride;
+    int64_t offsetU = sx;
+    int64_t offsetV = sy;
+    if (sourcePacked || source == pixels) {
+        static thread_local std::vector<uint8_t> staged;
+        const int64_t cols = u1 - u0;
+        staged.resize(static_cast<size_t>(cols * (v1 - v0)));
+        for (int64_t v = v0; v < v1; ++v) {
+            const uint8_t* row = source + (sy + v) * sourceStride;
+            uint8_t* out = staged.data() + (v - v0) * cols;
+            if (sourcePacked) {
+                UnpackSpan(row, sx + u0, sx + u1, out);
+            } else {
+                std::memcpy(out, row + sx + u0, static_cast<size_t>(cols));
+            }
+        }
+        sample = staged.data();
+        sampleStride = static_cast<int>(cols);
+        offsetU = -u0;
+        offsetV = -v0;
+    }
+
+    // Inverse mapping: the pixel center at offset (dx, dy) from (x, y) samples source offset
+    // (sw / 2, sh / 2) + S^-1 R(-angle) (dx, dy). Both offsets are fixed point and linear in
+    // the pixel position, so each row starts with an exact product and steps by additions;
+    // the run of columns that land inside the source is solved per row, not tested per pixel.
+    const double one = AFFINE_ONE;
+    const int64_t duDx = std::llround(c * one * one / scaleU);
+    const int64_t duDy = std::llround(-s * one * one / scaleU);
+    const int64_t dvDx = std::llround(s * one * one / scaleV);
+    const int64_t dvDy = std::llround(c * one * one / scaleV);
+    const int64_t centerU = static_cast<int64_t>(sw) << (AFFINE_SHIFT - 1);
+    const int64_t centerV = static_cast<int64_t>(sh) << (AFFINE_SHIFT - 1);
+    const int64_t dx2 = 2 * static_cast<int64_t>(clipX0) + 1 - 2 * cx; // Twice dx at the first clipped column.
+    const uint8_t* remap = state.drawPalette.data();
+    int firstRow = rowHi;
+    int lastRow = rowLo - 1;
+    for (int row = rowLo; row < rowHi; ++row) {
+        const int64_t dy2 = 2 * static_cast<int64_t>(row) + 1 - 2 * cy;
+        const int64_t uStart = centerU + ((dx2 * duDx + dy2 * duDy) >> 1);
+        const int64_t vStart = centerV + ((dx2 * dvDx + dy2 * dvDy) >> 1);
+        int64_t kLo = 0;
+        int64_t kHi = clipX1 - clipX0;
+        NarrowSteps(uStart, duDx, u0 << AFFINE_SHIFT, u1 << AFFINE_SHIFT, kLo, kHi);
+        NarrowSteps(vStart, dvDx, v0 << AFFINE_SHIFT, v1 << AFFINE_SHIFT, kLo, kHi);
+        if (kLo >= kHi) continue;
+
+        const int x0 = clipX0 + static_cast<int>(kLo);
+        const int x1 = clipX0 + static_cast<int>(kHi);
+        int64_t u = uStart + kLo * duDx;
+        int64_t v = vStart + kLo * dvDx;
+        uint8_t* dstRow = BeginRow(row, x0, x1);
+        for (int px = x0; px < x1; ++px, u += duDx, v += dvDx) {
+            const uint8_t color = sample[((v >> AFFINE_SHIFT) + offsetV) * sampleStride + (u >> AFFINE_SHIFT) + offsetU];
+            const uint8_t keep = opaqueBytes[color];
+            dstRow[px] = static_cast<uint8_t>((remap[color] & keep) | (dstRow[px] & ~keep));
+        }
+        EndRow(row, x0, x1);
+        firstRow = std::min(firstRow, row);
+        lastRow = row;
+    }
+    if (firstRow <= lastRow) MarkDirtyRows(firstRow, lastRow);
+}
+
+void Rasterizer::Map(int celX, int celY, int x, int y, int celW, int celH) {
+    if (!tilemap || !spriteSheet || celW <= 0 || celH <= 0) return;
+    const int tile = Tilemap::TILE_SIZE;
+    const int chunkSize = Tilemap::CHUNK_PIXELS;
+
+    // Work in map pixel coordinates: the requested cells, cut to the map and to the clip rectangle.
+    // A map pixel (mx, my) lands on screen pixel (mx + offsetX, my + offsetY).
+    const int offsetX = x - state.cameraX - celX * tile;
+    const int offsetY = y - state.cameraY - celY * tile;
+    const int mx0 = std::max({celX * tile, 0, clipX0 - offsetX});
+    const int my0 = std::max({celY * tile, 0, clipY0 - offsetY});
+    const int mx1 = std::min({(celX + celW) * tile, tilemap->GetWidth() * tile, clipX1 - offsetX});
+    const int my1 = std::min({(celY + celH) * tile, tilemap->GetHeight() * tile, clipY1 - offsetY});
+    if (mx0 >= mx1 || my0 >= my1) return;
+
+    // Compose every visible chunk from its cached raster, copying whole opaque runs per row.
+    for (int chunkY = my0 / chunkSize; chunkY <= (my1 - 1) / chunkSize; ++chunkY) {
+        for (int chunkX = mx0 / chunkSize; chunkX <= (mx1 - 1) / chunkSize; ++chunkX) {
+            const Tilemap::ChunkRaster& raster = tilemap->GetChunk(chunkX, chunkY, *spriteSheet, state.transparency);
+            const int originX = chunkX * chunkSize;
+            const int originY = chunkY * chunkSize;
+            const int visibleX0 = std::max(mx0, originX) - originX; // Visible chunk columns [visibleX0, visibleX1).
+            const int visibleX1 = std::min(mx1, originX + chunkSize) - originX;
+            const int rowStart = std::max(my0, originY) - originY;
+            const int rowEnd = std::min(my1, originY + chunkSize) - originY;
+
+            const int dstX = originX + offsetX;
+            for (int row = rowStart; row < rowEnd; ++row) {
+                const int dstY = originY + row + offsetY;
+                const uint8_t* src = &raster.pixels[row * chunkSize];
+                uint8_t* dst = BeginRow(dstY, dstX + visibleX0, dstX + visibleX1) + dstX;
+                for (int r = raster.rowRunIndex[row]; r < raster.rowRunIndex[row + 1]; ++r) {
+                    const int runX0 = std::max<int>(raster.runs[r].x, visibleX0);
+                    const int runX1 = std::min<int>(raster.runs[r].x + raster.runs[r].length, visibleX1);
+                    if (runX0 < runX1) {
+                        CopyRemapped(dst + runX0, src + runX0, runX1 - runX0);
+                    }
+                }
+                EndRow(dstY, dstX + visibleX0, dstX + visibleX1);
+            }
+        }
+    }
+    MarkDirtyRows(my0 + offsetY, my1 - 1 + offsetY);
+}
+
+const std::vector<Rasterizer::GlyphRow>& Rasterizer::GetGlyphRuns() {
+    // Decode every glyph row of the embedded font into horizontal runs of set bits, once.
+    static const std::vector<GlyphRow> runs = [] {
+        std::vector<GlyphRow> table(EmbeddedFont::FONT_NUM_CHARS * EmbeddedFont::FONT_HEIGHT);
+        for (size_t i = 0; i < table.size(); ++i) {
+            uint8_t rowData = EmbeddedFont::FONT_DATA[i];
+            GlyphRow& glyphRow = table[i];
+            int col = 0;
+            while (col < EmbeddedFont::FONT_WIDTH) {
+                // The most significant bit is column 0.
+                if (!((rowData >> (7 - col)) & 1)) {
+                    ++col;
+                    continue;
+                }
+                int start = col;
+                while (col < EmbeddedFont::FONT_WIDTH && ((rowData >> (7 - col)) & 1)) {
+                    ++col;
+                }
+                glyphRow.runStart[glyphRow.runCount] = static_cast<uint8_t>(start);
+                glyphRow.runLength[glyphRow.runCount] = static_cast<uint8_t>(col - start);
+                ++glyphRow.runCount;
+            }
+        }
+        return table;
+    }();
+    return runs;
+}
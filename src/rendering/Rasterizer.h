@@ -0,0 +1,303 @@
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+#include <vector>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include <array>
+#include <memory>
+#include "rendering/Surface.h"
+#include "rendering/TransparencyMask.h"
+
+class SpriteSheet;
+class Tilemap;
+
+/// @class Rasterizer
+/// @brief Draws primitives into a color-indexed pixel buffer it does not own.
+///
+/// Holds the drawing state (camera, transparency mask, draw palette, clip rectangle, fill pattern) and the range of rows
+/// written since the last ResetDamage(). A Rasterizer is cheap to copy: copies share the pixel
+/// buffer, sprite sheet and tilemap, so several copies clipped to disjoint rows can draw into
+/// the same buffer from different threads.
+class Rasterizer {
+public:
+    // TriFill/PolyFill vertices are fixed point with FIXED_SHIFT fractional bits.
+    static constexpr int FIXED_SHIFT = 8;
+    static constexpr int32_t FIXED_ONE = 1 << FIXED_SHIFT;
+
+    // Converts a coordinate in pixels to fixed point, clamped to the supported vertex range.
+    static int32_t ToFixed(double value);
+
+    // Rspr angles (in turns) and scales are fixed point with AFFINE_SHIFT fractional bits.
+    static constexpr int AFFINE_SHIFT = 16;
+    static constexpr int32_t AFFINE_ONE = 1 << AFFINE_SHIFT;
+
+    // Converts an angle or scale to AFFINE_ONE fixed point, clamped to the int32 range.
+    static int32_t ToAffine(double value);
+
+    // Rspr source id that reads the sprite sheet rather than a surface.
+    static constexpr int SPRITE_SHEET_SOURCE = -1;
+
+    // Clip bound meaning "no clipping on this side".
+    static constexpr int UNCLIPPED = 1 << 30;
+
+    // Drawing state that display lists record at the start of a frame and restore on replay.
+    struct DrawState {
+        int cameraX = 0;
+        int cameraY = 0;
+        TransparencyMask transparency;
+        std::array<uint8_t, 256> drawPalette = IdentityPalette(); // Color remap applied by every draw.
+        int clipX0 = 0;       // Requested clip rectangle [clipX0, clipX1) x [clipY0, clipY1),
+        int clipY0 = 0;       // before it is cut to the buffer.
+        int clipX1 = UNCLIPPED;
+        int clipY1 = UNCLIPPED;
+        uint16_t fillPattern = 0;            // 4x4 fill pattern; 0 fills solid.
+        std::optional<uint8_t> fillAltColor; // Drawn where the pattern bit is set; empty skips those pixels.
+    };
+
+    static constexpr std::array<uint8_t, 256> IdentityPalette() {
+        std::array<uint8_t, 256> palette{};
+        for (int i = 0; i < 256; ++i) palette[i] = static_cast<uint8_t>(i);
+        return palette;
+    }
+
+    Rasterizer(uint8_t* pixels, int width, int height);
+
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+
+    // Redirects drawing to another pixel buffer. The drawing state is kept; damage is reset.
+    // A `packed` buffer holds two pixels per byte, the left one in the low nibble, so only
+    // the low four bits of each color are stored.
+    void SetTarget(uint8_t* targetPixels, int targetWidth, int targetHeight, bool packed = false);
+    bool IsPacked() const { return packed; }
+
+    // --- State ---
+    void SetCamera(int x, int y) { state.cameraX = x; state.cameraY = y; }
+    int GetCameraX() const { return state.cameraX; }
+    int GetCameraY() const { return state.cameraY; }
+
+    // Makes exactly `colorIndex` transparent, or nothing for std::nullopt.
+    void SetTransparentColor(std::optional<uint8_t> colorIndex);
+    // Adds or removes one color from the transparency mask.
+    void SetTransparent(uint8_t colorIndex, bool transparent);
+    const TransparencyMask& GetTransparency() const { return state.transparency; }
+
+    // Makes every later draw of color `from` write color `to` instead.
+    void SetDrawPaletteEntry(uint8_t from, uint8_t to);
+    void ResetDrawPalette();
+
+    // Fill pattern for the span, outline and point primitives. Bit 15 - (4 * row + column) of
+    // `pattern` covers the screen pixels with y % 4 == row and x % 4 == column; where it is set,
+    // `altColor` is drawn instead of the primitive's color, or nothing if it is empty.
+    void SetFillPattern(uint16_t pattern, std::optional<uint8_t> altColor);
+
+    const DrawState& GetDrawState() const { return state; }
+    void SetDrawState(const DrawState& newState);
+
+    // Color indices are wrapped modulo the palette size before they are written.
+    void SetPaletteSize(size_t size) { paletteSize = size == 0 ? 1 : size; }
+
+    void SetSpriteSheet(const SpriteSheet* sheet) { spriteSheet = sheet; }
+    void SetTilemap(Tilemap* map) { tilemap = map; }
+
+    // Surfaces Blit() can read from, indexed by surface id. Null slots are free ids.
+    void SetSurfaces(const std::vector<std::unique_ptr<Surface>>* table) { surfaces = table; }
+
+    // Restricts writes to the screen rectangle [x0, x1) x [y0, y1), cut to the buffer.
+    // The camera does not move the clip rectangle. Kernels shrink their loops to it.
+    void SetClip(int x0, int y0, int x1, int y1);
+    void ResetClip() { SetClip(0, 0, UNCLIPPED, UNCLIPPED); }
+    // SetClip() for the rectangle at (x, y) of size w x h. A non-positive size clips everything.
+    void SetClipRect(int x, int y, int w, int h);
+
+    // Further restricts writes to rows [y0, y1), independently of SetClip. Used to split one
+    // frame between threads: copies with disjoint bands never write the same pixel.
+    void SetBand(int y0, int y1);
+
+
+    // --- Drawing ---
+    void Clear(uint8_t colorIndex);
+    void SetPixel(int x, int y, uint8_t colorIndex);
+    void Line(int x1, int y1, int x2, int y2, uint8_t colorIndex);
+    void Rect(int x, int y, int w, int h, uint8_t colorIndex);
+    void RectFill(int x, int y, int w, int h, uint8_t colorIndex);
+    void Circ(int centerX, int centerY, int radius, uint8_t colorIndex);
+    void CircFill(int centerX, int centerY, int radius, uint8_t colorIndex);
+    // Fills the pixels whose centers lie inside the triangle or polygon, with the top-left rule
+    // for centers exactly on an edge, so shapes sharing an edge never overlap or leave a gap.
+    // Vertices are fixed point. Polygons are filled even-odd and may be concave.
+    void TriFill(int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint8_t colorIndex);
+    void PolyFill(const int32_t* coords, int vertexCount, uint8_t colorIndex); // x, y pairs.
+    // Fills the 4-connected region of pixels that have the color at (x, y), within the clip
+    // rectangle, through the fill pattern.
+    void FloodFill(int x, int y, uint8_t colorIndex);
+    uint8_t Pget(int x, int y) const;
+    void Print(std::string_view text, int x, int y, uint8_t colorIndex);
+    void Spr(int n, int x, int y, int w, int h, bool flipX, bool flipY);
+    void Sspr(int sx, int sy, int sw, int sh, int dx, int dy, int dw, int dh, bool flipX, bool flipY);
+    void Map(int celX, int celY, int x, int y, int celW, int celH);
+    // Copies the w x h rectangle at (sx, sy) of surface `sourceId` to (dx, dy). With `masked`,
+    // transparent colors are skipped. The draw palette applies; the source may be the target.
+    void Blit(int sourceId, int sx, int sy, int w, int h, int dx, int dy, bool masked);
+    // Draws the sw x sh rectangle at (sx, sy) of surface `sourceId` (or the sprite sheet for
+    // SPRITE_SHEET_SOURCE) scaled by (scaleX, scaleY), then rotated counterclockwise by `angle`
+    // turns about its center, which lands on (x, y). Fixed point, see AFFINE_SHIFT; negative
+    // scales flip. Each pixel center samples the source nearest-neighbor; transparent colors
+    // are skipped and the draw palette applies.
+    void Rspr(int sourceId, int sx, int sy, int sw, int sh, int x, int y, int32_t angle, int32_t scaleX, int32_t scaleY);
+
+    // --- Effects ---
+    // Effects rewrite the pixels inside the clip rectangle, whatever drew them. The camera, draw
+    // palette, transparency and fill pattern do not apply.
+
+    // Number of steps of the Dissolve() dither matrix.
+    static constexpr int DISSOLVE_LEVELS = 16;
+
+    // Replaces every pixel's color c with lut[c]; `lut` has 256 entries.
+    void Remap(const uint8_t* lut);
+    // Paints each size x size block of a grid anchored at the screen's top-left corner with the
+    // color of its top-left pixel inside the clip rectangle.
+    void Mosaic(int size);
+    // Rotates every row horizontally, wrapping around the clip rectangle, by
+    // amplitude * sin(2 pi (y / period + phase)) pixels, rounded; positive values move right.
+    // Amplitude and period are in pixels and phase in turns, AFFINE_ONE fixed point. A zero
+    // period moves every row by the same amount.
+    void Wobble(int32_t amplitude, int32_t period, int32_t phase);
+    // Sets the pixels whose threshold in a 4x4 ordered-dither matrix is below `level` (0 to
+    // DISSOLVE_LEVELS) to a color, so raising the level step by step dissolves into it.
+    void Dissolve(int level, uint8_t colorIndex);
+
+    // --- Damage tracking ---
+    // Rows [GetDirtyMinY(), GetDirtyMaxY()] may have been written; empty when min > max.
+    int GetDirtyMinY() const { return dirtyMinY; }
+    int GetDirtyMaxY() const { return dirtyMaxY; }
+    void MarkDirtyRows(int y0, int y1) {
+        if (y0 < dirtyMinY) dirtyMinY = y0;
+        if (y1 > dirtyMaxY) dirtyMaxY = y1;
+    }
+    void ResetDamage() {
+        dirtyMinY = height;
+        dirtyMaxY = -1;
+    }
+
+private:
+    // One row of a font glyph, decoded into horizontal runs of set pixels.
+    // An 8-pixel row holds at most four separate runs.
+    struct GlyphRow {
+        uint8_t runCount = 0;
+        uint8_t runStart[4] = {};
+        uint8_t runLength[4] = {};
+    };
+
+    // Run-decoded rows of every glyph in EmbeddedFont, FONT_HEIGHT rows per character.
+    static const std::vector<GlyphRow>& GetGlyphRuns();
+
+    // Resolves a color index against the transparency state and palette size.
+    // Returns false if the color is transparent and nothing should be drawn.
+    bool ResolveColor(uint8_t colorIndex, uint8_t& resolved) const;
+
+    // Fills the screen-space span [x0, x1) on row y through the fill pattern. The span must
+    // already be clipped. FillSolidSpan ignores the pattern, and FillPatternSpan requires one.
+    void FillSpan(int y, int x0, int x1, uint8_t resolvedColor) {
+        if (state.fillPattern != 0) {
+            FillPatternSpan(y, x0, x1, resolvedColor);
+        } else {
+            FillSolidSpan(y, x0, x1, resolvedColor);
+        }
+    }
+    void FillSolidSpan(int y, int x0, int x1, uint8_t resolvedColor);
+    void FillPatternSpan(int y, int x0, int x1, uint8_t resolvedColor);
+
+    // Writes one clipped pixel of a primitive through the fill pattern.
+    void Plot(int64_t x, int64_t y, uint8_t resolvedColor) {
+        if (state.fillPattern & (0x8000 >> (((y & 3) << 2) | (x & 3)))) {
+            if (!state.fillAltColor) return;
+            resolvedColor = static_cast<uint8_t>(state.drawPalette[*state.fillAltColor] % paletteSize);
+        }
+        PutPixel(x, y, resolvedColor);
+    }
+
+    // Writes one clipped pixel, in either buffer layout.
+    void PutPixel(int64_t x, int64_t y, uint8_t color) {
+        if (packed) {
+            uint8_t& pair = pixels[y * stride + (x >> 1)];
+            const int shift = static_cast<int>(x & 1) * 4;
+            pair = static_cast<uint8_t>((pair & ~(0x0F << shift)) | ((color & 0x0F) << shift));
+        } else {
+            pixels[y * stride + x] = color;
+        }
+    }
+
+    // Reads one pixel inside the buffer, in either layout.
+    uint8_t GetPixel(int64_t x, int64_t y) const {
+        if (packed) {
+            return static_cast<uint8_t>((pixels[y * stride + (x >> 1)] >> ((x & 1) * 4)) & 0x0F);
+        }
+        return pixels[y * stride + x];
+    }
+
+    // Row kernels that copy pixel by pixel (sprites, tiles, blits) address row y through the
+    // returned pointer, indexed by x. On packed buffers it points to an unpacked copy of the
+    // columns [x0, x1), which EndRow() packs back.
+    uint8_t* BeginRow(int y, int x0, int x1);
+    void EndRow(int y, int x0, int x1);
+
+    // Draw the screen-space row span [x0, x1] on row y, or column span [y0, y1] on column x,
+    // after cutting them to the clip rectangle.
+    void HLine(int64_t y, int64_t x0, int64_t x1, uint8_t resolvedColor);
+    void VLine(int64_t x, int64_t y0, int64_t y1, uint8_t resolvedColor);
+
+    // Copies an unscaled sheet rectangle to screen position (dx, dy) from its opaque runs.
+    void BlitSheet(int sx, int sy, int sw, int sh, int dx, int dy, bool flipX, bool flipY);
+
+    // Recomputes the effective clip rectangle from the requested clip and the band.
+    void UpdateClip();
+
+    // Recomputes opaqueBytes after a transparency change.
+    void UpdateTransparency();
+
+    // Recomputes patternMasks after a fill pattern change.
+    void UpdateFillPattern();
+
+    // Copies `count` sheet pixels through the draw palette (a plain copy when it is the identity).
+    void CopyRemapped(uint8_t* dst, const uint8_t* src, int count) const;
+
+    uint8_t* pixels;
+    int width;
+    int height;
+    int stride;          // Bytes per row.
+    bool packed = false;
+    DrawState state;
+    size_t paletteSize = 16;
+    const SpriteSheet* spriteSheet = nullptr;
+    Tilemap* tilemap = nullptr;
+    const std::vector<std::unique_ptr<Surface>>* surfaces = nullptr;
+
+    // Derived from the state: 0x00 for transparent colors and 0xFF for opaque ones, so sampled
+    // blits can mask pixels without a branch; and whether the draw palette is the identity.
+    std::array<uint8_t, 256> opaqueBytes;
+    bool identityDrawPalette = true;
+
+    // Derived from the fill pattern: for pattern row r and first column phase p (x % 4), the
+    // bytes of the eight-byte word patternMasks[packed][r][p] are all ones where the pattern bit
+    // of that pixel (8bpp) or nibble (packed) is set. The pattern repeats every four pixels, so
+    // one word covers a whole span, eight bytes at a time.
+    uint64_t patternMasks[2][4][4] = {};
+
+    // Band and the effective clip rectangle the kernels use: the requested clip cut to the band
+    // and the buffer, [clipX0, clipX1) x [clipY0, clipY1) in screen space.
+    int bandY0 = 0;
+    int bandY1;
+    int clipX0 = 0;
+    int clipY0 = 0;
+    int clipX1;
+    int clipY1;
+
+    int dirtyMinY = 0;
+    int dirtyMaxY = -1;
+};
+
+#endif // RASTERIZER_H
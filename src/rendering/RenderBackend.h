@@ -0,0 +1,42 @@
+#ifndef RENDER_BACKEND_H
+#define RENDER_BACKEND_H
+
+#include <SDL.h>
+#include <cstdint>
+
+/// @class RenderBackend
+/// @brief Destination for the palette-expanded output image of the AestheticLayer.
+/// The layer converts changed framebuffer rows straight into memory handed out by the
+/// backend, then asks the backend to show the result. All calls are made from the
+/// thread calling AestheticLayer::Present(), also in pipelined mode, so a backend may
+/// wrap an SDL renderer, which only works on the thread that created it.
+class RenderBackend {
+public:
+    virtual ~RenderBackend() = default;
+
+    /// @brief Packs a palette color into the backend's 32-bit pixel format.
+    virtual uint32_t MapColor(const SDL_Color& color) const = 0;
+
+    /**
+     * @brief Gives write access to rows [y0, y1) of the output image.
+     * @param pixels Receives a pointer to the first pixel of row y0.
+     * @param pitch Receives the distance in bytes between consecutive rows.
+     * @return False if the rows could not be mapped; nothing must be written then.
+     */
+    virtual bool LockRows(int y0, int y1, uint32_t*& pixels, int& pitch) = 0;
+
+    /// @brief Commits the rows obtained by the last successful LockRows() call.
+    virtual void UnlockRows() = 0;
+
+    /// @brief Shows the current output image.
+    virtual void Show() = 0;
+
+    /// @brief Changes the size of the output image; its contents are undefined afterwards.
+    /// @return False if the image could not be resized; the old size stays in effect then.
+    virtual bool Resize(int width, int height) = 0;
+
+    /// @brief A short name used in log messages.
+    virtual const char* GetName() const = 0;
+};
+
+#endif // RENDER_BACKEND_H
@@ -0,0 +1,123 @@
+#include "rendering/SDLRenderBackend.h"
+#include <stdexcept>
+#include <iostream>
+
+SDLRenderBackend::SDLRenderBackend(SDL_Renderer* renderer, int width, int height)
+    : renderer(renderer), width(width), height(height) {
+    if (!renderer) {
+        throw std::runtime_error("The renderer provided to AestheticLayer is null.");
+    }
+
+    // Create the texture that we will use as our final canvas, preferring the renderer's
+    // native 32-bit format so the driver does not have to convert it again on upload.
+    // SDL_TEXTUREACCESS_STREAMING allows us to update it efficiently every frame.
+    Uint32 format = SelectTextureFormat(renderer);
+    texture = SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STREAMING, width, height);
+    if (!texture && format != SDL_PIXELFORMAT_ARGB8888) {
+        format = SDL_PIXELFORMAT_ARGB8888;
+        texture = SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STREAMING, width, height);
+    }
+    if (!texture) {
+        throw std::runtime_error("Could not create the aesthetic layer texture.");
+    }
+    textureFormat = SDL_AllocFormat(format);
+    if (!textureFormat) {
+        SDL_DestroyTexture(texture);
+        throw std::runtime_error("Could not allocate the aesthetic layer pixel format.");
+    }
+    std::cout << "SDLRenderBackend: Texture format is " << SDL_GetPixelFormatName(format) << "." << std::endl;
+}
+
+SDLRenderBackend::~SDLRenderBackend() {
+    if (texture) {
+        SDL_DestroyTexture(texture);
+    }
+    if (textureFormat) {
+        SDL_FreeFormat(textureFormat);
+    }
+}
+
+Uint32 SDLRenderBackend::SelectTextureFormat(SDL_Renderer* renderer) {
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(renderer, &info) == 0) {
+        // Formats are listed in the renderer's order of preference; take the first packed 32-bit one.
+        for (Uint32 i = 0; i < info.num_texture_formats; ++i) {
+            Uint32 candidate = info.texture_formats[i];
+            if (!SDL_ISPIXELFORMAT_FOURCC(candidate) && !SDL_ISPIXELFORMAT_INDEXED(candidate) &&
+                SDL_BYTESPERPIXEL(candidate) == 4) {
+                return candidate;
+            }
+        }
+    }
+    return SDL_PIXELFORMAT_ARGB8888;
+}
+
+uint32_t SDLRenderBackend::MapColor(const SDL_Color& color) const {
+    // Colors are packed in the texture's own format, so no further conversion happens on upload.
+    return SDL_MapRGBA(textureFormat, color.r, color.g, color.b, color.a);
+}
+
+bool SDLRenderBackend::LockRows(int y0, int y1, uint32_t*& pixels, int& pitch) {
+    lockedRect = SDL_Rect{0, y0, width, y1 - y0};
+
+    if (zeroCopy) {
+        // Hand out the texture's memory directly; the caller honors its pitch.
+        void* texturePixels = nullptr;
+        if (SDL_LockTexture(texture, &lockedRect, &texturePixels, &pitch) == 0) {
+            pixels = static_cast<uint32_t*>(texturePixels);
+            textureLocked = true;
+            return true;
+        }
+        std::cerr << "SDLRenderBackend: SDL_LockTexture failed (" << SDL_GetError()
+                  << "), falling back to SDL_UpdateTexture." << std::endl;
+        zeroCopy = false;
+    }
+
+    // Fallback: rows are written into our own staging buffer and copied by UnlockRows().
+    if (pixelBuffer.empty()) {
+        pixelBuffer.resize(static_cast<size_t>(width) * height, 0);
+    }
+    pixels = &pixelBuffer[static_cast<size_t>(y0) * width];
+    pitch = width * static_cast<int>(sizeof(uint32_t));
+    textureLocked = false;
+    return true;
+}
+
+void SDLRenderBackend::UnlockRows() {
+    if (textureLocked) {
+        SDL_UnlockTexture(texture);
+        textureLocked = false;
+    } else {
+        const size_t offset = static_cast<size_t>(lockedRect.y) * width;
+        SDL_UpdateTexture(texture, &lockedRect, &pixelBuffer[offset], width * static_cast<int>(sizeof(uint32_t)));
+    }
+}
+
+bool SDLRenderBackend::Resize(int newWidth, int newHeight) {
+    SDL_Texture* resized = SDL_CreateTexture(renderer, textureFormat->format, SDL_TEXTUREACCESS_STREAMING, newWidth, newHeight);
+    if (!resized) {
+        std::cerr << "SDLRenderBackend: Could not create a " << newWidth << "x" << newHeight << " texture ("
+                  << SDL_GetError() << ")." << std::endl;
+        return false;
+    }
+    SDL_DestroyTexture(texture);
+    texture = resized;
+    width = newWidth;
+    height = newHeight;
+    pixelBuffer.clear(); // Reallocated at the new size by the next fallback upload.
+    // Keep letterboxing the whole image at the new aspect ratio.
+    SDL_RenderSetLogicalSize(renderer, width, height);
+    return true;
+}
+
+void SDLRenderBackend::Show() {
+    // Clear the renderer.
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255); // Black background for the letterbox bars
+    SDL_RenderClear(renderer);
+
+    // Copy the texture to the renderer, scaling it to fit the window while maintaining aspect ratio.
+    SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+
+    // Show the result on the screen.
+    SDL_RenderPresent(renderer);
+}
@@ -0,0 +1,40 @@
+#ifndef SDL_RENDER_BACKEND_H
+#define SDL_RENDER_BACKEND_H
+
+#include "rendering/RenderBackend.h"
+#include <vector>
+
+/// @class SDLRenderBackend
+/// @brief Presents the output image through a streaming SDL texture stretched over the window.
+class SDLRenderBackend : public RenderBackend {
+public:
+    SDLRenderBackend(SDL_Renderer* renderer, int width, int height);
+    ~SDLRenderBackend() override;
+
+    uint32_t MapColor(const SDL_Color& color) const override;
+    bool LockRows(int y0, int y1, uint32_t*& pixels, int& pitch) override;
+    void UnlockRows() override;
+    void Show() override;
+    bool Resize(int newWidth, int newHeight) override;
+    const char* GetName() const override { return "SDL"; }
+
+    // Selects between writing straight into locked texture memory (default) and
+    // writing into a staging buffer that is copied with SDL_UpdateTexture.
+    void SetZeroCopy(bool enabled) { zeroCopy = enabled; }
+
+private:
+    // Picks the renderer's preferred packed 32-bit texture format, or ARGB8888 if none is reported.
+    static Uint32 SelectTextureFormat(SDL_Renderer* renderer);
+
+    SDL_Renderer* renderer;
+    SDL_Texture* texture = nullptr;
+    SDL_PixelFormat* textureFormat = nullptr; // Kept across Resize(), so mapped colors stay valid.
+    int width;
+    int height;
+    bool zeroCopy = true;              // Write directly into SDL_LockTexture memory.
+    bool textureLocked = false;        // The rows handed out by LockRows() are texture memory.
+    SDL_Rect lockedRect{};
+    std::vector<uint32_t> pixelBuffer; // Staging buffer for the SDL_UpdateTexture fallback path.
+};
+
+#endif // SDL_RENDER_BACKEND_H
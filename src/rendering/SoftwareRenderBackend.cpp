@@ -0,0 +1,27 @@
+#include "rendering/SoftwareRenderBackend.h"
+
+SoftwareRenderBackend::SoftwareRenderBackend(int width, int height)
+    : width(width), height(height), pixels(static_cast<size_t>(width) * height, 0xFF000000u) {
+}
+
+uint32_t SoftwareRenderBackend::MapColor(const SDL_Color& color) const {
+    // ARGB8888 format
+    return (static_cast<uint32_t>(color.a) << 24) | (static_cast<uint32_t>(color.r) << 16) |
+           (static_cast<uint32_t>(color.g) << 8) | color.b;
+}
+
+bool SoftwareRenderBackend::Resize(int newWidth, int newHeight) {
+    width = newWidth;
+    height = newHeight;
+    pixels.assign(static_cast<size_t>(width) * height, 0xFF000000u);
+    return true;
+}
+
+bool SoftwareRenderBackend::LockRows(int y0, int y1, uint32_t*& rows, int& pitch) {
+    if (y0 < 0 || y1 > height || y0 >= y1) {
+        return false;
+    }
+    rows = &pixels[static_cast<size_t>(y0) * width];
+    pitch = width * static_cast<int>(sizeof(uint32_t));
+    return true;
+}
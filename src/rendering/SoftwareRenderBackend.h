@@ -0,0 +1,36 @@
+#ifndef SOFTWARE_RENDER_BACKEND_H
+#define SOFTWARE_RENDER_BACKEND_H
+
+#include "rendering/RenderBackend.h"
+#include <vector>
+
+/// @class SoftwareRenderBackend
+/// @brief Keeps the output image in memory as ARGB8888 words. Needs no display or SDL
+/// renderer, so headless engines (tests, benchmarks, CI) can run the full raster pipeline.
+class SoftwareRenderBackend : public RenderBackend {
+public:
+    SoftwareRenderBackend(int width, int height);
+
+    uint32_t MapColor(const SDL_Color& color) const override;
+    bool LockRows(int y0, int y1, uint32_t*& pixels, int& pitch) override;
+    void UnlockRows() override {}
+    void Show() override { ++presentedFrames; }
+    bool Resize(int newWidth, int newHeight) override;
+    const char* GetName() const override { return "software"; }
+
+    // The ARGB8888 output image, row-major with no padding.
+    const std::vector<uint32_t>& GetPixels() const { return pixels; }
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+
+    // Number of frames shown so far.
+    uint64_t GetPresentedFrameCount() const { return presentedFrames; }
+
+private:
+    int width;
+    int height;
+    std::vector<uint32_t> pixels;
+    uint64_t presentedFrames = 0;
+};
+
+#endif // SOFTWARE_RENDER_BACKEND_H
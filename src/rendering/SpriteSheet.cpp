@@ -0,0 +1,85 @@
+#include "rendering/SpriteSheet.h"
+#include <SDL.h>
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+
+SpriteSheet::SpriteSheet(int width, int height, std::vector<uint8_t> pixels)
+    : width(width), height(height), cellColumns((width + SPRITE_SIZE - 1) / SPRITE_SIZE), pixels(std::move(pixels)) {
+    if (width <= 0 || height <= 0 || this->pixels.size() != static_cast<size_t>(width) * height) {
+        throw std::invalid_argument("SpriteSheet dimensions do not match its pixel data.");
+    }
+}
+
+std::unique_ptr<SpriteSheet> SpriteSheet::loadFromBMP(const std::string& path) {
+    SDL_Surface* surface = SDL_LoadBMP(path.c_str());
+    if (!surface) {
+        return nullptr;
+    }
+    if (surface->format->BitsPerPixel != 8 || !surface->format->palette) {
+        std::cerr << "SpriteSheet Error: " << path << " is not an 8-bit palettized BMP." << std::endl;
+        SDL_FreeSurface(surface);
+        return nullptr;
+    }
+
+    // Copy the indices row by row, dropping the surface's row padding.
+    std::vector<uint8_t> indices(static_cast<size_t>(surface->w) * surface->h);
+    SDL_LockSurface(surface);
+    for (int y = 0; y < surface->h; ++y) {
+        std::memcpy(&indices[static_cast<size_t>(y) * surface->w],
+                    static_cast<const uint8_t*>(surface->pixels) + static_cast<size_t>(y) * surface->pitch, surface->w);
+    }
+    SDL_UnlockSurface(surface);
+
+    auto sheet = std::make_unique<SpriteSheet>(surface->w, surface->h, std::move(indices));
+    SDL_FreeSurface(surface);
+    return sheet;
+}
+
+uint8_t SpriteSheet::GetPixel(int x, int y) const {
+    if (x < 0 || x >= width || y < 0 || y >= height) {
+        return 0;
+    }
+    return pixels[y * width + x];
+}
+
+void SpriteSheet::SetPixel(int x, int y, uint8_t colorIndex) {
+    if (x < 0 || x >= width || y < 0 || y >= height) {
+        return;
+    }
+    pixels[y * width + x] = colorIndex;
+    runsValid = false;
+    ++version;
+}
+
+void SpriteSheet::PrepareRuns(const TransparencyMask& transparency) const {
+    if (runsValid && runsTransparency == transparency) {
+        return;
+    }
+
+    runs.clear();
+    cellRunIndex.resize(static_cast<size_t>(height) * (cellColumns + 1));
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* row = &pixels[y * width];
+        for (int cell = 0; cell < cellColumns; ++cell) {
+            cellRunIndex[y * (cellColumns + 1) + cell] = static_cast<uint32_t>(runs.size());
+            const int cellEnd = std::min(width, (cell + 1) * SPRITE_SIZE);
+            int x = cell * SPRITE_SIZE;
+            while (x < cellEnd) {
+                if (transparency.Test(row[x])) {
+                    ++x;
+                    continue;
+                }
+                int start = x;
+                while (x < cellEnd && !transparency.Test(row[x])) {
+                    ++x;
+                }
+                runs.push_back(Run{static_cast<uint16_t>(start), static_cast<uint16_t>(x - start)});
+            }
+        }
+        cellRunIndex[y * (cellColumns + 1) + cellColumns] = static_cast<uint32_t>(runs.size());
+    }
+    runsValid = true;
+    runsTransparency = transparency;
+}
@@ -0,0 +1,77 @@
+#ifndef SPRITE_SHEET_H
+#define SPRITE_SHEET_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include "rendering/TransparencyMask.h"
+
+/// @class SpriteSheet
+/// @brief An 8bpp indexed atlas of 8x8 sprites, plus a cached encoding of its opaque pixels.
+///
+/// Every sheet row is split into horizontal runs of non-transparent pixels. Runs never cross
+/// an 8-pixel cell boundary, so the runs of any sprite (or any sub-rectangle) can be found
+/// directly from a per-cell index. Blits copy whole runs and never test individual pixels.
+class SpriteSheet {
+public:
+    static constexpr int SPRITE_SIZE = 8;
+
+    /// @brief A horizontal run of opaque pixels on one sheet row.
+    struct Run {
+        uint16_t x;      ///< First pixel of the run, in sheet coordinates.
+        uint16_t length; ///< Number of pixels.
+    };
+
+    SpriteSheet(int width, int height, std::vector<uint8_t> pixels);
+
+    /**
+     * @brief Loads a sheet from an 8-bit palettized BMP file.
+     * The BMP's palette indices are used directly as console color indices.
+     * @return The sheet, or nullptr if the file is missing or not an 8-bit indexed image.
+     */
+    static std::unique_ptr<SpriteSheet> loadFromBMP(const std::string& path);
+
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+    // Number of 8x8 cells per sheet row; sprite n lives in cell (n % columns, n / columns).
+    int GetColumns() const { return cellColumns; }
+    const std::vector<uint8_t>& GetPixels() const { return pixels; }
+
+    /// @brief Returns the color index at (x, y), or 0 outside the sheet.
+    uint8_t GetPixel(int x, int y) const;
+
+    /// @brief Writes a color index at (x, y) and invalidates the run encoding.
+    void SetPixel(int x, int y, uint8_t colorIndex);
+
+    /// @brief Incremented on every pixel change, so caches built from the sheet can detect staleness.
+    uint64_t GetVersion() const { return version; }
+
+    /**
+     * @brief Makes sure the run encoding matches the given set of transparent colors.
+     * The encoding is rebuilt only when the transparent colors or the pixels changed.
+     */
+    void PrepareRuns(const TransparencyMask& transparency) const;
+
+    /**
+     * @brief Returns the runs of sheet row `y` that lie in cell column `cell`.
+     * PrepareRuns() must have been called first.
+     */
+    const Run* CellRunsBegin(int y, int cell) const { return runs.data() + cellRunIndex[y * (cellColumns + 1) + cell]; }
+    const Run* CellRunsEnd(int y, int cell) const { return runs.data() + cellRunIndex[y * (cellColumns + 1) + cell + 1]; }
+
+private:
+    int width;
+    int height;
+    int cellColumns;
+    std::vector<uint8_t> pixels;
+    uint64_t version = 0;
+
+    // Run encoding, rebuilt lazily for the transparency state it was built for.
+    mutable std::vector<Run> runs;
+    mutable std::vector<uint32_t> cellRunIndex; // (cellColumns + 1) entries per row: first run of each cell.
+    mutable bool runsValid = false;
+    mutable TransparencyMask runsTransparency;
+};
+
+#endif // SPRITE_SHEET_H
@@ -0,0 +1,22 @@
+#ifndef SURFACE_H
+#define SURFACE_H
+
+#include <cstdint>
+#include <vector>
+
+/// @struct Surface
+/// @brief A color-indexed pixel buffer that drawing can target and blits can read.
+///
+/// Surface 0 of an AestheticLayer is a view of the screen framebuffer; the others are
+/// offscreen surfaces allocated by carts, which own their pixels.
+struct Surface {
+    int width = 0;
+    int height = 0;
+    uint8_t* pixels = nullptr;    // Row-major, Stride() bytes per row.
+    std::vector<uint8_t> storage; // Backs `pixels` for offscreen surfaces; empty for the screen view.
+    bool packed = false;          // Two pixels per byte, the left one in the low nibble.
+
+    int Stride() const { return packed ? (width + 1) / 2 : width; }
+};
+
+#endif // SURFACE_H
@@ -0,0 +1,98 @@
+#include "rendering/TileRasterizer.h"
+#include "rendering/DisplayList.h"
+#include <algorithm>
+
+TileRasterizer::TileRasterizer(int threadCount) {
+    for (int i = 1; i < threadCount; ++i) {
+        workers.emplace_back(&TileRasterizer::WorkerLoop, this);
+    }
+}
+
+TileRasterizer::~TileRasterizer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    startCondition.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void TileRasterizer::Execute(const DisplayList& list, size_t first, size_t last, Rasterizer& target) {
+    // Bin the commands by the tiles their rows overlap. State changes span every tile, so each
+    // tile tracks the camera and transparency exactly as the serial pass would.
+    tileCount = (target.GetHeight() + TILE_ROWS - 1) / TILE_ROWS;
+    bins.resize(tileCount);
+    for (auto& bin : bins) {
+        bin.clear(); // Keeps its capacity from earlier frames.
+    }
+    for (size_t i = first; i < last; ++i) {
+        const int lastTile = std::min(list.GetCommandBottom(i) / TILE_ROWS, tileCount - 1);
+        for (int tile = list.GetCommandTop(i) / TILE_ROWS; tile <= lastTile; ++tile) {
+            bins[tile].push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    tileRasters.clear();
+    for (int tile = 0; tile < tileCount; ++tile) {
+        tileRasters.push_back(target);
+        tileRasters.back().ResetDamage();
+        tileRasters.back().SetBand(tile * TILE_ROWS, (tile + 1) * TILE_ROWS);
+    }
+
+    // Wake the workers and rasterize tiles alongside them.
+    jobList = &list;
+    nextTile = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++generation;
+        busyWorkers = static_cast<int>(workers.size());
+    }
+    startCondition.notify_all();
+    RunTiles();
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        doneCondition.wait(lock, [this] { return busyWorkers == 0; });
+    }
+
+    // Every tile ends in the same drawing state; merge the damage of all of them.
+    for (const Rasterizer& tileRaster : tileRasters) {
+        if (tileRaster.GetDirtyMinY() <= tileRaster.GetDirtyMaxY()) {
+            target.MarkDirtyRows(tileRaster.GetDirtyMinY(), tileRaster.GetDirtyMaxY());
+        }
+    }
+    target.SetDrawState(tileRasters.front().GetDrawState());
+}
+
+void TileRasterizer::RunTiles() {
+    for (int tile = nextTile.fetch_add(1); tile < tileCount; tile = nextTile.fetch_add(1)) {
+        Rasterizer& raster = tileRasters[tile];
+        for (uint32_t index : bins[tile]) {
+            jobList->ExecuteCommand(raster, index);
+        }
+    }
+}
+
+void TileRasterizer::WorkerLoop() {
+    uint64_t seenGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            startCondition.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping) {
+                return;
+            }
+            seenGeneration = generation;
+        }
+
+        RunTiles();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busyWorkers == 0) {
+                doneCondition.notify_one();
+            }
+        }
+    }
+}
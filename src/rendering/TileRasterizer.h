@@ -0,0 +1,65 @@
+#ifndef TILE_RASTERIZER_H
+#define TILE_RASTERIZER_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "rendering/Rasterizer.h"
+
+class DisplayList; // Forward declaration
+
+/// @class TileRasterizer
+/// @brief Executes display lists on several threads by splitting the screen into tiles.
+///
+/// Tiles are full-width strips of TILE_ROWS rows, because every kernel writes row spans.
+/// Commands are binned by the rows they cover; each tile then replays its bin, in recording
+/// order, on a copy of the target rasterizer clipped to the tile. Every pixel therefore sees
+/// the same sequence of writes as in serial execution, and tiles never share a pixel.
+class TileRasterizer {
+public:
+    static constexpr int TILE_ROWS = 16;
+
+    // Below this many commands, dispatching to the workers costs more than it saves.
+    static constexpr size_t MIN_PARALLEL_COMMANDS = 64;
+
+    // Starts threadCount - 1 workers; the calling thread takes part in every Execute().
+    explicit TileRasterizer(int threadCount);
+    ~TileRasterizer();
+
+    TileRasterizer(const TileRasterizer&) = delete;
+    TileRasterizer& operator=(const TileRasterizer&) = delete;
+
+    int GetThreadCount() const { return static_cast<int>(workers.size()) + 1; }
+
+    // Executes commands [first, last) of the list on the target's pixels. On return the target
+    // holds the drawing state left by the last command and the union of the tiles' damage.
+    void Execute(const DisplayList& list, size_t first, size_t last, Rasterizer& target);
+
+private:
+    // Rasterizes tiles taken from nextTile until none are left.
+    void RunTiles();
+
+    // Body of each worker thread.
+    void WorkerLoop();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable startCondition;
+    std::condition_variable doneCondition;
+    uint64_t generation = 0;  // Guarded by mutex. Incremented for every job.
+    int busyWorkers = 0;      // Guarded by mutex.
+    bool stopping = false;    // Guarded by mutex.
+
+    // The current job. Written by Execute() before the workers are woken.
+    const DisplayList* jobList = nullptr;
+    int tileCount = 0;
+    std::vector<std::vector<uint32_t>> bins;  // Command indices per tile, in recording order.
+    std::vector<Rasterizer> tileRasters;     // Per tile, the rasterizer state after its bin.
+    std::atomic<int> nextTile{0};
+};
+
+#endif // TILE_RASTERIZER_H
@@ -0,0 +1,32 @@
+#ifndef TRANSPARENCY_MASK_H
+#define TRANSPARENCY_MASK_H
+
+#include <array>
+#include <cstdint>
+#include <optional>
+
+/// @struct TransparencyMask
+/// @brief The set of transparent color indices, one bit per index (256 bits).
+struct TransparencyMask {
+    std::array<uint64_t, 4> bits{};
+
+    bool Test(uint8_t colorIndex) const { return (bits[colorIndex >> 6] >> (colorIndex & 63)) & 1; }
+
+    void Set(uint8_t colorIndex, bool transparent) {
+        const uint64_t bit = uint64_t{1} << (colorIndex & 63);
+        bits[colorIndex >> 6] = transparent ? (bits[colorIndex >> 6] | bit) : (bits[colorIndex >> 6] & ~bit);
+    }
+
+    bool Any() const { return (bits[0] | bits[1] | bits[2] | bits[3]) != 0; }
+
+    // A mask with only `colorIndex` set, or an empty mask for std::nullopt.
+    static TransparencyMask FromColor(std::optional<uint8_t> colorIndex) {
+        TransparencyMask mask;
+        if (colorIndex) mask.Set(*colorIndex, true);
+        return mask;
+    }
+
+    bool operator==(const TransparencyMask& other) const = default;
+};
+
+#endif // TRANSPARENCY_MASK_H
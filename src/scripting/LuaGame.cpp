@@ -10,10 +10,15 @@ LuaGame::LuaGame(std::unique_ptr<Cartridge> cart, std::unique_ptr<ScriptingManag
     if (!scriptingManager) {
         throw std::runtime_error("ScriptingManager provided to LuaGame is null.");
     }
+    // Carts can opt into recording _draw into a display list that is executed in one pass.
+    scriptingManager->SetDisplayListEnabled(cartridge->config.value("/config/display_list"_json_pointer, false));
+}
+
+bool LuaGame::_init() {
     // The ScriptingManager is already initialized and has loaded the script.
     // Now, call the script's _init function to perform one-time setup.
     std::cout << "LuaGame: Calling _init() on loaded script." << std::endl;
-    scriptingManager->CallLuaFunction("_init");
+    return scriptingManager->CallLuaFunction("_init");
 }
 
 bool LuaGame::_update() {
@@ -22,12 +27,20 @@ bool LuaGame::_update() {
 }
 
 void LuaGame::_draw(AestheticLayer& aestheticLayer) {
-    // The aestheticLayer is implicitly available to Lua functions via the upvalue.
-    (void)aestheticLayer; // Mark as unused to prevent compiler warnings.
+    // Draw calls reach the layer through the engine; the layer is needed here to execute
+    // or replay a recorded display list.
     if (!scriptingManager) return;
-    scriptingManager->CallLuaFunction("_draw");
+    scriptingManager->CallDrawFunction(aestheticLayer);
 }
 
 const nlohmann::json& LuaGame::getConfig() const {
     return cartridge->config;
+}
+
+const std::shared_ptr<SpriteSheet>& LuaGame::getSpriteSheet() const {
+    return cartridge->spriteSheet;
+}
+
+const std::shared_ptr<Tilemap>& LuaGame::getTilemap() const {
+    return cartridge->tilemap;
 }
\ No newline at end of file
@@ -18,10 +18,15 @@ public:
     explicit LuaGame(std::unique_ptr<Cartridge> cart, std::unique_ptr<ScriptingManager> manager);
     ~LuaGame() override = default;
 
+    // Calls the script's _init. The engine does this on the main thread once the cartridge's
+    // settings, sprite sheet and map are in place. Returns false on a Lua error.
+    bool _init();
     bool _update() override;
     void _draw(AestheticLayer& aestheticLayer) override;
 
     const nlohmann::json& getConfig() const;
+    const std::shared_ptr<SpriteSheet>& getSpriteSheet() const;
+    const std::shared_ptr<Tilemap>& getTilemap() const;
 
 private:
     std::unique_ptr<Cartridge> cartridge;
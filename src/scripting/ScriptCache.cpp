@@ -0,0 +1,175 @@
+#include "scripting/ScriptCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <lua.h>
+}
+
+namespace {
+
+constexpr char MAGIC[8] = {'U', 'L', 'I', 'C', 'S', 'L', 'U', 'C'};
+constexpr uint32_t FORMAT_VERSION = 1;
+
+void PutU32(std::string& out, uint32_t value) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        out.push_back(static_cast<char>((value >> shift) & 0xFF));
+    }
+}
+
+void PutU64(std::string& out, uint64_t value) {
+    for (int shift = 0; shift < 64; shift += 8) {
+        out.push_back(static_cast<char>((value >> shift) & 0xFF));
+    }
+}
+
+// Reads little-endian fields from a buffer; any read past its end fails the whole parse.
+class Reader {
+public:
+    explicit Reader(std::string_view data) : data(data) {}
+
+    bool Bytes(size_t count, std::string_view& out) {
+        if (data.size() - offset < count) return false;
+        out = data.substr(offset, count);
+        offset += count;
+        return true;
+    }
+
+    bool U32(uint32_t& value) {
+        std::string_view bytes;
+        if (!Bytes(4, bytes)) return false;
+        value = 0;
+        for (int i = 3; i >= 0; --i) value = (value << 8) | static_cast<uint8_t>(bytes[i]);
+        return true;
+    }
+
+    bool U64(uint64_t& value) {
+        std::string_view bytes;
+        if (!Bytes(8, bytes)) return false;
+        value = 0;
+        for (int i = 7; i >= 0; --i) value = (value << 8) | static_cast<uint8_t>(bytes[i]);
+        return true;
+    }
+
+    size_t Remaining() const { return data.size() - offset; }
+
+private:
+    std::string_view data;
+    size_t offset = 0;
+};
+
+} // namespace
+
+ScriptCache::ScriptCache(std::string cacheDirectory) : directory(std::move(cacheDirectory)) {
+}
+
+uint64_t ScriptCache::Hash(std::string_view data) {
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : data) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string ScriptCache::EntryPath(uint64_t sourceHash) const {
+    char name[40];
+    std::snprintf(name, sizeof(name), "%016llx_%d.luac", static_cast<unsigned long long>(sourceHash),
+                  static_cast<int>(LUA_VERSION_NUM));
+    return (std::filesystem::path(directory) / name).string();
+}
+
+bool ScriptCache::Load(std::string_view source, Entry& entry) const {
+    const uint64_t sourceHash = Hash(source);
+    const std::string path = EntryPath(sourceHash);
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    const std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    Reader reader(contents);
+    std::string_view magic, release, bytecode;
+    uint32_t version = 0, releaseSize = 0;
+    uint64_t sourceSize = 0, storedHash = 0, lineCount = 0, bytecodeSize = 0, bytecodeHash = 0;
+    if (!reader.Bytes(sizeof(MAGIC), magic) || magic != std::string_view(MAGIC, sizeof(MAGIC)) ||
+        !reader.U32(version) || version != FORMAT_VERSION ||
+        !reader.U32(releaseSize) || !reader.Bytes(releaseSize, release) || release != LUA_VERSION_RELEASE ||
+        !reader.U64(sourceSize) || sourceSize != source.size() ||
+        !reader.U64(storedHash) || storedHash != sourceHash ||
+        !reader.U64(lineCount) || !reader.U64(bytecodeSize) || !reader.U64(bytecodeHash) ||
+        reader.Remaining() != bytecodeSize || !reader.Bytes(bytecodeSize, bytecode) ||
+        Hash(bytecode) != bytecodeHash) {
+        return false;
+    }
+
+    entry.lineCount = static_cast<size_t>(lineCount);
+    entry.bytecode.assign(bytecode);
+
+    // Hits refresh the entry's time, which Prune() uses to find the least recently used.
+    std::error_code error;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+    return true;
+}
+
+void ScriptCache::Store(std::string_view source, const Entry& entry) const {
+    const uint64_t sourceHash = Hash(source);
+    std::string contents(MAGIC, sizeof(MAGIC));
+    PutU32(contents, FORMAT_VERSION);
+    const std::string_view release = LUA_VERSION_RELEASE;
+    PutU32(contents, static_cast<uint32_t>(release.size()));
+    contents.append(release);
+    PutU64(contents, source.size());
+    PutU64(contents, sourceHash);
+    PutU64(contents, entry.lineCount);
+    PutU64(contents, entry.bytecode.size());
+    PutU64(contents, Hash(entry.bytecode));
+    contents.append(entry.bytecode);
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    const std::string path = EntryPath(sourceHash);
+    // Loads on other threads may store the same entry, so each writes its own temporary file.
+    std::ostringstream tempPath;
+    tempPath << path << '.' << std::this_thread::get_id() << ".tmp";
+    {
+        std::ofstream file(tempPath.str(), std::ios::binary | std::ios::trunc);
+        file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+        if (!file) {
+            std::cerr << "ScriptCache: Could not write " << tempPath.str() << "." << std::endl;
+            file.close();
+            std::filesystem::remove(tempPath.str(), error);
+            return;
+        }
+    }
+    std::filesystem::rename(tempPath.str(), path, error);
+    if (error) {
+        std::cerr << "ScriptCache: Could not store " << path << ": " << error.message() << std::endl;
+        std::filesystem::remove(tempPath.str(), error);
+        return;
+    }
+    Prune();
+}
+
+void ScriptCache::Prune() const {
+    std::error_code error;
+    std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> entries;
+    for (const auto& item : std::filesystem::directory_iterator(directory, error)) {
+        if (item.path().extension() == ".luac") {
+            entries.emplace_back(item.last_write_time(error), item.path());
+        }
+    }
+    if (entries.size() <= MAX_ENTRIES) {
+        return;
+    }
+    std::sort(entries.begin(), entries.end());
+    for (size_t i = 0; i < entries.size() - MAX_ENTRIES; ++i) {
+        std::filesystem::remove(entries[i].second, error);
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef SCRIPT_CACHE_H
+#define SCRIPT_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/// @class ScriptCache
+/// @brief Stores compiled Lua chunks on disk, keyed by a hash of their source.
+///
+/// Each entry is one file named after the 64-bit FNV-1a hash of the source and the Lua
+/// version number, e.g. "0123456789abcdef_504.luac". It holds a header (magic "ULICSLUC",
+/// format version, LUA_VERSION_RELEASE, source size and hash, line count, bytecode size and
+/// hash) followed by the output of lua_dump. An entry is only returned if all of these match,
+/// so an edited script, another Lua build or a truncated file reads as a miss.
+///
+/// Entries are written to a temporary file and renamed into place, so a crash or a concurrent
+/// load never leaves a partial entry behind. At most MAX_ENTRIES are kept; storing a new one
+/// removes the least recently used.
+class ScriptCache {
+public:
+    // What is kept for one script: its line count and its chunk as written by lua_dump.
+    struct Entry {
+        size_t lineCount = 0;
+        std::string bytecode;
+    };
+
+    static constexpr size_t MAX_ENTRIES = 64;
+
+    // The cache lives in `directory`, which is created when the first entry is stored.
+    explicit ScriptCache(std::string directory);
+
+    // Looks up the entry for `source`. Returns false if there is none or it does not match.
+    bool Load(std::string_view source, Entry& entry) const;
+
+    // Stores the entry for `source`. Failures are logged and otherwise ignored.
+    void Store(std::string_view source, const Entry& entry) const;
+
+    const std::string& GetDirectory() const { return directory; }
+
+    // 64-bit FNV-1a hash of `data`.
+    static uint64_t Hash(std::string_view data);
+
+private:
+    // Path of the entry file for a source hash.
+    std::string EntryPath(uint64_t sourceHash) const;
+
+    // Removes the least recently used entries beyond MAX_ENTRIES.
+    void Prune() const;
+
+    std::string directory;
+};
+
+#endif // SCRIPT_CACHE_H
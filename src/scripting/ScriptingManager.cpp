@@ -1,4 +1,5 @@
 #include "scripting/ScriptingManager.h"
+#include "scripting/ScriptCache.h"
 #include "rendering/AestheticLayer.h"
 #include "input/InputManager.h"
 #include "cartridge/CartridgeLoader.h" // Include the necessary header
@@ -7,6 +8,12 @@
 #include <string>
 #include <array>
 #include <cmath> 
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+#include <string_view>
 
 constexpr double PI = 3.14159265358979323846;
 
@@ -15,6 +22,8 @@ ScriptingManager::ScriptingManager(Engine* engine)
     // 1. Create a new Lua state.
     L = luaL_newstate();
     if (L) {
+        formatBuffer.reserve(256);
+
         // Seed the random number generator.
         std::random_device rd;
         rng.seed(rd());
@@ -35,26 +44,63 @@ ScriptingManager::~ScriptingManager() {
     }
 }
 
+namespace {
+
+// lua_Writer that appends the dumped chunk to a std::string.
+int WriteChunk(lua_State*, const void* data, size_t size, void* userData) {
+    static_cast<std::string*>(userData)->append(static_cast<const char*>(data), size);
+    return 0;
+}
+
+} // namespace
+
 // Loads and runs a Lua script from the given filepath.
 bool ScriptingManager::LoadAndRunScript(const char* scriptBuffer, size_t line_limit) {
-    // --- Soft Constraint Check: Line Count ---
-    size_t line_count = 0;
-    if (scriptBuffer && *scriptBuffer) {
-        line_count = 1; // Start with 1 line.
-        for (const char* p = scriptBuffer; *p != '\0'; ++p) {
-            if (*p == '\n') {
-                line_count++;
-            }
-        }
+    const std::string_view source = scriptBuffer ? scriptBuffer : "";
+
+    // Compiled chunks are cached under the user data path, keyed by the script's hash, so
+    // unchanged carts skip the parser and the line count on later loads.
+    std::unique_ptr<ScriptCache> cache;
+    if (engineInstance && !engineInstance->getUserDataPath().empty()) {
+        cache = std::make_unique<ScriptCache>(
+            (std::filesystem::path(engineInstance->getUserDataPath()) / "cache" / "lua").string());
     }
+    ScriptCache::Entry entry;
+    bool cached = cache && cache->Load(source, entry);
 
-    if (line_limit > 0 && line_count > line_limit) {
-        std::cout << "ScriptingManager Warning: Script line count (" << line_count
+    // --- Soft Constraint Check: Line Count ---
+    if (!cached) {
+        entry.lineCount = source.empty() ? 0 : static_cast<size_t>(std::count(source.begin(), source.end(), '\n')) + 1;
+    }
+    if (line_limit > 0 && entry.lineCount > line_limit) {
+        std::cout << "ScriptingManager Warning: Script line count (" << entry.lineCount
                   << ") exceeds cartridge limit (" << line_limit << ")." << std::endl;
     }
 
-    // luaL_dostring loads and runs a script from a string.
-    if (luaL_dostring(L, scriptBuffer) != LUA_OK) {
+    // The chunk is named after its source, as luaL_dostring does, so error messages read the same
+    // whether it was compiled now or loaded from the cache.
+    if (cached && luaL_loadbufferx(L, entry.bytecode.data(), entry.bytecode.size(), source.data(), "b") != LUA_OK) {
+        std::cerr << "ScriptingManager: Ignoring cached chunk: " << lua_tostring(L, -1) << std::endl;
+        lua_pop(L, 1);
+        cached = false;
+    }
+    if (!cached) {
+        if (luaL_loadbuffer(L, source.data(), source.size(), source.data()) != LUA_OK) {
+            lastError = lua_tostring(L, -1);
+            std::cerr << "Error running script: " << lastError << std::endl;
+            lua_pop(L, 1); // Pop the error message from the stack.
+            return false;
+        }
+        if (cache) {
+            // Debug information is kept, so runtime errors still report line numbers.
+            entry.bytecode.clear();
+            if (lua_dump(L, WriteChunk, &entry.bytecode, 0) == 0) {
+                cache->Store(source, entry);
+            }
+        }
+    }
+
+    if (lua_pcall(L, 0, LUA_MULTRET, 0) != LUA_OK) {
         // If there was an error, it's on top of the stack.
         lastError = lua_tostring(L, -1);
         std::cerr << "Error running script: " << lastError << std::endl;
@@ -72,13 +118,39 @@ void ScriptingManager::RegisterAPI() {
     RegisterFunction("rectfill", &ScriptingManager::Lua_RectFill);
     RegisterFunction("circ", &ScriptingManager::Lua_Circ);
     RegisterFunction("circfill", &ScriptingManager::Lua_CircFill);
+    RegisterFunction("trifill", &ScriptingManager::Lua_TriFill);
+    RegisterFunction("polyfill", &ScriptingManager::Lua_PolyFill);
+    RegisterFunction("fill", &ScriptingManager::Lua_Fill);
     RegisterFunction("pget", &ScriptingManager::Lua_Pget);
     RegisterFunction("btn", &ScriptingManager::Lua_Btn);
     RegisterFunction("btnp", &ScriptingManager::Lua_Btnp);
     RegisterFunction("print", &ScriptingManager::Lua_Print);
+    RegisterFunction("printf", &ScriptingManager::Lua_Printf);
+    RegisterFunction("spr", &ScriptingManager::Lua_Spr);
+    RegisterFunction("sspr", &ScriptingManager::Lua_Sspr);
+    RegisterFunction("rspr", &ScriptingManager::Lua_Rspr);
+    RegisterFunction("fade", &ScriptingManager::Lua_Fade);
+    RegisterFunction("pcycle", &ScriptingManager::Lua_PCycle);
+    RegisterFunction("mosaic", &ScriptingManager::Lua_Mosaic);
+    RegisterFunction("wobble", &ScriptingManager::Lua_Wobble);
+    RegisterFunction("dissolve", &ScriptingManager::Lua_Dissolve);
+    RegisterFunction("mget", &ScriptingManager::Lua_Mget);
+    RegisterFunction("mset", &ScriptingManager::Lua_Mset);
+    RegisterFunction("map", &ScriptingManager::Lua_Map);
+    RegisterFunction("reuseframe", &ScriptingManager::Lua_ReuseFrame);
     RegisterFunction("time", &ScriptingManager::Lua_Time);
     RegisterFunction("camera", &ScriptingManager::Lua_Camera);
+    RegisterFunction("clip", &ScriptingManager::Lua_Clip);
     RegisterFunction("tcolor", &ScriptingManager::Lua_TColor);
+    RegisterFunction("pal", &ScriptingManager::Lua_Pal);
+    RegisterFunction("palt", &ScriptingManager::Lua_Palt);
+    RegisterFunction("fillp", &ScriptingManager::Lua_Fillp);
+    RegisterFunction("spal", &ScriptingManager::Lua_Spal);
+    RegisterFunction("spalrows", &ScriptingManager::Lua_SpalRows);
+    RegisterFunction("surface", &ScriptingManager::Lua_Surface);
+    RegisterFunction("freesurface", &ScriptingManager::Lua_FreeSurface);
+    RegisterFunction("target", &ScriptingManager::Lua_Target);
+    RegisterFunction("blit", &ScriptingManager::Lua_Blit);
     RegisterFunction("listcarts", &ScriptingManager::Lua_ListCarts);
     RegisterFunction("loadcart", &ScriptingManager::Lua_LoadCart);
 
@@ -110,8 +182,12 @@ int ScriptingManager::Lua_Clear(lua_State* L) {
     // 2. Get the argument (the color) from the Lua stack.
     int colorIndex = luaL_checkinteger(L, 1);
 
-    // 3. Call the actual C++ function.
-    layer->Clear(colorIndex);
+    // 3. Call the actual C++ function, or record the call while _draw is being recorded.
+    if (sm->recorder) {
+        sm->recorder->Clear(colorIndex);
+    } else {
+        layer->Clear(colorIndex);
+    }
 
     // 4. Return the number of values our function returns to Lua (in this case, none).
     return 0;
@@ -126,8 +202,12 @@ int ScriptingManager::Lua_Pset(lua_State* L) {
     int y = luaL_checkinteger(L, 2);
     int colorIndex = luaL_checkinteger(L, 3);
 
-    // 3. Call the actual C++ function.
-    layer->SetPixel(x, y, colorIndex);
+    // 3. Call the actual C++ function, or record the call while _draw is being recorded.
+    if (sm->recorder) {
+        sm->recorder->SetPixel(x, y, colorIndex);
+    } else {
+        layer->SetPixel(x, y, colorIndex);
+    }
 
     // 4. This function returns no values to Lua.
     return 0;
@@ -143,7 +223,11 @@ int ScriptingManager::Lua_Line(lua_State* L) {
     int y2 = luaL_checkinteger(L, 4);
     int colorIndex = luaL_checkinteger(L, 5);
 
-    layer->Line(x1, y1, x2, y2, colorIndex);
+    if (sm->recorder) {
+        sm->recorder->Line(x1, y1, x2, y2, colorIndex);
+    } else {
+        layer->Line(x1, y1, x2, y2, colorIndex);
+    }
 
     return 0;
 }
@@ -158,7 +242,11 @@ int ScriptingManager::Lua_Rect(lua_State* L) {
     int h = luaL_checkinteger(L, 4);
     int colorIndex = luaL_checkinteger(L, 5);
 
-    layer->Rect(x, y, w, h, colorIndex);
+    if (sm->recorder) {
+        sm->recorder->Rect(x, y, w, h, colorIndex);
+    } else {
+        layer->Rect(x, y, w, h, colorIndex);
+    }
 
     return 0;
 }
@@ -173,7 +261,11 @@ int ScriptingManager::Lua_RectFill(lua_State* L) {
     int h = luaL_checkinteger(L, 4);
     int colorIndex = luaL_checkinteger(L, 5);
 
-    layer->RectFill(x, y, w, h, colorIndex);
+    if (sm->recorder) {
+        sm->recorder->RectFill(x, y, w, h, colorIndex);
+    } else {
+        layer->RectFill(x, y, w, h, colorIndex);
+    }
 
     return 0;
 }
@@ -187,7 +279,11 @@ int ScriptingManager::Lua_Circ(lua_State* L) {
     int r = luaL_checkinteger(L, 3);
     int colorIndex = luaL_checkinteger(L, 4);
 
-    layer->Circ(x, y, r, colorIndex);
+    if (sm->recorder) {
+        sm->recorder->Circ(x, y, r, colorIndex);
+    } else {
+        layer->Circ(x, y, r, colorIndex);
+    }
 
     return 0;
 }
@@ -201,7 +297,74 @@ int ScriptingManager::Lua_CircFill(lua_State* L) {
     int r = luaL_checkinteger(L, 3);
     int colorIndex = luaL_checkinteger(L, 4);
 
-    layer->CircFill(x, y, r, colorIndex);
+    if (sm->recorder) {
+        sm->recorder->CircFill(x, y, r, colorIndex);
+    } else {
+        layer->CircFill(x, y, r, colorIndex);
+    }
+
+    return 0;
+}
+
+int ScriptingManager::Lua_TriFill(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
+
+    // Vertices may be fractional; they are rasterized in fixed point.
+    int32_t v[6];
+    for (int i = 0; i < 6; ++i) {
+        v[i] = Rasterizer::ToFixed(luaL_checknumber(L, i + 1));
+    }
+    int colorIndex = luaL_checkinteger(L, 7);
+
+    if (sm->recorder) {
+        sm->recorder->TriFill(v[0], v[1], v[2], v[3], v[4], v[5], colorIndex);
+    } else {
+        layer->TriFill(v[0], v[1], v[2], v[3], v[4], v[5], colorIndex);
+    }
+
+    return 0;
+}
+
+int ScriptingManager::Lua_PolyFill(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
+
+    // polyfill({x0, y0, x1, y1, ...}, c)
+    luaL_checktype(L, 1, LUA_TTABLE);
+    int colorIndex = luaL_checkinteger(L, 2);
+    const int vertexCount = static_cast<int>(lua_rawlen(L, 1) / 2);
+
+    sm->polygonBuffer.resize(static_cast<size_t>(vertexCount) * 2);
+    for (int i = 0; i < vertexCount * 2; ++i) {
+        lua_rawgeti(L, 1, i + 1);
+        sm->polygonBuffer[i] = Rasterizer::ToFixed(luaL_checknumber(L, -1));
+        lua_pop(L, 1);
+    }
+
+    if (sm->recorder) {
+        sm->recorder->PolyFill(sm->polygonBuffer.data(), vertexCount, colorIndex);
+    } else {
+        layer->PolyFill(sm->polygonBuffer.data(), vertexCount, colorIndex);
+    }
+
+    return 0;
+}
+
+int ScriptingManager::Lua_Fill(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
+
+    // fill(x, y, c)
+    int x = luaL_checkinteger(L, 1);
+    int y = luaL_checkinteger(L, 2);
+    int colorIndex = luaL_checkinteger(L, 3);
+
+    if (sm->recorder) {
+        sm->recorder->FloodFill(x, y, colorIndex);
+    } else {
+        layer->FloodFill(x, y, colorIndex);
+    }
 
     return 0;
 }
@@ -213,6 +376,11 @@ int ScriptingManager::Lua_Pget(lua_State* L) {
     int x = luaL_checkinteger(L, 1);
     int y = luaL_checkinteger(L, 2);
 
+    // Reading back pixels needs every draw call recorded so far to have reached the framebuffer.
+    if (sm->recorder) {
+        sm->recorder->Flush(*layer);
+    }
+
     // Call the C++ function.
     uint8_t colorIndex = layer->Pget(x, y);
 
@@ -296,18 +464,273 @@ int ScriptingManager::Lua_Print(lua_State* L) {
     auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
     AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
 
-    // Get arguments from Lua.
-    const char* text = luaL_checkstring(L, 1);
+    // Get arguments from Lua. The text is viewed in place, without copying it into a std::string.
+    size_t length = 0;
+    const char* text = luaL_checklstring(L, 1, &length);
     int x = luaL_checkinteger(L, 2);
     int y = luaL_checkinteger(L, 3);
     int colorIndex = luaL_checkinteger(L, 4);
 
     // Call the C++ function.
-    layer->Print(text, x, y, colorIndex);
+    if (sm->recorder) {
+        sm->recorder->Print(std::string_view(text, length), x, y, colorIndex);
+    } else {
+        layer->Print(std::string_view(text, length), x, y, colorIndex);
+    }
 
     return 0; // No return values.
 }
 
+// Appends the printf-style expansion of the format string at `fmtIndex` to `out`, consuming
+// Lua arguments from `argIndex` on. Supports %d %i %x %X %o %c %f %e %g %s and %%, with flags,
+// width and precision. Numbers are formatted in C++, so no Lua strings are created for them.
+// As in string.format, width and precision have at most two digits, and integer conversions
+// reject numbers with no integer representation (NaN, infinities, beyond +-2^63).
+static void AppendFormatted(lua_State* L, int fmtIndex, int argIndex, std::string& out) {
+    size_t fmtLength = 0;
+    const char* fmt = luaL_checklstring(L, fmtIndex, &fmtLength);
+    const char* end = fmt + fmtLength;
+
+    char spec[32];
+    char number[128];
+    for (const char* p = fmt; p < end; ++p) {
+        if (*p != '%') {
+            out.push_back(*p);
+            continue;
+        }
+        if (p + 1 < end && p[1] == '%') {
+            out.push_back('%');
+            ++p;
+            continue;
+        }
+
+        // Copy flags, width and precision into a C format specifier.
+        size_t specLength = 0;
+        spec[specLength++] = '%';
+        ++p;
+        const auto isDigit = [&p, end] { return p < end && *p >= '0' && *p <= '9'; };
+        while (p < end && *p != '\0' && std::strchr("-+ #0", *p) && specLength < 6) {
+            spec[specLength++] = *p++;
+        }
+        for (int digits = 0; digits < 2 && isDigit(); ++digits) {
+            spec[specLength++] = *p++;
+        }
+        if (p < end && *p == '.') {
+            spec[specLength++] = *p++;
+            for (int digits = 0; digits < 2 && isDigit(); ++digits) {
+                spec[specLength++] = *p++;
+            }
+        }
+        if (isDigit()) {
+            luaL_error(L, "printf: width and precision are limited to two digits");
+            return;
+        }
+        if (p >= end) {
+            luaL_error(L, "printf: incomplete format specifier");
+            return;
+        }
+
+        const char conversion = *p;
+        int written = 0;
+        switch (conversion) {
+            case 'd': case 'i': case 'x': case 'X': case 'o': case 'c': {
+                // Accept floats for integer conversions by truncating them, as PICO-8 does.
+                const lua_Number argument = luaL_checknumber(L, argIndex);
+                if (!(argument >= -0x1p63 && argument < 0x1p63)) {
+                    luaL_argerror(L, argIndex, "number has no integer representation");
+                    return;
+                }
+                const long long value = static_cast<long long>(argument);
+                ++argIndex;
+                if (conversion == 'c') {
+                    spec[specLength++] = 'c';
+                    spec[specLength] = '\0';
+                    written = std::snprintf(number, sizeof(number), spec, static_cast<int>(value));
+                } else {
+                    spec[specLength++] = 'l';
+                    spec[specLength++] = 'l';
+                    spec[specLength++] = conversion;
+                    spec[specLength] = '\0';
+                    written = std::snprintf(number, sizeof(number), spec, value);
+                }
+                break;
+            }
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': {
+                spec[specLength++] = conversion;
+                spec[specLength] = '\0';
+                written = std::snprintf(number, sizeof(number), spec, luaL_checknumber(L, argIndex++));
+                break;
+            }
+            case 's': {
+                // Strings are appended in place; other values go through Lua's tostring rules.
+                size_t length = 0;
+                const bool isString = lua_type(L, argIndex) == LUA_TSTRING;
+                const char* text = isString ? lua_tolstring(L, argIndex, &length) : luaL_tolstring(L, argIndex, &length);
+                if (specLength == 1) {
+                    out.append(text, length);
+                } else {
+                    // Padding and truncation (%-8s, %.3s) go through snprintf, which stops at a zero.
+                    if (std::strlen(text) != length) {
+                        luaL_argerror(L, argIndex, "string contains zeros");
+                        return;
+                    }
+                    spec[specLength++] = 's';
+                    spec[specLength] = '\0';
+                    const int needed = std::snprintf(nullptr, 0, spec, text);
+                    if (needed > 0) {
+                        const size_t start = out.size();
+                        out.resize(start + static_cast<size_t>(needed) + 1);
+                        std::snprintf(&out[start], static_cast<size_t>(needed) + 1, spec, text);
+                        out.resize(start + static_cast<size_t>(needed));
+                    }
+                }
+                if (!isString) {
+                    lua_pop(L, 1); // Pop the string pushed by luaL_tolstring.
+                }
+                ++argIndex;
+                continue;
+            }
+            default:
+                luaL_error(L, "printf: invalid conversion '%%%c'", conversion);
+                return;
+        }
+
+        if (written > 0) {
+            out.append(number, std::min(static_cast<size_t>(written), sizeof(number) - 1));
+        }
+    }
+}
+
+int ScriptingManager::Lua_Printf(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
+
+    // printf(fmt, x, y, c, ...): the format arguments follow the usual print arguments.
+    int x = luaL_checkinteger(L, 2);
+    int y = luaL_checkinteger(L, 3);
+    int colorIndex = luaL_checkinteger(L, 4);
+
+    sm->formatBuffer.clear(); // Keeps its capacity, so steady-state calls do not allocate.
+    AppendFormatted(L, 1, 5, sm->formatBuffer);
+
+    if (sm->recorder) {
+        sm->recorder->Print(sm->formatBuffer, x, y, colorIndex);
+    } else {
+        layer->Print(sm->formatBuffer, x, y, colorIndex);
+    }
+
+    return 0; // No return values.
+}
+
+int ScriptingManager::Lua_Spr(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
+
+    // spr(n, x, y, [w], [h], [flip_x], [flip_y])
+    int n = luaL_checkinteger(L, 1);
+    int x = luaL_checkinteger(L, 2);
+    int y = luaL_checkinteger(L, 3);
+    int w = luaL_optinteger(L, 4, 1);
+    int h = luaL_optinteger(L, 5, 1);
+    bool flipX = lua_toboolean(L, 6);
+    bool flipY = lua_toboolean(L, 7);
+
+    if (sm->recorder) {
+        sm->recorder->Spr(n, x, y, w, h, flipX, flipY);
+    } else {
+        layer->Spr(n, x, y, w, h, flipX, flipY);
+    }
+
+    return 0;
+}
+
+int ScriptingManager::Lua_Sspr(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
+
+    // sspr(sx, sy, sw, sh, dx, dy, [dw], [dh], [flip_x], [flip_y])
+    int sx = luaL_checkinteger(L, 1);
+    int sy = luaL_checkinteger(L, 2);
+    int sw = luaL_checkinteger(L, 3);
+    int sh = luaL_checkinteger(L, 4);
+    int dx = luaL_checkinteger(L, 5);
+    int dy = luaL_checkinteger(L, 6);
+    int dw = luaL_optinteger(L, 7, sw);
+    int dh = luaL_optinteger(L, 8, sh);
+    bool flipX = lua_toboolean(L, 9);
+    bool flipY = lua_toboolean(L, 10);
+
+    if (sm->recorder) {
+        sm->recorder->Sspr(sx, sy, sw, sh, dx, dy, dw, dh, flipX, flipY);
+    } else {
+        layer->Sspr(sx, sy, sw, sh, dx, dy, dw, dh, flipX, flipY);
+    }
+
+    return 0;
+}
+
+int ScriptingManager::Lua_Mget(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    Tilemap* map = sm->engineInstance->getAestheticLayer()->GetTilemap();
+
+    int x = luaL_checkinteger(L, 1);
+    int y = luaL_checkinteger(L, 2);
+
+    lua_pushinteger(L, map ? map->Get(x, y) : 0);
+    return 1;
+}
+
+int ScriptingManager::Lua_Mset(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    Tilemap* map = sm->engineInstance->getAestheticLayer()->GetTilemap();
+
+    int x = luaL_checkinteger(L, 1);
+    int y = luaL_checkinteger(L, 2);
+    int tile = luaL_checkinteger(L, 3);
+
+    if (map) {
+        // Recorded map() calls must still see the cells as they were when they were issued.
+        if (sm->recorder) {
+            sm->recorder->Flush(*sm->engineInstance->getAestheticLayer());
+        }
+        map->Set(x, y, static_cast<uint8_t>(tile));
+    }
+    return 0;
+}
+
+int ScriptingManager::Lua_Map(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
+    Tilemap* map = layer->GetTilemap();
+    if (!map) return 0;
+
+    // map([celx, cely, sx, sy, celw, celh]): defaults draw the whole map at the origin.
+    int celX = luaL_optinteger(L, 1, 0);
+    int celY = luaL_optinteger(L, 2, 0);
+    int x = luaL_optinteger(L, 3, 0);
+    int y = luaL_optinteger(L, 4, 0);
+    int celW = luaL_optinteger(L, 5, map->GetWidth());
+    int celH = luaL_optinteger(L, 6, map->GetHeight());
+
+    if (sm->recorder) {
+        sm->recorder->Map(celX, celY, x, y, celW, celH);
+    } else {
+        layer->Map(celX, celY, x, y, celW, celH);
+    }
+
+    return 0;
+}
+
+int ScriptingManager::Lua_ReuseFrame(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+
+    // reuseframe(): nothing changed since the last frame. Returns true if the previous frame
+    // will be replayed; outside display-list mode the framebuffer simply keeps its contents.
+    sm->reuseRequested = true;
+    lua_pushboolean(L, sm->recorder != nullptr && sm->hasPreviousList);
+    return 1;
+}
+
 int ScriptingManager::Lua_Time(lua_State* L) {
     auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
     
@@ -324,7 +747,40 @@ int ScriptingManager::Lua_Camera(lua_State* L) {
     int x = luaL_checkinteger(L, 1);
     int y = luaL_checkinteger(L, 2);
 
-    layer->SetCamera(x, y);
+    if (sm->recorder) {
+        sm->recorder->SetCamera(x, y);
+    } else {
+        layer->SetCamera(x, y);
+    }
+
+    return 0;
+}
+
+int ScriptingManager::Lua_Clip(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
+
+    // clip() -> draw on the whole screen again
+    if (lua_isnoneornil(L, 1)) {
+        if (sm->recorder) {
+            sm->recorder->ResetClip();
+        } else {
+            layer->ResetClip();
+        }
+        return 0;
+    }
+
+    // clip(x, y, w, h) -> only draw inside this screen rectangle
+    int x = luaL_checkinteger(L, 1);
+    int y = luaL_checkinteger(L, 2);
+    int w = luaL_checkinteger(L, 3);
+    int h = luaL_checkinteger(L, 4);
+
+    if (sm->recorder) {
+        sm->recorder->SetClip(x, y, w, h);
+    } else {
+        layer->SetClip(x, y, w, h);
+    }
 
     return 0;
 }
@@ -333,13 +789,309 @@ int ScriptingManager::Lua_TColor(lua_State* L) {
     auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
     AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
 
+    std::optional<uint8_t> transparent;
+    if (!lua_isnoneornil(L, 1)) {
+        // tcolor(c) -> set color c as transparent; tcolor() or tcolor(nil) -> disable transparency
+        transparent = static_cast<uint8_t>(luaL_checkinteger(L, 1));
+    }
+
+    if (sm->recorder) {
+        sm->recorder->SetTransparentColor(transparent);
+    } else {
+        layer->SetTransparentColor(transparent);
+    }
+
+    return 0;
+}
+
+int ScriptingManager::Lua_Pal(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
+
+    // pal() -> reset the draw palette and every display palette
+    if (lua_isnoneornil(L, 1)) {
+        if (sm->recorder) {
+            sm->recorder->ResetDrawPalette();
+        } else {
+            layer->ResetDrawPalette();
+        }
+        layer->ResetDisplayPalettes();
+        return 0;
+    }
+
+    // pal(c0, c1, [p]) -> p = 0 remaps drawing (default), p = 1 remaps the displayed screen
+    uint8_t from = static_cast<uint8_t>(luaL_checkinteger(L, 1));
+    uint8_t to = static_cast<uint8_t>(luaL_checkinteger(L, 2));
+    int target = luaL_optinteger(L, 3, 0);
+
+    if (target == 1) {
+        // The display palette is applied at present time, so it is never recorded.
+        layer->SetDisplayPaletteEntry(0, from, to);
+    } else if (sm->recorder) {
+        sm->recorder->SetDrawPaletteEntry(from, to);
+    } else {
+        layer->SetDrawPaletteEntry(from, to);
+    }
+
+    return 0;
+}
+
+int ScriptingManager::Lua_Palt(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
+
+    // palt() -> no transparent colors
     if (lua_isnoneornil(L, 1)) {
-        // tcolor() or tcolor(nil) -> disable transparency
-        layer->SetTransparentColor(std::nullopt);
+        if (sm->recorder) {
+            sm->recorder->SetTransparentColor(std::nullopt);
+        } else {
+            layer->SetTransparentColor(std::nullopt);
+        }
+        return 0;
+    }
+
+    // palt(c, [t]) -> make color c transparent (t = true, default) or opaque (t = false)
+    uint8_t color = static_cast<uint8_t>(luaL_checkinteger(L, 1));
+    bool transparent = lua_isnoneornil(L, 2) ? true : lua_toboolean(L, 2);
+
+    if (sm->recorder) {
+        sm->recorder->SetTransparent(color, transparent);
+    } else {
+        layer->SetTransparent(color, transparent);
+    }
+
+    return 0;
+}
+
+int ScriptingManager::Lua_Fillp(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
+
+    // fillp([p], [c2]) -> set bits of pattern p draw color c2, or nothing if c2 is omitted.
+    // fillp() draws solid again.
+    uint16_t pattern = static_cast<uint16_t>(luaL_optinteger(L, 1, 0));
+    std::optional<uint8_t> altColor;
+    if (!lua_isnoneornil(L, 2)) {
+        altColor = static_cast<uint8_t>(luaL_checkinteger(L, 2));
+    }
+
+    if (sm->recorder) {
+        sm->recorder->SetFillPattern(pattern, altColor);
+    } else {
+        layer->SetFillPattern(pattern, altColor);
+    }
+
+    return 0;
+}
+
+int ScriptingManager::Lua_Spal(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
+
+    // spal(bank, c0, c1) -> rows using display palette `bank` show index c0 as color c1
+    int bank = luaL_checkinteger(L, 1);
+    uint8_t from = static_cast<uint8_t>(luaL_checkinteger(L, 2));
+    uint8_t to = static_cast<uint8_t>(luaL_checkinteger(L, 3));
+    layer->SetDisplayPaletteEntry(bank, from, to);
+
+    return 0;
+}
+
+int ScriptingManager::Lua_SpalRows(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
+
+    // spalrows(y0, y1, bank) -> screen rows y0..y1 use display palette `bank`
+    int y0 = luaL_checkinteger(L, 1);
+    int y1 = luaL_checkinteger(L, 2);
+    int bank = luaL_checkinteger(L, 3);
+    layer->SetScanlinePalette(y0, y1, bank);
+
+    return 0;
+}
+
+int ScriptingManager::Lua_Surface(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
+
+    // surface(w, h) -> id of a new offscreen surface cleared to color 0, or nil
+    int w = luaL_checkinteger(L, 1);
+    int h = luaL_checkinteger(L, 2);
+    int id = layer->CreateSurface(w, h);
+    if (id < 0) {
+        lua_pushnil(L);
+    } else {
+        lua_pushinteger(L, id);
+    }
+    return 1;
+}
+
+int ScriptingManager::Lua_FreeSurface(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
+
+    int id = luaL_checkinteger(L, 1);
+    if (id > 0 && layer->GetDrawTarget() == id) {
+        sm->SetDrawTarget(*layer, 0);
+    }
+    // Recorded blits may still read the surface, so they must run before it goes away.
+    if (sm->recorder) {
+        sm->recorder->Flush(*layer);
+    }
+    layer->FreeSurface(id);
+    return 0;
+}
+
+int ScriptingManager::Lua_Target(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
+
+    // target([id]) -> draw on surface id, or on the screen without an argument
+    int id = luaL_optinteger(L, 1, 0);
+    lua_pushboolean(L, sm->SetDrawTarget(*layer, id));
+    return 1;
+}
+
+int ScriptingManager::Lua_Blit(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
+
+    // blit(src, sx, sy, w, h, dx, dy, [masked])
+    int source = luaL_checkinteger(L, 1);
+    int sx = luaL_checkinteger(L, 2);
+    int sy = luaL_checkinteger(L, 3);
+    int w = luaL_checkinteger(L, 4);
+    int h = luaL_checkinteger(L, 5);
+    int dx = luaL_checkinteger(L, 6);
+    int dy = luaL_checkinteger(L, 7);
+    bool masked = lua_toboolean(L, 8);
+
+    if (sm->recorder) {
+        sm->recorder->Blit(source, sx, sy, w, h, dx, dy, masked);
+    } else {
+        layer->Blit(source, sx, sy, w, h, dx, dy, masked);
+    }
+
+    return 0;
+}
+
+int ScriptingManager::Lua_Rspr(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
+
+    // rspr(sx, sy, sw, sh, x, y, [angle], [scale_x], [scale_y], [src])
+    int sx = luaL_checkinteger(L, 1);
+    int sy = luaL_checkinteger(L, 2);
+    int sw = luaL_checkinteger(L, 3);
+    int sh = luaL_checkinteger(L, 4);
+    int x = luaL_checkinteger(L, 5);
+    int y = luaL_checkinteger(L, 6);
+    // Only the fraction of a turn matters, so growing angles (e.g. time()) keep full precision.
+    double turns = luaL_optnumber(L, 7, 0.0);
+    double scaleX = luaL_optnumber(L, 8, 1.0);
+    double scaleY = luaL_optnumber(L, 9, scaleX);
+    int source = luaL_optinteger(L, 10, Rasterizer::SPRITE_SHEET_SOURCE);
+
+    int32_t angle = Rasterizer::ToAffine(turns - std::floor(turns));
+    int32_t fixedScaleX = Rasterizer::ToAffine(scaleX);
+    int32_t fixedScaleY = Rasterizer::ToAffine(scaleY);
+    if (sm->recorder) {
+        sm->recorder->Rspr(source, sx, sy, sw, sh, x, y, angle, fixedScaleX, fixedScaleY);
+    } else {
+        layer->Rspr(source, sx, sy, sw, sh, x, y, angle, fixedScaleX, fixedScaleY);
+    }
+
+    return 0;
+}
+
+int ScriptingManager::Lua_Fade(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
+
+    // fade(amount, [c])
+    double amount = luaL_checknumber(L, 1);
+    int colorIndex = luaL_optinteger(L, 2, 0);
+
+    const std::array<uint8_t, 256> lut = layer->FadeLUT(amount, colorIndex);
+    if (sm->recorder) {
+        sm->recorder->Remap(lut.data());
+    } else {
+        layer->Remap(lut.data());
+    }
+
+    return 0;
+}
+
+int ScriptingManager::Lua_PCycle(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
+
+    // pcycle(first, last, [step])
+    int first = luaL_checkinteger(L, 1);
+    int last = luaL_checkinteger(L, 2);
+    int step = luaL_optinteger(L, 3, 1);
+
+    const std::array<uint8_t, 256> lut = layer->CycleLUT(first, last, step);
+    if (sm->recorder) {
+        sm->recorder->Remap(lut.data());
+    } else {
+        layer->Remap(lut.data());
+    }
+
+    return 0;
+}
+
+int ScriptingManager::Lua_Mosaic(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
+
+    // mosaic(size)
+    int size = luaL_checkinteger(L, 1);
+
+    if (sm->recorder) {
+        sm->recorder->Mosaic(size);
+    } else {
+        layer->Mosaic(size);
+    }
+
+    return 0;
+}
+
+int ScriptingManager::Lua_Wobble(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
+
+    // wobble(amplitude, period, [phase])
+    double amplitude = luaL_checknumber(L, 1);
+    double period = luaL_checknumber(L, 2);
+    // Only the fraction of a turn matters, so growing phases (e.g. time()) keep full precision.
+    double turns = luaL_optnumber(L, 3, 0.0);
+
+    int32_t fixedAmplitude = Rasterizer::ToAffine(amplitude);
+    int32_t fixedPeriod = Rasterizer::ToAffine(period);
+    int32_t phase = Rasterizer::ToAffine(turns - std::floor(turns));
+    if (sm->recorder) {
+        sm->recorder->Wobble(fixedAmplitude, fixedPeriod, phase);
+    } else {
+        layer->Wobble(fixedAmplitude, fixedPeriod, phase);
+    }
+
+    return 0;
+}
+
+int ScriptingManager::Lua_Dissolve(lua_State* L) {
+    auto* sm = static_cast<ScriptingManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    AestheticLayer* layer = sm->engineInstance->getAestheticLayer();
+
+    // dissolve(amount, [c])
+    double amount = luaL_checknumber(L, 1);
+    int colorIndex = luaL_optinteger(L, 2, 0);
+
+    int level = static_cast<int>(std::lround(std::clamp(amount, 0.0, 1.0) * Rasterizer::DISSOLVE_LEVELS));
+    if (sm->recorder) {
+        sm->recorder->Dissolve(level, colorIndex);
     } else {
-        // tcolor(c) -> set color c as transparent
-        int colorIndex = luaL_checkinteger(L, 1);
-        layer->SetTransparentColor(static_cast<uint8_t>(colorIndex));
+        layer->Dissolve(level, colorIndex);
     }
 
     return 0;
@@ -477,3 +1229,57 @@ bool ScriptingManager::CallLuaFunction(const char* functionName) {
     }
     return true;
 }
+
+bool ScriptingManager::SetDrawTarget(AestheticLayer& layer, int id) {
+    if (id == layer.GetDrawTarget()) {
+        return true;
+    }
+    // Everything recorded so far was meant for the previous target.
+    if (recorder) {
+        recorder->Flush(layer);
+    }
+    if (!layer.SetDrawTarget(id)) {
+        return false;
+    }
+
+    // Display lists are binned by screen rows, so surface drawing bypasses the recording.
+    if (id != 0 && recorder) {
+        suspendedRecorder = recorder;
+        recorder = nullptr;
+        drewToSurface = true;
+    } else if (id == 0 && suspendedRecorder) {
+        recorder = suspendedRecorder;
+        suspendedRecorder = nullptr;
+        recorder->Resume(layer.GetDrawState());
+    }
+    return true;
+}
+
+bool ScriptingManager::CallDrawFunction(AestheticLayer& layer) {
+    if (!displayListEnabled) {
+        bool ok = CallLuaFunction("_draw");
+        layer.SetDrawTarget(0);
+        return ok;
+    }
+
+    // Record the frame, starting from the layer's current camera and transparency.
+    currentList.Begin(layer.GetDrawState(), layer.GetScreenWidth(), layer.GetScreenHeight());
+    recorder = &currentList;
+    reuseRequested = false;
+    drewToSurface = false;
+    bool ok = CallLuaFunction("_draw");
+    // Each frame starts on the screen, even if _draw ended (or failed) while drawing to a surface.
+    SetDrawTarget(layer, 0);
+    recorder = nullptr;
+
+    if (reuseRequested && hasPreviousList && !drewToSurface) {
+        // The frame is unchanged: drop this recording and draw the previous one again.
+        previousList.Replay(layer);
+    } else {
+        currentList.Flush(layer);
+        std::swap(currentList, previousList); // Both arenas keep their capacity.
+        // A list interrupted by surface drawing does not hold the whole frame's state changes.
+        hasPreviousList = !drewToSurface;
+    }
+    return ok;
+}
@@ -3,6 +3,8 @@
 
 #include <string>
 #include <random>
+#include <vector>
+#include "rendering/DisplayList.h"
 
 // Include the C++ wrapper for the Lua C API headers.
 extern "C" {
@@ -27,6 +29,15 @@ public:
     // Returns false if an error occurs during the call.
     bool CallLuaFunction(const char* functionName);
 
+    // Calls the script's _draw function. In display-list mode its draw calls are recorded and
+    // then executed on the layer in one pass; if the script called reuseframe(), the previous
+    // frame's list is replayed instead.
+    bool CallDrawFunction(AestheticLayer& layer);
+
+    // Enables or disables display-list recording of _draw.
+    void SetDisplayListEnabled(bool enabled) { displayListEnabled = enabled; }
+    bool IsDisplayListEnabled() const { return displayListEnabled; }
+
     lua_State* GetLuaState() const { return L; }
 
     const std::string& GetLastLuaError() const { return lastError; }
@@ -36,12 +47,30 @@ private:
     Engine* engineInstance; // Non-owning pointer to the main engine instance.
     std::string lastError;
     std::mt19937 rng; // Mersenne Twister random number generator.
+    std::string formatBuffer; // Reused by printf() so formatting HUD text does not allocate per call.
+    std::vector<int32_t> polygonBuffer; // Reused by polyfill() for the fixed-point vertices.
+
+    // Display-list mode: while _draw runs, draw calls go to `recorder` instead of the layer.
+    bool displayListEnabled = false;
+    DisplayList* recorder = nullptr; // Non-null only while _draw is being recorded.
+    DisplayList currentList;
+    DisplayList previousList;
+    bool hasPreviousList = false;
+    bool reuseRequested = false;
+    // While _draw targets an offscreen surface, drawing goes straight to the layer and the
+    // recording is parked here; it resumes when the screen becomes the target again.
+    DisplayList* suspendedRecorder = nullptr;
+    bool drewToSurface = false; // The frame being recorded switched targets, so it cannot be replayed.
 
     void RegisterAPI();
 
     // Helper to register a C function with an upvalue.
     void RegisterFunction(const char* luaName, lua_CFunction func);
 
+    // Makes surface `id` the draw target, flushing, suspending or resuming the recording
+    // as needed. Returns false for unknown ids.
+    bool SetDrawTarget(AestheticLayer& layer, int id);
+
     // Static bridge function to call AestheticLayer::Clear
     static int Lua_Clear(lua_State* L);
 
@@ -63,6 +92,15 @@ private:
     // Static bridge function to call AestheticLayer::CircFill
     static int Lua_CircFill(lua_State* L);
 
+    // Static bridge function to call AestheticLayer::TriFill
+    static int Lua_TriFill(lua_State* L);
+
+    // Static bridge function to call AestheticLayer::PolyFill
+    static int Lua_PolyFill(lua_State* L);
+
+    // Static bridge function to call AestheticLayer::FloodFill
+    static int Lua_Fill(lua_State* L);
+
     // Static bridge function to call AestheticLayer::Pget
     static int Lua_Pget(lua_State* L);
 
@@ -75,15 +113,84 @@ private:
     // Static bridge function to call AestheticLayer::Print
     static int Lua_Print(lua_State* L);
 
+    // Static bridge function that formats numbers into a reusable buffer and calls AestheticLayer::Print
+    static int Lua_Printf(lua_State* L);
+
+    // Static bridge function to call AestheticLayer::Spr
+    static int Lua_Spr(lua_State* L);
+
+    // Static bridge function to call AestheticLayer::Sspr
+    static int Lua_Sspr(lua_State* L);
+
+    // Static bridge function to call Tilemap::Get
+    static int Lua_Mget(lua_State* L);
+
+    // Static bridge function to call Tilemap::Set
+    static int Lua_Mset(lua_State* L);
+
+    // Static bridge function to call AestheticLayer::Map
+    static int Lua_Map(lua_State* L);
+
+    // Static bridge function that asks CallDrawFunction to replay the previous display list
+    static int Lua_ReuseFrame(lua_State* L);
+
     // Static bridge function to call Engine::getElapsedTime
     static int Lua_Time(lua_State* L);
 
     // Static bridge function to call AestheticLayer::SetCamera
     static int Lua_Camera(lua_State* L);
 
+    // Static bridge function to call AestheticLayer::SetClip / ResetClip
+    static int Lua_Clip(lua_State* L);
+
     // Static bridge function to call AestheticLayer::SetTransparentColor
     static int Lua_TColor(lua_State* L);
 
+    // Static bridge function to call AestheticLayer::SetDrawPaletteEntry / SetDisplayPaletteEntry
+    static int Lua_Pal(lua_State* L);
+
+    // Static bridge function to call AestheticLayer::SetTransparent
+    static int Lua_Palt(lua_State* L);
+
+    // Static bridge function to call AestheticLayer::SetFillPattern
+    static int Lua_Fillp(lua_State* L);
+
+    // Static bridge function to call AestheticLayer::SetDisplayPaletteEntry on any bank
+    static int Lua_Spal(lua_State* L);
+
+    // Static bridge function to call AestheticLayer::SetScanlinePalette
+    static int Lua_SpalRows(lua_State* L);
+
+    // Static bridge function to call AestheticLayer::CreateSurface
+    static int Lua_Surface(lua_State* L);
+
+    // Static bridge function to call AestheticLayer::FreeSurface
+    static int Lua_FreeSurface(lua_State* L);
+
+    // Static bridge function to call AestheticLayer::SetDrawTarget
+    static int Lua_Target(lua_State* L);
+
+    // Static bridge function to call AestheticLayer::Blit
+    static int Lua_Blit(lua_State* L);
+
+    // Static bridge function to call AestheticLayer::Rspr
+    static int Lua_Rspr(lua_State* L);
+
+    // Static bridge function to call AestheticLayer::Remap with a FadeLUT
+    static int Lua_Fade(lua_State* L);
+
+    // Static bridge function to call AestheticLayer::Remap with a CycleLUT
+    static int Lua_PCycle(lua_State* L);
+
+    // Static bridge function to call AestheticLayer::Mosaic
+    static int Lua_Mosaic(lua_State* L);
+
+    // Static bridge function to call AestheticLayer::Wobble
+    static int Lua_Wobble(lua_State* L);
+
+    // Static bridge function to call AestheticLayer::Dissolve
+    static int Lua_Dissolve(lua_State* L);
+
     // Static bridge function to scan for and list available cartridges.
     static int Lua_ListCarts(lua_State* L);
 
@@ -0,0 +1,1313 @@
+// tests/AestheticLayer_test.cpp
+
+#include "gtest/gtest.h"
+#include "rendering/AestheticLayer.h"
+#include "rendering/SoftwareRenderBackend.h"
+#include "rendering/EmbeddedFont.h"
+#include <array>
+#include <memory>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <thread>
+
+// Test fixture for AestheticLayer tests.
+// The layer draws into an in-memory software backend, so no window or renderer is needed.
+class AestheticLayerTest : public ::testing::Test {
+protected:
+    static constexpr int W = AestheticLayer::FRAMEBUFFER_WIDTH;
+    static constexpr int H = AestheticLayer::FRAMEBUFFER_HEIGHT;
+
+    std::unique_ptr<AestheticLayer> layer;
+    SoftwareRenderBackend* backend = nullptr; // Owned by the layer.
+
+    void SetUp() override {
+        auto softwareBackend = std::make_unique<SoftwareRenderBackend>(W, H);
+        backend = softwareBackend.get();
+        layer = std::make_unique<AestheticLayer>(std::move(softwareBackend));
+    }
+
+    uint8_t IndexAt(int x, int y) const {
+        return layer->GetFramebuffer()[y * W + x];
+    }
+};
+
+// A rectangle much larger than the screen is clipped and fills every pixel.
+TEST_F(AestheticLayerTest, RectFillClipsToFramebuffer) {
+    layer->Clear(1);
+    layer->RectFill(-128, -128, 512, 512, 2);
+
+    for (uint8_t index : layer->GetFramebuffer()) {
+        ASSERT_EQ(index, 2);
+    }
+}
+
+// The camera offset shifts primitives and partially visible rectangles are cut at the edges.
+TEST_F(AestheticLayerTest, RectFillHonorsCamera) {
+    layer->Clear(0);
+    layer->SetCamera(10, 20);
+    layer->RectFill(5, 15, 10, 10, 7); // Screen rect (-5, -5) to (4, 4).
+
+    EXPECT_EQ(IndexAt(0, 0), 7);
+    EXPECT_EQ(IndexAt(4, 4), 7);
+    EXPECT_EQ(IndexAt(5, 4), 0);
+    EXPECT_EQ(IndexAt(4, 5), 0);
+}
+
+// CircFill covers exactly the pixels within the radius, including when clipped.
+TEST_F(AestheticLayerTest, CircFillMatchesDistanceTest) {
+    const int cx = 3, cy = 250, r = 17;
+    layer->Clear(0);
+    layer->CircFill(cx, cy, r, 9);
+
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            bool inside = (x - cx) * (x - cx) + (y - cy) * (y - cy) <= r * r;
+            ASSERT_EQ(IndexAt(x, y), inside ? 9 : 0) << "at " << x << "," << y;
+        }
+    }
+}
+
+// Drawing with the transparent color leaves the framebuffer untouched.
+TEST_F(AestheticLayerTest, TransparentColorIsSkipped) {
+    layer->Clear(3);
+    layer->SetTransparentColor(5);
+    layer->RectFill(0, 0, 50, 50, 5);
+    layer->CircFill(100, 100, 20, 5);
+    layer->SetPixel(200, 200, 5);
+
+    for (uint8_t index : layer->GetFramebuffer()) {
+        ASSERT_EQ(index, 3);
+    }
+}
+
+// Present expands the indices through the palette into the backend's ARGB image.
+TEST_F(AestheticLayerTest, PresentWritesPaletteColors) {
+    layer->Clear(8);          // Red: 255, 0, 77
+    layer->SetPixel(1, 2, 12); // Blue: 41, 173, 255
+    layer->Present();
+
+    const auto& pixels = backend->GetPixels();
+    EXPECT_EQ(pixels[0], 0xFFFF004Du);
+    EXPECT_EQ(pixels[2 * W + 1], 0xFF29ADFFu);
+    EXPECT_EQ(backend->GetPresentedFrameCount(), 1u);
+}
+
+// Only rows whose indices changed since the last Present are converted again.
+TEST_F(AestheticLayerTest, PresentUploadsOnlyChangedRows) {
+    layer->Clear(1);
+    layer->Present();
+    EXPECT_EQ(layer->GetLastUploadRowCount(), H);
+
+    // Redrawing an identical screen uploads nothing.
+    layer->Clear(1);
+    layer->Present();
+    EXPECT_EQ(layer->GetLastUploadRowCount(), 0);
+
+    layer->RectFill(0, 40, 10, 3, 7);
+    layer->Present();
+    EXPECT_EQ(layer->GetLastUploadRowCount(), 3);
+}
+
+// The pipelined presenter produces the same image as single-threaded presentation.
+TEST_F(AestheticLayerTest, PipelinedPresentMatchesSingleThreaded) {
+    layer->SetPipelinedPresent(true);
+    for (int frame = 0; frame < 10; ++frame) {
+        layer->Clear(frame % 4);
+        layer->CircFill(128, 128, frame * 10, 11);
+        layer->Present();
+    }
+    layer->SetPipelinedPresent(false); // Waits for the last frame to be shown.
+    std::vector<uint32_t> pipelined = backend->GetPixels();
+
+    layer->Clear(0);
+    layer->Present();
+    layer->Clear(9 % 4);
+    layer->CircFill(128, 128, 90, 11);
+    layer->Present();
+
+    EXPECT_EQ(backend->GetPixels(), pipelined);
+    EXPECT_EQ(backend->GetPresentedFrameCount(), 12u);
+}
+
+// In pipelined mode the backend, like an SDL renderer, is only called from the thread that
+// calls Present(); the presenter thread only stages rows.
+TEST_F(AestheticLayerTest, PipelinedPresentCallsBackendOnCallingThreadOnly) {
+    // 1. Arrange: a backend that counts calls made from any other thread.
+    class ThreadCheckingBackend : public SoftwareRenderBackend {
+    public:
+        using SoftwareRenderBackend::SoftwareRenderBackend;
+        bool LockRows(int y0, int y1, uint32_t*& pixels, int& pitch) override {
+            Check();
+            return SoftwareRenderBackend::LockRows(y0, y1, pixels, pitch);
+        }
+        void UnlockRows() override { Check(); }
+        void Show() override {
+            Check();
+            SoftwareRenderBackend::Show();
+        }
+        int foreignCalls = 0;
+
+    private:
+        void Check() { foreignCalls += std::this_thread::get_id() != owner ? 1 : 0; }
+        std::thread::id owner = std::this_thread::get_id();
+    };
+    auto checkingBackend = std::make_unique<ThreadCheckingBackend>(W, H);
+    ThreadCheckingBackend* checking = checkingBackend.get();
+    AestheticLayer pipelinedLayer(std::move(checkingBackend));
+    PostProcessor::Settings settings;
+    settings.scale = 2;
+    settings.bloom = 200;
+    settings.threads = 2;
+
+    // 2. Act: present plain and post-processed frames through the presenter thread.
+    pipelinedLayer.SetPipelinedPresent(true);
+    for (int frame = 0; frame < 8; ++frame) {
+        if (frame == 4) {
+            pipelinedLayer.SetPostProcess(settings);
+        }
+        pipelinedLayer.Clear(frame % 3);
+        pipelinedLayer.CircFill(100, 100, frame * 8, 11);
+        pipelinedLayer.Present();
+    }
+    pipelinedLayer.SetPipelinedPresent(false);
+
+    // 3. Assert: every frame was shown, only from this thread, and the staged rows match
+    // single-threaded presentation.
+    EXPECT_EQ(checking->GetPresentedFrameCount(), 8u);
+    EXPECT_EQ(checking->foreignCalls, 0);
+    layer->SetPostProcess(settings);
+    layer->Clear(7 % 3);
+    layer->CircFill(100, 100, 7 * 8, 11);
+    layer->Present();
+    EXPECT_EQ(checking->GetPixels(), backend->GetPixels());
+}
+
+// Rows whose upload failed because the backend could not be locked are uploaded again by the
+// next Present(), even though the framebuffer did not change in between.
+TEST_F(AestheticLayerTest, FailedUploadIsRetriedOnNextPresent) {
+    // 1. Arrange: a backend whose next lock fails.
+    class FlakyBackend : public SoftwareRenderBackend {
+    public:
+        using SoftwareRenderBackend::SoftwareRenderBackend;
+        bool LockRows(int y0, int y1, uint32_t*& pixels, int& pitch) override {
+            if (failNextLock) {
+                failNextLock = false;
+                return false;
+            }
+            return SoftwareRenderBackend::LockRows(y0, y1, pixels, pitch);
+        }
+        bool failNextLock = false;
+    };
+    auto flakyBackend = std::make_unique<FlakyBackend>(W, H);
+    FlakyBackend* flaky = flakyBackend.get();
+    AestheticLayer flakyLayer(std::move(flakyBackend));
+    flakyLayer.Clear(1);
+    flakyLayer.Present();
+
+    // 2. Act: the upload of a change fails, then an unchanged frame is presented.
+    flakyLayer.RectFill(0, 40, 10, 3, 8);
+    flaky->failNextLock = true;
+    flakyLayer.Present();
+    const uint32_t afterFailure = flaky->GetPixels()[40 * W];
+    flakyLayer.Present();
+
+    // 3. Assert
+    EXPECT_NE(afterFailure, 0xFFFF004Du);
+    EXPECT_EQ(flaky->GetPixels()[40 * W], 0xFFFF004Du); // Red
+}
+
+// With skipping enabled, frames identical to the last one shown are neither uploaded nor
+// presented, in both present modes, while any real change is still shown.
+TEST_F(AestheticLayerTest, UnchangedFramesAreSkipped) {
+    layer->SetSkipUnchangedFrames(true);
+    for (bool pipelined : {false, true}) {
+        layer->SetPipelinedPresent(pipelined);
+        const uint64_t shownBefore = backend->GetPresentedFrameCount();
+        const uint64_t skippedBefore = layer->GetSkippedFrameCount();
+
+        // 1. Arrange: a static screen, redrawn every frame.
+        layer->Clear(1);
+        layer->RectFill(10, 10, 20, 20, 7);
+        layer->Present();
+
+        // 2. Act: the same screen again, an undamaged frame, then a palette change and a real edit.
+        int skippedPresents = 0;
+        for (int frame = 0; frame < 5; ++frame) {
+            layer->Clear(1);
+            layer->RectFill(10, 10, 20, 20, 7);
+            skippedPresents += layer->Present() ? 0 : 1;
+        }
+        skippedPresents += layer->Present() ? 0 : 1;
+        layer->SetDisplayPaletteEntry(0, 7, 8);
+        const bool paletteShown = layer->Present();
+        layer->SetPixel(0, 0, 12);
+        const bool editShown = layer->Present();
+        layer->InvalidateOutput();
+        const bool invalidatedShown = layer->Present();
+        layer->SetPipelinedPresent(false); // Waits for the last frame to be shown.
+
+        // 3. Assert
+        EXPECT_EQ(skippedPresents, 6);
+        EXPECT_EQ(layer->GetSkippedFrameCount() - skippedBefore, 6u);
+        EXPECT_TRUE(paletteShown);
+        EXPECT_TRUE(editShown);
+        EXPECT_TRUE(invalidatedShown);
+        EXPECT_EQ(backend->GetPresentedFrameCount() - shownBefore, 4u);
+        EXPECT_EQ(backend->GetPixels()[0], 0xFF29ADFFu);          // Blue
+        EXPECT_EQ(backend->GetPixels()[15 * W + 15], 0xFFFF004Du); // 7 shown as red
+        layer->ResetDisplayPalettes();
+    }
+}
+
+// Text partially off screen draws exactly the visible set bits of each glyph.
+TEST_F(AestheticLayerTest, PrintClipsGlyphsAtScreenEdges) {
+    layer->Clear(0);
+    layer->Print("A#", -3, -2, 7);
+
+    // Expected pixels decoded bit by bit from the embedded font.
+    for (int y = 0; y < 8; ++y) {
+        for (int x = 0; x < 16; ++x) {
+            int glyphX = x + 3;
+            int glyphY = y + 2;
+            bool set = false;
+            if (glyphY < 8 && glyphX < 16) {
+                char c = glyphX < 8 ? 'A' : '#';
+                uint8_t rowData = EmbeddedFont::FONT_DATA[(c - 32) * 8 + glyphY];
+                set = (rowData >> (7 - glyphX % 8)) & 1;
+            }
+            ASSERT_EQ(IndexAt(x, y), set ? 7 : 0) << "at " << x << "," << y;
+        }
+    }
+}
+
+// Sprite blits match a per-pixel reference for every flip combination, stretch and clip.
+TEST_F(AestheticLayerTest, SpritesMatchPerPixelReference) {
+    // A 32x16 sheet with a pattern that includes the transparent color 0.
+    std::vector<uint8_t> pixels(32 * 16);
+    for (int i = 0; i < 32 * 16; ++i) {
+        pixels[i] = static_cast<uint8_t>((i * 7 + i / 32) % 5);
+    }
+    auto sheet = std::make_shared<SpriteSheet>(32, 16, pixels);
+    layer->SetSpriteSheet(sheet);
+    layer->SetTransparentColor(0);
+
+    struct Case { int sx, sy, sw, sh, dx, dy, dw, dh; };
+    const Case cases[] = {
+        {0, 0, 8, 8, 10, 10, 8, 8},      // Single sprite.
+        {4, 2, 24, 13, -6, 250, 24, 13}, // Clipped at the left and bottom edges.
+        {-3, -2, 40, 20, 250, -5, 40, 20}, // Source larger than the sheet.
+        {8, 0, 8, 8, 100, 100, 20, 13},  // Stretched.
+    };
+
+    for (const Case& c : cases) {
+        for (int flips = 0; flips < 4; ++flips) {
+            bool flipX = flips & 1;
+            bool flipY = flips & 2;
+            layer->Clear(9);
+            layer->Sspr(c.sx, c.sy, c.sw, c.sh, c.dx, c.dy, c.dw, c.dh, flipX, flipY);
+
+            for (int y = 0; y < H; ++y) {
+                for (int x = 0; x < W; ++x) {
+                    uint8_t expected = 9;
+                    if (x >= c.dx && x < c.dx + c.dw && y >= c.dy && y < c.dy + c.dh) {
+                        int u = (x - c.dx) * c.sw / c.dw;
+                        int v = (y - c.dy) * c.sh / c.dh;
+                        if (flipX) u = c.sw - 1 - u;
+                        if (flipY) v = c.sh - 1 - v;
+                        int srcX = c.sx + u;
+                        int srcY = c.sy + v;
+                        if (srcX >= 0 && srcX < 32 && srcY >= 0 && srcY < 16 && pixels[srcY * 32 + srcX] != 0) {
+                            expected = pixels[srcY * 32 + srcX];
+                        }
+                    }
+                    ASSERT_EQ(IndexAt(x, y), expected) << "case dx=" << c.dx << " flips=" << flips << " at " << x << "," << y;
+                }
+            }
+        }
+    }
+
+    // spr() addresses 8x8 cells left to right, top to bottom.
+    layer->Clear(9);
+    layer->Spr(5, 0, 0);
+    EXPECT_EQ(IndexAt(1, 0), pixels[8 * 32 + 8 + 1] != 0 ? pixels[8 * 32 + 8 + 1] : 9);
+}
+
+// Drawing the map from cached chunks matches drawing every cell with spr(), before and after mset().
+TEST_F(AestheticLayerTest, MapMatchesPerTileSprites) {
+    std::vector<uint8_t> pixels(64 * 16);
+    for (int i = 0; i < 64 * 16; ++i) {
+        pixels[i] = static_cast<uint8_t>((i * 5 + i / 64) % 4);
+    }
+    layer->SetSpriteSheet(std::make_shared<SpriteSheet>(64, 16, pixels));
+    layer->SetTransparentColor(0);
+
+    auto map = std::make_shared<Tilemap>(40, 37);
+    for (int y = 0; y < 37; ++y) {
+        for (int x = 0; x < 40; ++x) {
+            map->Set(x, y, static_cast<uint8_t>((x * 3 + y) % 16));
+        }
+    }
+    layer->SetTilemap(map);
+
+    auto compare = [&](int celX, int celY, int sx, int sy, int celW, int celH) {
+        layer->Clear(5);
+        for (int cy = celY; cy < celY + celH; ++cy) {
+            for (int cx = celX; cx < celX + celW; ++cx) {
+                uint8_t tile = map->Get(cx, cy);
+                if (tile != 0 && cx >= 0 && cy >= 0 && cx < 40 && cy < 37) {
+                    layer->Spr(tile, sx + (cx - celX) * 8, sy + (cy - celY) * 8);
+                }
+            }
+        }
+        std::vector<uint8_t> expected = layer->GetFramebuffer();
+
+        layer->Clear(5);
+        layer->Map(celX, celY, sx, sy, celW, celH);
+        return layer->GetFramebuffer() == expected;
+    };
+
+    EXPECT_TRUE(compare(0, 0, 0, 0, 40, 37));
+    EXPECT_TRUE(compare(3, 5, -13, 7, 30, 30));
+    EXPECT_TRUE(compare(-2, -1, 100, -20, 10, 50));
+
+    map->Set(20, 20, 7);
+    map->Set(1, 1, 0);
+    layer->SetCamera(17, -9);
+    EXPECT_TRUE(compare(0, 0, 0, 0, 40, 37));
+    EXPECT_EQ(map->Get(20, 20), 7);
+    EXPECT_EQ(map->Get(-1, 3), 0);
+}
+
+// The draw palette remaps colors as they are written and every color in the mask is skipped,
+// for fills and for both the run-based and the stretched sprite paths.
+TEST_F(AestheticLayerTest, DrawPaletteAndTransparencyMaskApplyToAllKernels) {
+    // 1. Arrange: Colors 1 and 2 are transparent, 3 is drawn as 14 and 8 as 12.
+    std::vector<uint8_t> pixels(16 * 16);
+    for (int i = 0; i < 16 * 16; ++i) {
+        pixels[i] = static_cast<uint8_t>(i % 5);
+    }
+    layer->SetSpriteSheet(std::make_shared<SpriteSheet>(16, 16, pixels));
+    layer->SetTransparentColor(std::nullopt);
+    layer->SetTransparent(1, true);
+    layer->SetTransparent(2, true);
+    layer->SetDrawPaletteEntry(3, 14);
+    layer->SetDrawPaletteEntry(8, 12);
+
+    // 2. Act: Draw a fill, an unscaled sprite and a stretched one.
+    layer->Clear(9);
+    layer->RectFill(0, 0, 4, 4, 8);
+    layer->RectFill(0, 4, 4, 4, 2);
+    layer->Sspr(0, 0, 16, 16, 20, 0, 16, 16);
+    layer->Sspr(0, 0, 16, 16, 40, 0, 32, 32);
+
+    // 3. Assert: Every pixel matches the remapped, masked source.
+    auto expected = [](uint8_t color) -> int {
+        if (color == 1 || color == 2) return -1;
+        if (color == 3) return 14;
+        return color;
+    };
+    EXPECT_EQ(IndexAt(0, 0), 12);
+    EXPECT_EQ(IndexAt(0, 4), 9);
+    for (int y = 0; y < 16; ++y) {
+        for (int x = 0; x < 16; ++x) {
+            int e = expected(pixels[y * 16 + x]);
+            ASSERT_EQ(IndexAt(20 + x, y), e < 0 ? 9 : e) << "at " << x << "," << y;
+        }
+    }
+    for (int y = 0; y < 32; ++y) {
+        for (int x = 0; x < 32; ++x) {
+            int e = expected(pixels[(y / 2) * 16 + x / 2]);
+            ASSERT_EQ(IndexAt(40 + x, y), e < 0 ? 9 : e) << "at " << x << "," << y;
+        }
+    }
+
+    // Resetting makes later draws write their own colors again.
+    layer->ResetDrawPalette();
+    layer->SetTransparentColor(std::nullopt);
+    layer->RectFill(0, 0, 1, 1, 8);
+    EXPECT_EQ(IndexAt(0, 0), 8);
+}
+
+// Display palettes change the presented colors per scanline without touching the framebuffer.
+TEST_F(AestheticLayerTest, ScanlinePalettesRemapPresentedRows) {
+    // 1. Arrange: A uniform red screen, already presented.
+    layer->Clear(8);
+    layer->Present();
+    const std::vector<uint8_t> frame = layer->GetFramebuffer();
+
+    // 2. Act: Bank 1 shows red as blue, and rows 10..19 select it. The cart redraws the same
+    // screen, so only the rows that switched bank are uploaded.
+    layer->SetDisplayPaletteEntry(1, 8, 12);
+    layer->SetScanlinePalette(10, 19, 1);
+    layer->Clear(8);
+    layer->Present();
+    const int switchedRows = layer->GetLastUploadRowCount();
+
+    // 3. Assert: Only those rows changed color, and no index was rewritten.
+    const auto& pixels = backend->GetPixels();
+    EXPECT_EQ(pixels[9 * W], 0xFFFF004Du);
+    EXPECT_EQ(pixels[10 * W + 5], 0xFF29ADFFu);
+    EXPECT_EQ(pixels[19 * W + 255], 0xFF29ADFFu);
+    EXPECT_EQ(pixels[20 * W], 0xFFFF004Du);
+    EXPECT_EQ(layer->GetFramebuffer(), frame);
+    EXPECT_EQ(switchedRows, 10);
+
+    // Selecting the same banks again uploads nothing; resetting restores the remapped rows,
+    // and resetting palettes that are already reset (pal() every frame) uploads nothing.
+    layer->SetScanlinePalette(10, 19, 1);
+    layer->Present();
+    EXPECT_EQ(layer->GetLastUploadRowCount(), 0);
+    layer->ResetDisplayPalettes();
+    layer->Present();
+    EXPECT_EQ(backend->GetPixels()[15 * W], 0xFFFF004Du);
+    EXPECT_EQ(layer->GetLastUploadRowCount(), 10);
+    layer->ResetDisplayPalettes();
+    layer->Clear(8);
+    layer->Present();
+    EXPECT_EQ(layer->GetLastUploadRowCount(), 0);
+}
+
+// The clip rectangle limits every primitive, and lines far off screen are clipped exactly.
+TEST_F(AestheticLayerTest, ClipRectangleLimitsEveryPrimitive) {
+    // 1. Arrange: Draw the same scene clipped and unclipped.
+    auto drawScene = [this]() {
+        layer->SetCamera(-7, 3);
+        layer->Line(-50, -40, 300, 200, 7);
+        layer->Line(20, 60, 20, -100000, 8);
+        layer->Line(-100000, 70, 100000, 71, 9);
+        layer->Rect(5, 5, 90, 60, 10);
+        layer->Circ(60, 40, 35, 11);
+        layer->CircFill(30, 70, 12, 12);
+        layer->Print("CLIP", 40, 30, 13);
+        layer->SetCamera(0, 0);
+    };
+    layer->Clear(0);
+    drawScene();
+    const std::vector<uint8_t> unclipped = layer->GetFramebuffer();
+
+    // 2. Act: Clip to a rectangle straddling the scene.
+    layer->Clear(0);
+    layer->SetClip(25, 20, 50, 40);
+    drawScene();
+    layer->ResetClip();
+
+    // 3. Assert: Inside the clip the pixels match, outside nothing was drawn.
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            bool inside = x >= 25 && x < 75 && y >= 20 && y < 60;
+            ASSERT_EQ(IndexAt(x, y), inside ? unclipped[y * W + x] : 0) << "at " << x << "," << y;
+        }
+    }
+}
+
+// Circles far larger than the screen draw the same pixels as the midpoint walk, and only the
+// part of the walk inside the clip rectangle is visited.
+TEST_F(AestheticLayerTest, HugeCircleWalksOnlyItsVisiblePart) {
+    // 1. Arrange: The walk's x at step y, x(y) = floor(sqrt(r^2 - y^2 - 2y)).
+    const int64_t r = 1000000000;
+    auto walkX = [r](int64_t y) {
+        const int64_t value = r * r - y * y - 2 * y;
+        if (value < 0) return int64_t{-1};
+        int64_t root = static_cast<int64_t>(std::sqrt(static_cast<double>(value)));
+        while (root * root > value) --root;
+        while ((root + 1) * (root + 1) <= value) ++root;
+        return root;
+    };
+    // Offsets (a, b) from the center are on the outline if one of them is the walk's x at the other.
+    auto onOutline = [&](int64_t a, int64_t b) {
+        a = a < 0 ? -a : a;
+        b = b < 0 ? -b : b;
+        const int64_t xb = walkX(b), xa = walkX(a);
+        return (xb >= b && a == xb) || (xa >= a && b == xa);
+    };
+    const struct { int64_t cx, cy; } centers[] = {
+        {128, 100 + r},      // Nearly flat top edge.
+        {60 - r, 128},       // Nearly vertical left edge.
+        {128 + 707106781, 128 + 707106781}, // Crosses the screen on the diagonal.
+    };
+
+    for (const auto& center : centers) {
+        // 2. Act: An unclipped walk would take about r steps per octant.
+        layer->Clear(0);
+        const auto start = std::chrono::steady_clock::now();
+        layer->Circ(static_cast<int>(center.cx), static_cast<int>(center.cy), static_cast<int>(r), 7);
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+
+        // 3. Assert
+        EXPECT_LT(elapsed, std::chrono::milliseconds(100));
+        int drawn = 0;
+        for (int y = 0; y < H; ++y) {
+            for (int x = 0; x < W; ++x) {
+                const bool on = onOutline(x - center.cx, y - center.cy);
+                drawn += on ? 1 : 0;
+                ASSERT_EQ(IndexAt(x, y), on ? 7 : 0) << "at " << x << "," << y << " center " << center.cx;
+            }
+        }
+        EXPECT_GT(drawn, W / 2) << "center " << center.cx;
+    }
+}
+
+// Triangles fill the pixels whose centers are inside: two halves of a rectangle give exactly
+// RectFill, and a fan of triangles with fractional vertices covers its outline polygon once.
+TEST_F(AestheticLayerTest, TriFillFollowsTheTopLeftRule) {
+    const int32_t one = Rasterizer::FIXED_ONE;
+
+    // 1. Arrange & Act: Split a rectangle along its diagonal.
+    layer->Clear(0);
+    layer->RectFill(10, 20, 37, 15, 7);
+    const std::vector<uint8_t> rect = layer->GetFramebuffer();
+    layer->Clear(0);
+    layer->TriFill(10 * one, 20 * one, 47 * one, 20 * one, 47 * one, 35 * one, 7);
+    layer->TriFill(10 * one, 20 * one, 47 * one, 35 * one, 10 * one, 35 * one, 7);
+
+    // 2. Assert: The halves add up to the rectangle.
+    EXPECT_EQ(layer->GetFramebuffer(), rect);
+
+    // 1. Arrange: A fan around a fractional center, and its outline as a polygon.
+    const int fanSize = 9;
+    std::vector<int32_t> outline;
+    for (int i = 0; i < fanSize; ++i) {
+        double angle = i * 6.283185307179586 / fanSize;
+        outline.push_back(Rasterizer::ToFixed(128.3 + 70.7 * std::cos(angle)));
+        outline.push_back(Rasterizer::ToFixed(100.6 + 55.1 * std::sin(angle)));
+    }
+    const int32_t cx = Rasterizer::ToFixed(131.25), cy = Rasterizer::ToFixed(97.5);
+
+    // 2. Act: Draw each triangle of the fan on its own and count how often each pixel is covered.
+    std::vector<int> coverage(W * H, 0);
+    for (int i = 0; i < fanSize; ++i) {
+        const int j = (i + 1) % fanSize;
+        layer->Clear(0);
+        layer->TriFill(cx, cy, outline[2 * i], outline[2 * i + 1], outline[2 * j], outline[2 * j + 1], 1);
+        for (int p = 0; p < W * H; ++p) {
+            coverage[p] += layer->GetFramebuffer()[p];
+        }
+    }
+    layer->Clear(0);
+    layer->PolyFill(outline.data(), fanSize, 1);
+
+    // 3. Assert: Every pixel of the polygon is covered by exactly one triangle, and no other is.
+    for (int p = 0; p < W * H; ++p) {
+        ASSERT_EQ(coverage[p], layer->GetFramebuffer()[p]) << "at " << p % W << "," << p / W;
+    }
+}
+
+// Concave polygons are filled even-odd, and clipped like every other primitive.
+TEST_F(AestheticLayerTest, PolyFillHandlesConcaveShapes) {
+    const int32_t one = Rasterizer::FIXED_ONE;
+    // A "U": the notch between the arms stays empty.
+    const std::vector<int32_t> shape = {
+        0, 0, 30 * one, 0, 30 * one, 30 * one, 20 * one, 30 * one,
+        20 * one, 10 * one, 10 * one, 10 * one, 10 * one, 30 * one, 0, 30 * one,
+    };
+    layer->Clear(0);
+    layer->SetCamera(-5, -5);
+    layer->SetClip(0, 0, 30, 256);
+    layer->PolyFill(shape.data(), 8, 6);
+    layer->ResetClip();
+
+    EXPECT_EQ(IndexAt(5, 5), 6);      // Top-left corner.
+    EXPECT_EQ(IndexAt(10, 30), 6);    // Left arm.
+    EXPECT_EQ(IndexAt(20, 30), 0);    // Notch.
+    EXPECT_EQ(IndexAt(29, 30), 6);    // Right arm, inside the clip.
+    EXPECT_EQ(IndexAt(30, 30), 0);    // Right arm, clipped.
+    EXPECT_EQ(IndexAt(5, 35), 0);     // Below the shape.
+}
+
+// Drawing can target an offscreen surface, which is then blitted to the screen.
+TEST_F(AestheticLayerTest, SurfacesTakeDrawingAndBlitToTheScreen) {
+    // 1. Arrange: A presented screen, and a surface holding a small scene.
+    layer->Clear(1);
+    layer->Present();
+    const int id = layer->CreateSurface(40, 20);
+    ASSERT_GT(id, 0);
+    ASSERT_TRUE(layer->SetDrawTarget(id));
+    layer->Clear(0);
+    layer->RectFill(0, 0, 10, 10, 7);
+    layer->SetPixel(39, 19, 9);
+    EXPECT_EQ(layer->Pget(39, 19), 9);
+    layer->SetDrawTarget(0);
+
+    // 2. Assert: The screen was not touched, so nothing needs uploading.
+    EXPECT_EQ(IndexAt(0, 0), 1);
+    layer->Present();
+    EXPECT_EQ(layer->GetLastUploadRowCount(), 0);
+
+    // 2. Act: Copy the surface under a camera and a clip, once whole and once masked.
+    layer->SetCamera(-100, -50);
+    layer->SetClip(0, 0, 139, 256);
+    layer->Blit(id, 0, 0, 40, 20, 0, 0);
+    layer->ResetClip();
+    layer->SetTransparent(0, true);
+    layer->Blit(id, 0, 0, 40, 20, 0, 100, true);
+    layer->SetTransparent(0, false);
+    layer->SetCamera(0, 0);
+
+    // 3. Assert: Unmasked copies keep color 0, masked ones skip it; the clip cut the last column.
+    EXPECT_EQ(IndexAt(100, 50), 7);
+    EXPECT_EQ(IndexAt(120, 60), 0);
+    EXPECT_EQ(IndexAt(138, 69), 0);
+    EXPECT_EQ(IndexAt(139, 69), 1);
+    EXPECT_EQ(IndexAt(100, 150), 7);
+    EXPECT_EQ(IndexAt(120, 160), 1);
+    EXPECT_EQ(IndexAt(139, 169), 9);
+
+    // Freed ids are reused, and unknown ids are rejected.
+    layer->FreeSurface(id);
+    EXPECT_FALSE(layer->SetDrawTarget(id));
+    EXPECT_EQ(layer->CreateSurface(8, 8), id);
+    EXPECT_EQ(layer->CreateSurface(0, 8), -1);
+}
+
+// A blit from a surface onto itself copies the source as it was before the copy.
+TEST_F(AestheticLayerTest, OverlappingSelfBlitCopiesTheOriginal) {
+    // 1. Arrange: A gradient of distinct rows and columns.
+    for (int y = 0; y < 32; ++y) {
+        for (int x = 0; x < 32; ++x) {
+            layer->SetPixel(x, y, static_cast<uint8_t>((x + 3 * y) % 16));
+        }
+    }
+    const std::vector<uint8_t> before = layer->GetFramebuffer();
+
+    // 2. Act: Shift the block down-right, and a copy of it up-left, with a draw palette in effect.
+    layer->Blit(0, 0, 0, 32, 32, 5, 3);
+    layer->SetDrawPaletteEntry(2, 14);
+    layer->Blit(0, 5, 3, 32, 32, 1, 2);
+    layer->ResetDrawPalette();
+
+    // 3. Assert: Each copy read the unmodified source.
+    for (int y = 0; y < 32; ++y) {
+        for (int x = 0; x < 32; ++x) {
+            uint8_t color = before[y * W + x];
+            ASSERT_EQ(IndexAt(x + 1, y + 2), color == 2 ? 14 : color) << "at " << x << "," << y;
+        }
+    }
+}
+
+// The packed 4bpp framebuffer draws and presents exactly what the 8bpp one does, at half the size.
+TEST_F(AestheticLayerTest, PackedFramebufferMatchesIndexedDrawing) {
+    // 1. Arrange: A second layer with a packed framebuffer, sharing a sprite sheet and tilemap.
+    auto packedBackend = std::make_unique<SoftwareRenderBackend>(W, H);
+    SoftwareRenderBackend* packedOutput = packedBackend.get();
+    AestheticLayer packed(std::move(packedBackend));
+    ASSERT_TRUE(packed.SetFramebufferPacked(true));
+    EXPECT_EQ(packed.GetFramebuffer().size(), layer->GetFramebuffer().size() / 2);
+
+    std::vector<uint8_t> pixels(32 * 16);
+    for (int i = 0; i < 32 * 16; ++i) {
+        pixels[i] = static_cast<uint8_t>((i * 7 + i / 32) % 16);
+    }
+    auto sheet = std::make_shared<SpriteSheet>(32, 16, pixels);
+    auto map = std::make_shared<Tilemap>(12, 9);
+    for (int y = 0; y < 9; ++y) {
+        for (int x = 0; x < 12; ++x) {
+            map->Set(x, y, static_cast<uint8_t>((x + 2 * y) % 8));
+        }
+    }
+
+    // 2. Act: Draw the same scene with every kernel, at odd and even columns, on both layers.
+    auto drawScene = [&](AestheticLayer& target) {
+        target.SetSpriteSheet(sheet);
+        target.SetTilemap(map);
+        target.Clear(1);
+        target.SetCamera(-3, 1);
+        target.SetClip(7, 5, 231, 240);
+        target.RectFill(1, 2, 37, 19, 4);
+        target.Line(-20, 3, 250, 90, 7);
+        target.Line(33, 0, 33, 200, 8);
+        target.Rect(40, 40, 21, 13, 9);
+        target.Circ(120, 60, 27, 10);
+        target.CircFill(61, 141, 17, 11);
+        target.TriFill(0, 0, 90 * Rasterizer::FIXED_ONE, 37 * Rasterizer::FIXED_ONE, 13 * Rasterizer::FIXED_ONE,
+                       101 * Rasterizer::FIXED_ONE, 12);
+        target.SetPixel(101, 102, 13);
+        target.Print("PACKED 4BPP", 85, 111, 14);
+        target.SetTransparentColor(0);
+        target.SetDrawPaletteEntry(5, 2);
+        target.Spr(1, 141, 10, 2, 1, false, false);
+        target.Spr(2, 150, 30, 1, 2, true, true);
+        target.Sspr(3, 1, 20, 13, 171, 45, 37, 29, true, false);
+        target.Map(0, 0, 9, 160, 12, 9);
+        const int id = target.CreateSurface(33, 21);
+        target.SetDrawTarget(id);
+        target.Clear(6);
+        target.CircFill(16, 10, 9, 0);
+        target.SetDrawTarget(0);
+        target.Blit(id, 0, 0, 33, 21, 199, 151, true);
+        target.Blit(0, 140, 8, 45, 30, 143, 9);
+        target.Blit(0, 35, 40, 60, 30, 30, 37, true);
+        target.ResetDrawPalette();
+        target.ResetClip();
+        target.SetCamera(0, 0);
+        target.Present();
+    };
+    drawScene(*layer);
+    drawScene(packed);
+
+    // 3. Assert: Same indices and same presented colors.
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            ASSERT_EQ(packed.Pget(x, y), IndexAt(x, y)) << "at " << x << "," << y;
+        }
+    }
+    EXPECT_EQ(packedOutput->GetPixels(), backend->GetPixels());
+
+    // Unpacking keeps the screen, and a palette too large for nibbles cannot be packed.
+    ASSERT_TRUE(packed.SetFramebufferPacked(false));
+    EXPECT_EQ(packed.GetFramebuffer(), layer->GetFramebuffer());
+    packed.ResizePalette(32);
+    EXPECT_FALSE(packed.SetFramebufferPacked(true));
+}
+
+// Fill patterns are laid over the screen: set bits draw the second color, or nothing without one,
+// for spans, outlines and points alike, and packed framebuffers get the same pixels.
+TEST_F(AestheticLayerTest, FillPatternAppliesToSpansOutlinesAndPoints) {
+    // 1. Arrange: An asymmetric pattern, so a shifted or mirrored mask would show.
+    const uint16_t pattern = 0xA5C3;
+    auto patternBit = [&](int x, int y) { return (pattern >> (15 - (y % 4) * 4 - (x % 4))) & 1; };
+    auto packedLayer = std::make_unique<AestheticLayer>(std::make_unique<SoftwareRenderBackend>(W, H));
+    ASSERT_TRUE(packedLayer->SetFramebufferPacked(true));
+
+    // 2. Act: Two-color fills at odd offsets, then transparent ones, under a camera.
+    auto drawScene = [&](AestheticLayer& target) {
+        target.Clear(1);
+        target.SetCamera(-1, -2);
+        target.SetFillPattern(pattern, 9);
+        target.RectFill(2, 3, 45, 30, 4);
+        target.Line(0, 60, 70, 60, 4);
+        target.CircFill(120, 40, 21, 5);
+        target.Circ(200, 40, 15, 6);
+        target.SetFillPattern(pattern, std::nullopt);
+        target.RectFill(2, 80, 37, 11, 7);
+        target.SetPixel(100, 100, 7);
+        target.SetPixel(101, 100, 7);
+        target.SetFillPattern(0, std::nullopt);
+        target.RectFill(2, 120, 9, 9, 8);
+        target.SetCamera(0, 0);
+    };
+    drawScene(*layer);
+    drawScene(*packedLayer);
+
+    // 3. Assert: Each pixel follows the pattern bit at its screen position.
+    for (int y = 5; y < 35; ++y) {
+        for (int x = 3; x < 48; ++x) {
+            ASSERT_EQ(IndexAt(x, y), patternBit(x, y) ? 9 : 4) << "at " << x << "," << y;
+        }
+    }
+    for (int x = 1; x <= 71; ++x) {
+        ASSERT_EQ(IndexAt(x, 62), patternBit(x, 62) ? 9 : 4) << "at " << x;
+    }
+    for (int y = 82; y < 93; ++y) {
+        for (int x = 3; x < 40; ++x) {
+            ASSERT_EQ(IndexAt(x, y), patternBit(x, y) ? 1 : 7) << "at " << x << "," << y;
+        }
+    }
+    EXPECT_EQ(IndexAt(101, 102), patternBit(101, 102) ? 1 : 7);
+    EXPECT_EQ(IndexAt(102, 102), patternBit(102, 102) ? 1 : 7);
+    EXPECT_EQ(IndexAt(7, 126), 8);
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            ASSERT_EQ(packedLayer->Pget(x, y), IndexAt(x, y)) << "at " << x << "," << y;
+        }
+    }
+}
+
+// Rotated sprites sample pixel centers exactly: no rotation matches spr, quarter turns and
+// integer zooms move whole pixels, and packed screens or screen sources give the same result.
+TEST_F(AestheticLayerTest, RsprMapsPixelCentersThroughRotationAndScale) {
+    // 1. Arrange: A 16x8 sheet with distinct colors and a transparent color 0.
+    std::vector<uint8_t> pixels(16 * 8);
+    for (int i = 0; i < 16 * 8; ++i) {
+        pixels[i] = static_cast<uint8_t>(i % 13 == 0 ? 0 : 1 + (i * 5) % 15);
+    }
+    auto sheet = std::make_shared<SpriteSheet>(16, 8, pixels);
+    auto src = [&](int u, int v) { return pixels[v * 16 + u]; };
+    const int32_t one = Rasterizer::AFFINE_ONE;
+    const int sheetSource = Rasterizer::SPRITE_SHEET_SOURCE;
+    auto expectRegion = [&](int x0, int y0, int w, int h, auto expected) {
+        for (int j = 0; j < h; ++j) {
+            for (int i = 0; i < w; ++i) {
+                const uint8_t color = expected(i, j);
+                ASSERT_EQ(IndexAt(x0 + i, y0 + j), color == 0 ? 2 : color) << "at " << i << "," << j;
+            }
+        }
+    };
+    layer->SetSpriteSheet(sheet);
+    layer->SetTransparentColor(0);
+
+    // 2. Act: No rotation, a quarter turn, a 2x zoom and a horizontal flip, under a camera.
+    layer->Clear(2);
+    layer->SetCamera(5, -3);
+    layer->Rspr(sheetSource, 0, 0, 16, 8, 25, 7, 0, one, one);
+    layer->Rspr(sheetSource, 0, 0, 16, 8, 65, 17, one / 4, one, one);
+    layer->Rspr(sheetSource, 0, 0, 16, 8, 121, 17, 0, 2 * one, 2 * one);
+    layer->Rspr(sheetSource, 0, 0, 16, 8, 25, 47, 0, -one, one);
+    layer->SetCamera(0, 0);
+
+    // 3. Assert: Each destination pixel holds the source pixel its center maps to.
+    expectRegion(12, 6, 16, 8, [&](int i, int j) { return src(i, j); });
+    expectRegion(56, 12, 8, 16, [&](int i, int j) { return src(15 - j, i); });
+    expectRegion(100, 12, 32, 16, [&](int i, int j) { return src(i / 2, j / 2); });
+    expectRegion(12, 46, 16, 8, [&](int i, int j) { return src(15 - i, j); });
+    EXPECT_EQ(IndexAt(11, 10), 2);
+    EXPECT_EQ(IndexAt(28, 10), 2);
+
+    // A packed screen, rotating a part of itself at an arbitrary angle, matches the 8bpp one.
+    auto packedLayer = std::make_unique<AestheticLayer>(std::make_unique<SoftwareRenderBackend>(W, H));
+    ASSERT_TRUE(packedLayer->SetFramebufferPacked(true));
+    packedLayer->SetSpriteSheet(sheet);
+    for (AestheticLayer* target : {layer.get(), packedLayer.get()}) {
+        target->SetTransparentColor(0);
+        target->Clear(2);
+        target->Rspr(sheetSource, 0, 0, 16, 8, 40, 40, 0, 3 * one, 3 * one);
+        target->SetDrawPaletteEntry(4, 9);
+        target->Rspr(0, 16, 28, 48, 24, 150, 100, Rasterizer::ToAffine(0.13), Rasterizer::ToAffine(1.7),
+                     Rasterizer::ToAffine(-0.8));
+        target->Rspr(0, 16, 28, 48, 24, 30, 40, Rasterizer::ToAffine(0.61), one, one);
+        target->ResetDrawPalette();
+    }
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            ASSERT_EQ(packedLayer->Pget(x, y), IndexAt(x, y)) << "at " << x << "," << y;
+        }
+    }
+}
+
+// Flood fill paints exactly the 4-connected area of the seed's color, stops at the clip
+// rectangle, and follows fill patterns without looping on pixels left at the old color.
+TEST_F(AestheticLayerTest, FloodFillPaintsTheConnectedArea) {
+    // 1. Arrange: A ring split in two by a line, and a separate box. A breadth-first search
+    // over the walls gives the expected areas.
+    auto packedLayer = std::make_unique<AestheticLayer>(std::make_unique<SoftwareRenderBackend>(W, H));
+    ASSERT_TRUE(packedLayer->SetFramebufferPacked(true));
+    for (AestheticLayer* target : {layer.get(), packedLayer.get()}) {
+        target->Clear(1);
+        target->Circ(100, 100, 40, 7);
+        target->Line(60, 100, 140, 100, 7);
+        target->Rect(10, 10, 30, 30, 7);
+    }
+    const std::vector<uint8_t> walls = layer->GetFramebuffer();
+    auto area = [&](int seedX, int seedY, int maxY) {
+        std::vector<bool> inside(W * H, false);
+        std::vector<std::pair<int, int>> queue{{seedX, seedY}};
+        inside[seedY * W + seedX] = true;
+        for (size_t i = 0; i < queue.size(); ++i) {
+            const auto [x, y] = queue[i];
+            const int next[4][2] = {{x - 1, y}, {x + 1, y}, {x, y - 1}, {x, y + 1}};
+            for (const auto& n : next) {
+                if (n[0] < 0 || n[0] >= W || n[1] < 0 || n[1] >= maxY) continue;
+                const int index = n[1] * W + n[0];
+                if (!inside[index] && walls[index] == walls[seedY * W + seedX]) {
+                    inside[index] = true;
+                    queue.push_back({n[0], n[1]});
+                }
+            }
+        }
+        return inside;
+    };
+    const std::vector<bool> upper = area(100, 80, H);
+    const std::vector<bool> lower = area(100, 110, H);
+    const std::vector<bool> box = area(20, 20, 25);
+
+    // 2. Act: Fill each area on both layouts, under a camera.
+    for (AestheticLayer* target : {layer.get(), packedLayer.get()}) {
+        target->SetCamera(3, 4);
+        target->FloodFill(103, 84, 5);
+        target->SetClip(0, 0, W, 25);
+        target->FloodFill(23, 24, 6);
+        target->ResetClip();
+        target->SetFillPattern(0x5A5A, std::nullopt);
+        target->FloodFill(103, 114, 9);
+        target->SetFillPattern(0, std::nullopt);
+        target->SetCamera(0, 0);
+    }
+
+    // 3. Assert: Each area got its own color and nothing leaked across the walls.
+    int upperCount = 0;
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            const int index = y * W + x;
+            uint8_t expected = walls[index];
+            if (upper[index]) {
+                expected = 5;
+                ++upperCount;
+            } else if (lower[index]) {
+                expected = ((0x5A5A >> (15 - (y % 4) * 4 - (x % 4))) & 1) ? 1 : 9;
+            } else if (box[index]) {
+                expected = 6;
+            }
+            ASSERT_EQ(IndexAt(x, y), expected) << "at " << x << "," << y;
+            ASSERT_EQ(packedLayer->Pget(x, y), expected) << "at " << x << "," << y;
+        }
+    }
+    EXPECT_GT(upperCount, 2000);
+    EXPECT_EQ(IndexAt(20, 30), 1);
+
+    // A whole-screen fill reaches every pixel of the background.
+    layer->Clear(2);
+    layer->FloodFill(W - 1, H - 1, 3);
+    EXPECT_EQ(layer->GetFramebuffer(), std::vector<uint8_t>(W * H, 3));
+}
+
+// The effects rewrite exactly the pixels inside the clip rectangle, on both framebuffer layouts,
+// ignoring the camera and fill pattern.
+TEST_F(AestheticLayerTest, EffectsMatchPerPixelReference) {
+    // 1. Arrange
+    auto packedLayer = std::make_unique<AestheticLayer>(std::make_unique<SoftwareRenderBackend>(W, H));
+    ASSERT_TRUE(packedLayer->SetFramebufferPacked(true));
+    for (AestheticLayer* target : {layer.get(), packedLayer.get()}) {
+        target->Clear(1);
+        for (int i = 0; i < 60; ++i) {
+            target->CircFill((i * 71) % W, (i * 113) % H, 4 + i % 13, static_cast<uint8_t>(i % 16));
+        }
+        target->SetClip(13, 7, 201, 190);
+        target->SetCamera(3, 4);
+        target->SetFillPattern(0x5A5A, std::nullopt);
+    }
+    const int x0 = 13, y0 = 7, x1 = 214, y1 = 197;
+    auto verify = [&](const std::vector<uint8_t>& expected, const char* effect) {
+        for (int y = 0; y < H; ++y) {
+            for (int x = 0; x < W; ++x) {
+                ASSERT_EQ(IndexAt(x, y), expected[y * W + x]) << effect << " at " << x << "," << y;
+                ASSERT_EQ(packedLayer->GetFramebuffer()[y * (W / 2) + x / 2] >> ((x & 1) * 4) & 0x0F, expected[y * W + x])
+                    << effect << " (packed) at " << x << "," << y;
+            }
+        }
+    };
+    auto inside = [&](int x, int y) { return x >= x0 && x < x1 && y >= y0 && y < y1; };
+
+    // Fade tables start at the identity and end on the target color.
+    const auto none = layer->FadeLUT(0.0, 0);
+    const auto full = layer->FadeLUT(1.0, 7);
+    for (int c = 0; c < 16; ++c) {
+        EXPECT_EQ(none[c], c);
+        EXPECT_EQ(full[c], 7);
+    }
+
+    // 2. Act / 3. Assert: Each effect against its reference, applied one after another.
+    std::vector<uint8_t> before = layer->GetFramebuffer();
+    std::vector<uint8_t> expected = before;
+    const auto cycle = layer->CycleLUT(2, 9, -3);
+    for (int i = 0; i < W * H; ++i) {
+        if (inside(i % W, i / W) && before[i] >= 2 && before[i] <= 9) expected[i] = 2 + (before[i] - 2 + 5) % 8;
+    }
+    layer->Remap(cycle.data());
+    packedLayer->Remap(cycle.data());
+    verify(expected, "pcycle");
+
+    // Ranges past the palette are cut to it, and tables pointing past it wrap around.
+    const auto clamped = layer->CycleLUT(14, 300, 1);
+    EXPECT_EQ(clamped[14], 15);
+    EXPECT_EQ(clamped[15], 14);
+    EXPECT_EQ(clamped[16], 16);
+    before = layer->GetFramebuffer();
+    std::array<uint8_t, 256> beyond;
+    for (int c = 0; c < 256; ++c) beyond[c] = static_cast<uint8_t>(c + 35);
+    for (int i = 0; i < W * H; ++i) {
+        if (inside(i % W, i / W)) expected[i] = (before[i] + 35) % 16;
+    }
+    layer->Remap(beyond.data());
+    packedLayer->Remap(beyond.data());
+    verify(expected, "remap past the palette");
+
+    before = layer->GetFramebuffer();
+    const auto fade = layer->FadeLUT(0.5, 0);
+    for (int i = 0; i < W * H; ++i) {
+        if (inside(i % W, i / W)) expected[i] = fade[before[i]];
+    }
+    layer->Remap(fade.data());
+    packedLayer->Remap(fade.data());
+    verify(expected, "fade");
+
+    before = layer->GetFramebuffer();
+    for (int y = y0; y < y1; ++y) {
+        const double angle = 6.283185307179586 * (y / 37.0 + 0.25);
+        const long long shift = ((std::llround(5.5 * std::sin(angle)) % (x1 - x0)) + (x1 - x0)) % (x1 - x0);
+        for (int x = x0; x < x1; ++x) {
+            expected[y * W + x] = before[y * W + x0 + (x - x0 - shift + (x1 - x0)) % (x1 - x0)];
+        }
+    }
+    for (AestheticLayer* target : {layer.get(), packedLayer.get()}) {
+        target->Wobble(Rasterizer::ToAffine(5.5), Rasterizer::ToAffine(37), Rasterizer::ToAffine(0.25));
+    }
+    verify(expected, "wobble");
+
+    before = layer->GetFramebuffer();
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            expected[y * W + x] = before[std::max(y / 5 * 5, y0) * W + std::max(x / 5 * 5, x0)];
+        }
+    }
+    layer->Mosaic(5);
+    packedLayer->Mosaic(5);
+    verify(expected, "mosaic");
+
+    static constexpr int thresholds[4][4] = {{0, 8, 2, 10}, {12, 4, 14, 6}, {3, 11, 1, 9}, {15, 7, 13, 5}};
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            if (thresholds[y % 4][x % 4] < 6) expected[y * W + x] = 12;
+        }
+    }
+    layer->Dissolve(6, 12);
+    packedLayer->Dissolve(6, 12);
+    verify(expected, "dissolve");
+}
+
+// Other resolutions resize the framebuffer and output image, clip drawing to the new screen and
+// present the same way through the specialized and the generic row paths.
+TEST_F(AestheticLayerTest, ResolutionChangesResizeScreenAndOutput) {
+    struct Mode { int width, height; bool packed; };
+    const Mode modes[] = {{320, 180, false}, {480, 270, true}, {128, 128, true}, {202, 150, false}, {202, 150, true}};
+    for (const Mode& mode : modes) {
+        // 1. Arrange
+        ASSERT_TRUE(layer->SetFramebufferPacked(mode.packed));
+        ASSERT_TRUE(layer->SetResolution(mode.width, mode.height));
+
+        // 2. Act: Fill past the bottom-right corner and mark the last pixel.
+        layer->Clear(1);
+        layer->RectFill(mode.width / 2, mode.height / 2, 4096, 4096, 8);
+        layer->SetPixel(mode.width - 1, mode.height - 1, 12);
+        layer->Present();
+
+        // 3. Assert
+        const size_t pixelCount = static_cast<size_t>(mode.width) * mode.height;
+        EXPECT_EQ(layer->GetFramebuffer().size(), mode.packed ? pixelCount / 2 : pixelCount);
+        ASSERT_EQ(backend->GetWidth(), mode.width);
+        ASSERT_EQ(backend->GetHeight(), mode.height);
+        EXPECT_EQ(layer->GetLastUploadRowCount(), mode.height);
+        const auto& output = backend->GetPixels();
+        EXPECT_EQ(output[0], 0xFF1D2B53u);
+        EXPECT_EQ(output[(mode.height / 2) * mode.width + mode.width / 2], 0xFFFF004Du);
+        EXPECT_EQ(output[pixelCount - 1], 0xFF29ADFFu);
+        EXPECT_EQ(layer->Pget(mode.width, 0), 0);
+
+        // Redrawing the same frame uploads nothing.
+        layer->Clear(1);
+        layer->RectFill(mode.width / 2, mode.height / 2, 4096, 4096, 8);
+        layer->SetPixel(mode.width - 1, mode.height - 1, 12);
+        layer->Present();
+        EXPECT_EQ(layer->GetLastUploadRowCount(), 0);
+    }
+
+    // Odd widths and oversized screens are rejected and leave the screen as it was.
+    EXPECT_FALSE(layer->SetResolution(321, 180));
+    EXPECT_FALSE(layer->SetResolution(256, AestheticLayer::MAX_FRAMEBUFFER_HEIGHT + 1));
+    EXPECT_EQ(layer->GetScreenWidth(), 202);
+}
+
+// Post-processing matches a per-channel reference of upscale, bloom, shadow mask and scanlines,
+// also when only a few rows change.
+TEST_F(AestheticLayerTest, PostProcessMatchesPerChannelReference) {
+    // 1. Arrange: An odd-sized screen keeps the SIMD kernels off their aligned fast path.
+    constexpr int SW = 202;
+    constexpr int SH = 150;
+    PostProcessor::Settings settings;
+    settings.scale = 3;
+    settings.scanlines = 96;
+    settings.shadowMask = 64;
+    settings.bloom = 160;
+    settings.threads = 3;
+    auto plainBackend = std::make_unique<SoftwareRenderBackend>(SW, SH);
+    SoftwareRenderBackend* plainOutput = plainBackend.get();
+    AestheticLayer plain(std::move(plainBackend));
+    ASSERT_TRUE(plain.SetResolution(SW, SH));
+    ASSERT_TRUE(layer->SetResolution(SW, SH));
+    ASSERT_TRUE(layer->SetPostProcess(settings));
+    EXPECT_FALSE(layer->SetPostProcess(PostProcessor::Settings{5}));
+    layer->SetPipelinedPresent(true);
+
+    auto draw = [](AestheticLayer& target, int frame) {
+        target.Clear(1);
+        for (int i = 0; i < 40; ++i) {
+            target.CircFill((i * 37 + (i == 10 ? frame : 0)) % SW, (i * 53) % SH, i % 9, static_cast<uint8_t>(i % 16));
+        }
+        target.SetPixel(SW - 1, SH - 1, 7);
+    };
+    auto reference = [&](const std::vector<uint32_t>& screen) {
+        const int s = settings.scale;
+        std::vector<uint32_t> expected(static_cast<size_t>(SW) * s * SH * s);
+        auto channel = [&](int x, int y, int shift) {
+            return static_cast<int>((screen[std::clamp(y, 0, SH - 1) * SW + std::clamp(x, 0, SW - 1)] >> shift) & 0xFF);
+        };
+        auto average = [](int a, int b) { return (a + b + 1) >> 1; };
+        for (int oy = 0; oy < SH * s; ++oy) {
+            for (int ox = 0; ox < SW * s; ++ox) {
+                const int x = ox / s;
+                const int y = oy / s;
+                uint32_t pixel = 0xFF000000u;
+                for (int c = 0; c < 3; ++c) {
+                    const int shift = 16 - c * 8; // Red, green, blue.
+                    const int glow = average(average(channel(x - 1, y, shift), channel(x + 1, y, shift)),
+                                             average(channel(x, y - 1, shift), channel(x, y + 1, shift)));
+                    const int bloomed = std::min(channel(x, y, shift) +
+                        ((std::max(glow - PostProcessor::BLOOM_THRESHOLD, 0) * (settings.bloom + 1)) >> 8), 255);
+                    int weight = ox % 3 == c ? 255 : 255 - settings.shadowMask;
+                    if (oy % s == s - 1) {
+                        weight = (weight * (256 - settings.scanlines)) >> 8;
+                    }
+                    pixel |= static_cast<uint32_t>((bloomed * (weight + 1)) >> 8) << shift;
+                }
+                expected[static_cast<size_t>(oy) * SW * s + ox] = pixel;
+            }
+        }
+        return expected;
+    };
+
+    for (int frame = 0; frame < 3; ++frame) {
+        // 2. Act: Frames after the first move a single circle of radius 1.
+        draw(plain, frame);
+        plain.Present();
+        draw(*layer, frame);
+        layer->Present();
+        layer->SetPipelinedPresent(false); // Waits for the frame to be shown.
+
+        // 3. Assert
+        ASSERT_EQ(backend->GetWidth(), SW * settings.scale);
+        ASSERT_EQ(backend->GetHeight(), SH * settings.scale);
+        EXPECT_EQ(backend->GetPixels(), reference(plainOutput->GetPixels())) << "frame " << frame;
+        EXPECT_EQ(layer->GetLastUploadRowCount(), frame == 0 ? SH : 3);
+        layer->SetPipelinedPresent(true);
+    }
+
+    // Identity settings present the plain screen again.
+    layer->SetPipelinedPresent(false);
+    ASSERT_TRUE(layer->SetPostProcess(PostProcessor::Settings{}));
+    layer->Present();
+    EXPECT_EQ(backend->GetWidth(), SW);
+    EXPECT_EQ(backend->GetPixels(), plainOutput->GetPixels());
+}
+
+// Captured frames reach the raw stream with display palettes applied, the GIF decodes to the
+// same indices, and frames the encoder cannot take are counted as dropped.
+TEST_F(AestheticLayerTest, CaptureWritesRawStreamAndGif) {
+    // 1. Arrange: A packed screen whose lower half is shown through a display palette.
+    const std::filesystem::path directory = std::filesystem::temp_directory_path();
+    const std::string rawPath = (directory / "ulics_capture_test.raw").string();
+    const std::string gifPath = (directory / "ulics_capture_test.gif").string();
+    ASSERT_TRUE(layer->SetFramebufferPacked(true));
+    layer->SetDisplayPaletteEntry(1, 8, 12);
+    layer->SetScanlinePalette(H / 2, H - 1, 1);
+    auto draw = [&](int frame) {
+        layer->Clear(8);
+        for (int i = 0; i < 40; ++i) {
+            layer->CircFill((i * 71 + frame * 5) % W, (i * 113) % H, 3 + i % 11, static_cast<uint8_t>(i % 16));
+        }
+        std::vector<uint8_t> shown(W * H);
+        for (int y = 0; y < H; ++y) {
+            for (int x = 0; x < W; ++x) {
+                const uint8_t index = layer->Pget(x, y);
+                shown[y * W + x] = (y >= H / 2 && index == 8) ? 12 : index;
+            }
+        }
+        return shown;
+    };
+    auto readFile = [](const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    };
+    auto u16 = [](const std::vector<uint8_t>& bytes, size_t at) { return bytes[at] | (bytes[at + 1] << 8); };
+
+    // 2. Act: Three frames to a raw stream, the last of them again to a GIF.
+    std::vector<std::vector<uint8_t>> shown;
+    ASSERT_TRUE(layer->StartCapture(rawPath, FrameCapture::Format::Raw));
+    for (int frame = 0; frame < 3; ++frame) {
+        shown.push_back(draw(frame));
+        layer->Present();
+    }
+    EXPECT_EQ(layer->GetCapturedFrameCount(), 3u);
+    layer->StopCapture();
+    ASSERT_TRUE(layer->StartCapture(gifPath, FrameCapture::Format::Gif));
+    layer->Present();
+    layer->StopCapture();
+    EXPECT_FALSE(layer->IsCapturing());
+
+    // 3. Assert: Raw frames hold their size, the palette and the shown indices.
+    const std::vector<uint8_t> raw = readFile(rawPath);
+    const size_t frameBytes = 8 + 768 + W * H;
+    ASSERT_EQ(raw.size(), 12 + 3 * frameBytes);
+    EXPECT_EQ(std::string(raw.begin(), raw.begin() + 8), "ULICSRAW");
+    for (size_t frame = 0; frame < 3; ++frame) {
+        const size_t at = 12 + frame * frameBytes;
+        EXPECT_EQ(u16(raw, at), W);
+        EXPECT_EQ(u16(raw, at + 2), H);
+        EXPECT_EQ(raw[at + 8 + 8 * 3], 255); // Color 8 is red (255, 0, 77).
+        EXPECT_EQ(raw[at + 8 + 8 * 3 + 2], 77);
+        EXPECT_TRUE(std::equal(shown[frame].begin(), shown[frame].end(), raw.begin() + at + 8 + 768)) << "frame " << frame;
+    }
+
+    // The GIF: header, looping extension, one frame with its control extension, trailer.
+    const std::vector<uint8_t> gif = readFile(gifPath);
+    ASSERT_GT(gif.size(), 32u + 8 + 10 + 768);
+    EXPECT_EQ(std::string(gif.begin(), gif.begin() + 6), "GIF89a");
+    EXPECT_EQ(u16(gif, 6), W);
+    EXPECT_EQ(gif[32], 0x21);
+    EXPECT_EQ(gif[33], 0xF9);
+    EXPECT_EQ(gif[40], 0x2C);
+    EXPECT_EQ(gif[40 + 10 + 12 * 3 + 2], 255); // Color 12 is blue (41, 173, 255).
+    size_t pos = 40 + 10 + 768;
+    const int minCodeSize = gif[pos++];
+    std::vector<uint8_t> stream;
+    while (gif[pos] != 0) {
+        stream.insert(stream.end(), gif.begin() + pos + 1, gif.begin() + pos + 1 + gif[pos]);
+        pos += 1 + gif[pos];
+    }
+    EXPECT_EQ(gif[pos + 1], 0x3B);
+    EXPECT_EQ(pos + 2, gif.size());
+
+    // Reference LZW decoder, following the GIF specification.
+    const int clearCode = 1 << minCodeSize;
+    std::vector<std::vector<uint8_t>> table;
+    std::vector<uint8_t> decoded;
+    int codeSize = 0;
+    int previous = -1;
+    auto resetTable = [&] {
+        table.assign(clearCode + 2, {});
+        for (int i = 0; i < clearCode; ++i) table[i] = {static_cast<uint8_t>(i)};
+        codeSize = minCodeSize + 1;
+        previous = -1;
+    };
+    resetTable();
+    for (size_t bit = 0; bit + codeSize <= stream.size() * 8;) {
+        int code = 0;
+        for (int i = 0; i < codeSize; ++i, ++bit) {
+            code |= ((stream[bit >> 3] >> (bit & 7)) & 1) << i;
+        }
+        if (code == clearCode) {
+            resetTable();
+            continue;
+        }
+        if (code == clearCode + 1) break;
+        std::vector<uint8_t> entry;
+        if (code < static_cast<int>(table.size())) {
+            entry = table[code];
+        } else {
+            ASSERT_GE(previous, 0);
+            entry = table[previous];
+            entry.push_back(table[previous][0]);
+        }
+        decoded.insert(decoded.end(), entry.begin(), entry.end());
+        if (previous >= 0 && table.size() < 4096) {
+            table.push_back(table[previous]);
+            table.back().push_back(entry[0]);
+        }
+        if (table.size() == (1u << codeSize) && codeSize < 12) ++codeSize;
+        previous = code;
+    }
+    EXPECT_EQ(decoded, shown[2]);
+
+    // Presenting far faster than the encoder writes loses frames, but every one is accounted for.
+    ASSERT_TRUE(layer->StartCapture(rawPath, FrameCapture::Format::Raw));
+    for (int frame = 0; frame < 500; ++frame) {
+        layer->Present();
+    }
+    const uint64_t captured = layer->GetCapturedFrameCount();
+    EXPECT_EQ(captured + layer->GetDroppedCaptureFrameCount(), 500u);
+    layer->StopCapture();
+    EXPECT_EQ(readFile(rawPath).size(), 12 + captured * frameBytes);
+
+    std::filesystem::remove(rawPath);
+    std::filesystem::remove(gifPath);
+}
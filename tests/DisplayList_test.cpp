@@ -0,0 +1,188 @@
+// tests/DisplayList_test.cpp
+
+#include "gtest/gtest.h"
+#include "rendering/DisplayList.h"
+#include "rendering/AestheticLayer.h"
+#include "rendering/SoftwareRenderBackend.h"
+#include <memory>
+
+// Test fixture for DisplayList tests.
+// Two layers are kept: one drawn immediately as a reference, one driven through a display list.
+class DisplayListTest : public ::testing::Test {
+protected:
+    static constexpr int W = AestheticLayer::FRAMEBUFFER_WIDTH;
+    static constexpr int H = AestheticLayer::FRAMEBUFFER_HEIGHT;
+
+    std::unique_ptr<AestheticLayer> immediate;
+    std::unique_ptr<AestheticLayer> deferred;
+    DisplayList list;
+
+    void SetUp() override {
+        immediate = std::make_unique<AestheticLayer>(std::make_unique<SoftwareRenderBackend>(W, H));
+        deferred = std::make_unique<AestheticLayer>(std::make_unique<SoftwareRenderBackend>(W, H));
+        std::vector<uint8_t> pixels(16 * 16);
+        for (size_t i = 0; i < pixels.size(); ++i) {
+            pixels[i] = static_cast<uint8_t>(i % 5);
+        }
+        auto sheet = std::make_shared<SpriteSheet>(16, 16, pixels);
+        immediate->SetSpriteSheet(sheet);
+        deferred->SetSpriteSheet(sheet);
+    }
+
+    // Issues the same scene to any target exposing the AestheticLayer drawing API.
+    template <typename Target>
+    static void DrawScene(Target& target) {
+        target.Clear(1);
+        target.RectFill(10, 10, 40, 30, 8);
+        target.RectFill(400, 10, 40, 30, 9); // Off screen.
+        target.SetTransparentColor(0);
+        target.Spr(1, 100, 20, 1, 1, true, false);
+        target.SetCamera(-20, 30);
+        target.Line(0, 0, 120, 90, 7);
+        target.Circ(60, 60, 20, 12);
+        target.CircFill(-100, -100, 10, 3); // Off screen under the camera.
+        target.Print("DEFERRED", 5, 100, 10);
+        target.Sspr(0, 0, 8, 8, 150, 150, 24, 12, false, true);
+        target.SetTransparentColor(std::nullopt);
+        target.Rect(3, 40, 50, 20, 11);
+        target.FloodFill(20, 50, 5);
+        target.SetPixel(200, 40, 6);
+    }
+};
+
+// Executing a recorded list produces the same pixels as drawing immediately.
+TEST_F(DisplayListTest, FlushMatchesImmediateDrawing) {
+    // 1. Arrange & Act: Draw the scene both ways.
+    DrawScene(*immediate);
+    list.Begin(deferred->GetDrawState(), W, H);
+    DrawScene(list);
+    list.Flush(*deferred);
+
+    // 2. Assert: The framebuffers and the final state agree, and off-screen calls were dropped.
+    EXPECT_EQ(deferred->GetFramebuffer(), immediate->GetFramebuffer());
+    EXPECT_EQ(deferred->GetCameraX(), immediate->GetCameraX());
+    EXPECT_EQ(deferred->GetCameraY(), immediate->GetCameraY());
+    EXPECT_EQ(list.GetCulledCount(), 2u);
+    EXPECT_EQ(list.GetCommandCount(), 13u);
+}
+
+// Replaying a list restores its starting state and redraws the same frame.
+TEST_F(DisplayListTest, ReplayRedrawsTheSameFrame) {
+    // 1. Arrange: Record and execute one frame.
+    list.Begin(Rasterizer::DrawState{}, W, H);
+    DrawScene(list);
+    list.Flush(*deferred);
+    std::vector<uint8_t> expected = deferred->GetFramebuffer();
+
+    // 2. Act: Scribble over the frame and change state, then replay.
+    deferred->SetCamera(77, 77);
+    deferred->Clear(4);
+    list.Replay(*deferred);
+
+    // 3. Assert: The original frame is back.
+    EXPECT_EQ(deferred->GetFramebuffer(), expected);
+}
+
+// Flushing midway executes only what has not been executed yet.
+TEST_F(DisplayListTest, FlushIsIncremental) {
+    list.Begin(Rasterizer::DrawState{}, W, H);
+    list.Clear(1);
+    list.RectFill(0, 0, 4, 4, 8);
+    list.Flush(*deferred);
+    EXPECT_EQ(deferred->Pget(0, 0), 8);
+
+    // A second flush must not run the clear again.
+    deferred->SetPixel(10, 10, 5);
+    list.SetPixel(11, 10, 6);
+    list.Flush(*deferred);
+    EXPECT_EQ(deferred->Pget(10, 10), 5);
+    EXPECT_EQ(deferred->Pget(11, 10), 6);
+}
+
+// A particle-heavy frame rasterized by tile workers matches serial execution pixel for pixel.
+TEST_F(DisplayListTest, ParallelExecutionMatchesSerial) {
+    // 1. Arrange: Record a frame with thousands of overlapping primitives and state changes.
+    immediate->SetRasterThreads(1);
+    deferred->SetRasterThreads(4);
+    uint32_t seed = 12345;
+    auto next = [&seed](int range) {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<int>((seed >> 8) % static_cast<uint32_t>(range));
+    };
+
+    // Both layers get the same surface for blits to read.
+    for (AestheticLayer* layer : {immediate.get(), deferred.get()}) {
+        ASSERT_EQ(layer->CreateSurface(48, 24), 1);
+        layer->SetDrawTarget(1);
+        layer->Clear(5);
+        layer->CircFill(24, 12, 10, 3);
+        layer->SetDrawTarget(0);
+    }
+
+    // Sprites are only drawn while color 3 is transparent, which keeps the list parallel-safe.
+    list.Begin(Rasterizer::DrawState{}, W, H);
+    list.Clear(1);
+    bool spritesAllowed = false;
+    for (int i = 0; i < 3000; ++i) {
+        if (i % 500 == 0) list.SetCamera(next(40) - 20, next(40) - 20);
+        if (i % 700 == 0) {
+            spritesAllowed = i % 1400 == 0;
+            list.SetTransparentColor(spritesAllowed ? std::optional<uint8_t>(3) : std::nullopt);
+        }
+        if (i % 300 == 0) list.SetDrawPaletteEntry(static_cast<uint8_t>(next(16)), static_cast<uint8_t>(next(16)));
+        if (i % 1100 == 0) list.ResetDrawPalette();
+        if (i % 150 == 0) {
+            list.Rspr(1, next(8), next(8), 40, 16, next(300) - 20, next(300) - 20, next(Rasterizer::AFFINE_ONE),
+                      Rasterizer::AFFINE_ONE / 2 + next(2 * Rasterizer::AFFINE_ONE), Rasterizer::AFFINE_ONE);
+        }
+        if (i % 400 == 0) {
+            list.SetFillPattern(static_cast<uint16_t>(next(3) == 0 ? 0 : next(65536)),
+                                next(2) ? std::optional<uint8_t>(static_cast<uint8_t>(next(16))) : std::nullopt);
+        }
+        const int32_t one = Rasterizer::FIXED_ONE;
+        if (i % 10 == 0) {
+            const int32_t tx = (next(300) - 20) * one + next(one), ty = (next(300) - 20) * one + next(one);
+            list.TriFill(tx, ty, tx + next(40 * one), ty + next(40 * one), tx - next(40 * one), ty + next(20 * one),
+                         static_cast<uint8_t>(next(16)));
+        }
+        if (i % 100 == 0) {
+            const int32_t star[] = {50 * one, 0, 60 * one, 90 * one, 0, 30 * one, 100 * one, 30 * one, 40 * one, 90 * one};
+            list.PolyFill(star, 5, static_cast<uint8_t>(next(16)));
+        }
+        if (i % 150 == 0) list.Blit(1, next(10), next(10), 40, 16, next(300) - 20, next(300) - 20, next(2) == 1);
+        if (i % 900 == 450) {
+            // Effects that only read the rows they write stay parallel-safe.
+            list.Wobble(next(20 * Rasterizer::AFFINE_ONE), next(64 * Rasterizer::AFFINE_ONE), next(Rasterizer::AFFINE_ONE));
+            list.Dissolve(next(Rasterizer::DISSOLVE_LEVELS + 1), static_cast<uint8_t>(next(16)));
+            list.Remap(immediate->CycleLUT(next(8), 8 + next(8), next(16)).data());
+        }
+        if (i % 400 == 0) list.SetClip(next(100), next(100), next(200), next(200));
+        if (i % 1000 == 0) list.ResetClip();
+        const int x = next(300) - 20;
+        const int y = next(300) - 20;
+        const uint8_t c = static_cast<uint8_t>(next(16));
+        switch (i % 7) {
+            case 0: list.CircFill(x, y, next(12), c); break;
+            case 1: list.RectFill(x, y, next(30), next(30), c); break;
+            case 2: list.SetPixel(x, y, c); break;
+            case 3: list.Line(x, y, x + next(60) - 30, y + next(60) - 30, c); break;
+            case 4: list.Circ(x, y, next(20), c); break;
+            case 5: list.Print("PARTICLE", x, y, c); break;
+            case 6:
+                if (spritesAllowed) list.Spr(next(4), x, y, 1, 1, next(2) == 1, next(2) == 1);
+                break;
+        }
+    }
+    ASSERT_TRUE(list.IsParallelSafe());
+
+    // 2. Act: Execute the same list serially and on the tile workers.
+    list.Replay(*immediate);
+    list.Replay(*deferred);
+
+    // 3. Assert: Pixels and final drawing state agree.
+    EXPECT_EQ(deferred->GetFramebuffer(), immediate->GetFramebuffer());
+    EXPECT_EQ(deferred->GetCameraX(), immediate->GetCameraX());
+    EXPECT_EQ(deferred->GetCameraY(), immediate->GetCameraY());
+    EXPECT_TRUE(deferred->GetTransparency() == immediate->GetTransparency());
+    EXPECT_EQ(deferred->GetDrawState().drawPalette, immediate->GetDrawState().drawPalette);
+}
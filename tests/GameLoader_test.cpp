@@ -3,7 +3,10 @@
 #include "gtest/gtest.h"
 #include "core/Engine.h"
 #include "cartridge/GameLoader.h"
+#include "cartridge/Tilemap.h"
 #include "scripting/LuaGame.h"
+#include "rendering/AestheticLayer.h"
+#include "rendering/SoftwareRenderBackend.h"
 #include <filesystem>
 #include <fstream>
 
@@ -55,7 +58,7 @@ TEST_F(GameLoaderTest, SuccessfullyLoadsValidCartridge) {
 
     // 2. Act: Attempt to load the game synchronously.
     // We pass a null progress pointer as we are not testing the progress reporting here.
-    auto game = GameLoader::loadAndInitializeGame(engine.get(), "loader_test", nullptr);
+    auto game = GameLoader::loadGame(engine.get(), "loader_test", nullptr);
 
     // 3. Assert: Check that a valid LuaGame object was created.
     ASSERT_NE(game, nullptr);
@@ -67,8 +70,129 @@ TEST_F(GameLoaderTest, FailsToLoadNonExistentCartridge) {
     // 1. Arrange: No cartridge is created.
 
     // 2. Act: Attempt to load a game that doesn't exist.
-    auto game = GameLoader::loadAndInitializeGame(engine.get(), "non_existent_game", nullptr);
+    auto game = GameLoader::loadGame(engine.get(), "non_existent_game", nullptr);
 
     // 3. Assert: Check that the result is a nullptr.
     EXPECT_EQ(game, nullptr);
-}
\ No newline at end of file
+}
+
+// Test case to verify that a headless engine can run a cartridge's draw pass.
+TEST_F(GameLoaderTest, HeadlessEngineRunsDrawPass) {
+    // 1. Arrange: Create a cartridge that draws a known pattern.
+    const std::string dummyConfig = R"({"title": "Draw Test"})";
+    const std::string dummyScript = "function _draw() clear(1) rectfill(0, 0, 4, 4, 8) end";
+    CreateDummyCartridge("draw_test", dummyConfig, dummyScript);
+    auto game = GameLoader::loadGame(engine.get(), "draw_test", nullptr);
+    ASSERT_NE(game, nullptr);
+
+    // 2. Act: Run one draw pass and present it.
+    AestheticLayer* layer = engine->getAestheticLayer();
+    ASSERT_NE(layer, nullptr);
+    game->_draw(*layer);
+    layer->Present();
+
+    // 3. Assert: Both the indexed framebuffer and the ARGB output reflect the draw calls.
+    EXPECT_EQ(layer->GetFramebuffer()[0], 8);
+    EXPECT_EQ(layer->GetFramebuffer()[5], 1);
+    auto* backend = static_cast<SoftwareRenderBackend*>(layer->GetBackend());
+    EXPECT_EQ(backend->GetPixels()[0], 0xFFFF004Du);
+}
+
+// Test case to verify that a loaded script is compiled once and then served from the cache.
+TEST_F(GameLoaderTest, SecondLoadUsesCachedBytecode) {
+    // 1. Arrange: Create a cartridge whose script sets a global.
+    const std::string dummyConfig = R"({"title": "Cache Test"})";
+    const std::string dummyScript = "answer = 6 * 7\nfunction _draw() clear(answer % 16) end";
+    CreateDummyCartridge("cache_test", dummyConfig, dummyScript);
+
+    // 2. Act: Load the cartridge twice.
+    auto first = GameLoader::loadGame(engine.get(), "cache_test", nullptr);
+    auto second = GameLoader::loadGame(engine.get(), "cache_test", nullptr);
+
+    // 3. Assert: One cache entry was written and the cached chunk runs like the source.
+    ASSERT_NE(first, nullptr);
+    ASSERT_NE(second, nullptr);
+    size_t entries = 0;
+    for (const auto& item : std::filesystem::directory_iterator(testDir / "cache" / "lua")) {
+        entries += item.path().extension() == ".luac" ? 1 : 0;
+    }
+    EXPECT_EQ(entries, 1u);
+    AestheticLayer* layer = engine->getAestheticLayer();
+    second->_draw(*layer);
+    EXPECT_EQ(layer->GetFramebuffer()[0], 42 % 16);
+}
+
+// Surfaces a cartridge creates in _init are still there when its _draw runs, and starting
+// another cartridge frees them before that cartridge's _init.
+TEST_F(GameLoaderTest, SurfacesCreatedInInitReachDraw) {
+    // 1. Arrange: _init paints an offscreen surface that _draw copies to the screen.
+    const std::string dummyConfig = R"({"title": "Surface Test"})";
+    const std::string dummyScript =
+        "function _init() buf = surface(8, 8) target(buf) clear(12) target() end\n"
+        "function _draw() clear(0) blit(buf, 0, 0, 8, 8, 4, 4) end";
+    CreateDummyCartridge("surface_test", dummyConfig, dummyScript);
+
+    // 2. Act: Start the cartridge as the engine does and draw one frame.
+    ASSERT_TRUE(engine->LoadCartridge("surface_test"));
+    AestheticLayer* layer = engine->getAestheticLayer();
+    engine->getActiveGame()->_draw(*layer);
+
+    // 3. Assert
+    EXPECT_EQ(layer->Pget(4, 4), 12);
+    EXPECT_EQ(layer->Pget(11, 11), 12);
+    EXPECT_EQ(layer->Pget(12, 12), 0);
+
+    // Loading again frees the first instance's surface; the new _init takes id 1 again.
+    ASSERT_TRUE(engine->LoadCartridge("surface_test"));
+    EXPECT_EQ(layer->CreateSurface(8, 8), 2);
+}
+
+// _init sees the cartridge's own map, so it can scan it for spawn points and edit it.
+TEST_F(GameLoaderTest, InitReadsAndWritesTheCartridgeMap) {
+    // 1. Arrange: A 4x2 map with sprite 7 in cell (2, 0).
+    const std::string dummyConfig = R"({"title": "Map Test", "map": {"width": 4, "height": 2}})";
+    const std::string dummyScript =
+        "function _init()\n"
+        "  for x = 0, 3 do if mget(x, 0) == 7 then spawn = x end end\n"
+        "  mset(0, 1, 9)\n"
+        "end\n"
+        "function _draw() clear(spawn or 0) end";
+    CreateDummyCartridge("map_test", dummyConfig, dummyScript);
+    const char cells[8] = {0, 0, 7, 0, 0, 0, 0, 0};
+    std::ofstream mapFile(testDir / "cartridges" / "map_test" / "map.bin", std::ios::binary);
+    mapFile.write(cells, sizeof(cells));
+    mapFile.close();
+
+    // 2. Act
+    ASSERT_TRUE(engine->LoadCartridge("map_test"));
+    AestheticLayer* layer = engine->getAestheticLayer();
+    engine->getActiveGame()->_draw(*layer);
+
+    // 3. Assert: mget found the spawn cell and mset reached the attached map.
+    EXPECT_EQ(layer->Pget(0, 0), 2);
+    ASSERT_NE(layer->GetTilemap(), nullptr);
+    EXPECT_EQ(layer->GetTilemap()->Get(0, 1), 9);
+}
+
+// Palettes, transparency, the clip rectangle, the fill pattern and the camera a cartridge
+// leaves behind do not reach the next one.
+TEST_F(GameLoaderTest, DrawStateDoesNotLeakIntoNextCartridge) {
+    // 1. Arrange: One cartridge fades color 8 to black and remaps it; another draws with it.
+    const std::string dummyConfig = R"({"title": "State Test"})";
+    CreateDummyCartridge("leaky", dummyConfig,
+                         "function _init() camera(5, 5) pal(8, 1) pal(8, 0, 1) palt(8, true) "
+                         "spal(3, 8, 0) spalrows(0, 10, 3) clip(100, 100, 1, 1) fillp(0xFFFF) end");
+    CreateDummyCartridge("clean", dummyConfig, "function _draw() clear(0) rectfill(0, 0, 4, 4, 8) end");
+
+    // 2. Act
+    ASSERT_TRUE(engine->LoadCartridge("leaky"));
+    ASSERT_TRUE(engine->LoadCartridge("clean"));
+    AestheticLayer* layer = engine->getAestheticLayer();
+    engine->getActiveGame()->_draw(*layer);
+    layer->Present();
+
+    // 3. Assert: Color 8 is drawn at the origin and shown as red.
+    EXPECT_EQ(layer->Pget(0, 0), 8);
+    auto* backend = static_cast<SoftwareRenderBackend*>(layer->GetBackend());
+    EXPECT_EQ(backend->GetPixels()[0], 0xFFFF004Du);
+}
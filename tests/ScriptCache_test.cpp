@@ -0,0 +1,92 @@
+// tests/ScriptCache_test.cpp
+
+#include "gtest/gtest.h"
+#include "scripting/ScriptCache.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+// Test fixture for ScriptCache tests.
+// Each test gets an empty cache directory in the temp folder.
+class ScriptCacheTest : public ::testing::Test {
+protected:
+    const std::filesystem::path testDir = std::filesystem::temp_directory_path() / "ulics_cache_tests";
+
+    void SetUp() override {
+        std::filesystem::remove_all(testDir);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(testDir);
+    }
+
+    size_t CountEntries() const {
+        size_t count = 0;
+        for (const auto& item : std::filesystem::directory_iterator(testDir)) {
+            count += item.path().extension() == ".luac" ? 1 : 0;
+        }
+        return count;
+    }
+};
+
+// A stored entry is returned for the same source only, and damaged files read as misses.
+TEST_F(ScriptCacheTest, EntriesMatchTheirSourceExactly) {
+    // 1. Arrange
+    ScriptCache cache(testDir.string());
+    const std::string source = "function _init()\n  x = 1\nend\n";
+    ScriptCache::Entry stored;
+    stored.lineCount = 4;
+    const char chunk[] = "\x1bLua\0\x01\x02 chunk"; // Embedded zeros must survive.
+    stored.bytecode = std::string(chunk, sizeof(chunk) - 1);
+
+    // 2. Act
+    ScriptCache::Entry missBeforeStore;
+    const bool hitBeforeStore = cache.Load(source, missBeforeStore);
+    cache.Store(source, stored);
+    ScriptCache::Entry loaded;
+    const bool hit = cache.Load(source, loaded);
+    ScriptCache::Entry edited;
+    const bool editedHit = cache.Load(source + " ", edited);
+
+    // 3. Assert
+    EXPECT_FALSE(hitBeforeStore);
+    ASSERT_TRUE(hit);
+    EXPECT_EQ(loaded.lineCount, 4u);
+    EXPECT_EQ(loaded.bytecode, stored.bytecode);
+    EXPECT_FALSE(editedHit);
+    EXPECT_EQ(CountEntries(), 1u);
+
+    // A truncated or altered entry is not used.
+    const std::filesystem::path entryPath = std::filesystem::directory_iterator(testDir)->path();
+    const uintmax_t size = std::filesystem::file_size(entryPath);
+    std::filesystem::resize_file(entryPath, size - 1);
+    EXPECT_FALSE(cache.Load(source, loaded));
+    cache.Store(source, stored);
+    {
+        std::fstream file(entryPath, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(static_cast<std::streamoff>(size - 2));
+        file.put('X');
+    }
+    EXPECT_FALSE(cache.Load(source, loaded));
+}
+
+// Storing beyond MAX_ENTRIES removes the least recently used entries.
+TEST_F(ScriptCacheTest, PruneKeepsRecentlyUsedEntries) {
+    ScriptCache cache(testDir.string());
+    ScriptCache::Entry entry;
+    entry.bytecode = "chunk";
+    const auto sourceFor = [](size_t i) { return "return " + std::to_string(i); };
+
+    cache.Store(sourceFor(0), entry);
+    std::filesystem::last_write_time(std::filesystem::directory_iterator(testDir)->path(),
+                                     std::filesystem::file_time_type::clock::now() - std::chrono::hours(2));
+    for (size_t i = 1; i <= ScriptCache::MAX_ENTRIES; ++i) {
+        cache.Store(sourceFor(i), entry);
+    }
+
+    ScriptCache::Entry loaded;
+    EXPECT_EQ(CountEntries(), ScriptCache::MAX_ENTRIES);
+    EXPECT_FALSE(cache.Load(sourceFor(0), loaded));
+    EXPECT_TRUE(cache.Load(sourceFor(ScriptCache::MAX_ENTRIES), loaded));
+}